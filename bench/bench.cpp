@@ -0,0 +1,302 @@
+// 编译吞吐量基准测试：生成规模逐步加倍的 SysY 程序，测量每秒编译的行数、各阶段的耗时和峰值内存
+// 用法：build/bench [种类...] [-steps 加倍次数] [-r 重复次数] [-O优化等级]
+//       build/bench -gen 种类 规模      只输出生成的程序，便于单独复现
+// 种类为 funcs、expr、array、blocks、loops，默认全部运行；构建和运行见 make bench
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "compiler.hpp"
+#include "context.hpp"
+#include "driver.hpp"
+#include "timer.hpp"
+
+using namespace std;
+
+// 生成规模为 n 的程序，各种类分别针对前端和后端的一种压力
+struct Generator
+{
+    const char *name;
+    int base;                   // 第一步的规模，之后每步加倍
+    string (*gen)(int n);
+};
+
+// n 个函数，每个函数有局部数组、分支和循环，main 依次调用
+static string genFuncs(int n)
+{
+    string s = "int g[16];\n";
+    for (int i = 0; i < n; i++)
+    {
+        string k = to_string(i);
+        s += "int f" + k + "(int a, int b) {\n";
+        s += "  int t[4] = {a, b, " + k + ", 1};\n";
+        s += "  int i = 0, s = 0;\n";
+        s += "  while (i < a) {\n";
+        s += "    if (i % 3 == " + to_string(i % 3) + ") s = s + t[i % 4] * b;\n";
+        s += "    else s = s - i;\n";
+        s += "    i = i + 1;\n";
+        s += "  }\n";
+        s += "  g[" + to_string(i % 16) + "] = g[" + to_string(i % 16) + "] + s;\n";
+        s += "  return s + " + k + ";\n";
+        s += "}\n";
+    }
+    s += "int main() {\n  int s = 0;\n";
+    for (int i = 0; i < n; i++)
+        s += "  s = s + f" + to_string(i) + "(" + to_string(i % 7) + ", s);\n";
+    s += "  return s;\n}\n";
+    return s;
+}
+
+// 嵌套深度为 n 的表达式，每行一层括号
+static string genExpr(int n)
+{
+    string s = "int main() {\n  int a = getint(), b = getint();\n  return\n";
+    const char *ops[] = {"+", "-", "*", "/", "%"};
+    for (int i = 0; i < n; i++)
+        s += "    (a " + string(ops[i % 5]) + " " + (i % 2 ? "b" : to_string(i + 1)) + " + \n";
+    s += "    1";
+    for (int i = 0; i < n; i++)
+        s += ")";
+    s += ";\n}\n";
+    return s;
+}
+
+// n 个元素的全局和局部数组初始化，每行 16 个元素
+static string genArray(int n)
+{
+    string init;
+    for (int i = 0; i < n; i++)
+    {
+        init += to_string(i * 7 % 1000) + (i + 1 < n ? ", " : "");
+        if (i % 16 == 15)
+            init += "\n  ";
+    }
+    string len = to_string(n);
+    string s = "int ga[" + len + "] = {" + init + "};\n";
+    s += "int main() {\n  int la[" + len + "] = {" + init + "};\n";
+    s += "  int i = 0, s = 0;\n  while (i < " + len + ") { s = s + ga[i] * la[i]; i = i + 1; }\n";
+    s += "  return s;\n}\n";
+    return s;
+}
+
+// 嵌套深度为 n 的语句块，每层定义同名的局部变量并带一个分支
+static string genBlocks(int n)
+{
+    string s = "int main() {\n  int x = getint();\n";
+    for (int i = 0; i < n; i++)
+    {
+        s += "  {\n  int x" + string(i % 2 ? "" : "1") + " = " + to_string(i) + ";\n";
+        s += "  if (x > " + to_string(i) + ") x = x - 1;\n";
+    }
+    for (int i = 0; i < n; i++)
+        s += "  }\n";
+    s += "  return x;\n}\n";
+    return s;
+}
+
+// n 个依次执行的 while 循环，每个循环体内有多条语句和一层嵌套循环
+static string genLoops(int n)
+{
+    string s = "int main() {\n  int s = 0, i, j;\n";
+    for (int k = 0; k < n; k++)
+    {
+        string kk = to_string(k);
+        s += "  i = 0;\n";
+        s += "  while (i < " + to_string(k % 50 + 10) + ") {\n";
+        s += "    j = i;\n";
+        s += "    while (j > 0) { s = s + j * " + kk + "; j = j / 2; if (s > 100000) break; }\n";
+        s += "    if (i % 5 == 0) { i = i + 2; continue; }\n";
+        s += "    s = s - i + " + kk + ";\n";
+        s += "    i = i + 1;\n";
+        s += "  }\n";
+    }
+    s += "  return s;\n}\n";
+    return s;
+}
+
+static const Generator generators[] = {
+    {"funcs", 64, genFuncs},
+    {"expr", 64, genExpr},
+    {"array", 4096, genArray},
+    {"blocks", 64, genBlocks},
+    {"loops", 64, genLoops},
+};
+
+// 一次测量的结果
+struct Sample
+{
+    bool ok = false;
+    double total = 0;               // 毫秒
+    map<string, double> phases;     // 阶段 -> 毫秒
+    long peak_rss = 0;              // KB
+};
+
+// 在子进程中编译，进程退出后由 wait4 得到这次编译的峰值常驻内存，各次测量互不影响
+static Sample measure(const string &src, int opt_level)
+{
+    Sample sample;
+    int fds[2];
+    if (pipe(fds) != 0)
+        return sample;
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        CompilerContext ctx;
+        TimeReport timer;
+        ctx.opt_level = opt_level;
+        ctx.timer = &timer;
+        CompileResult result;
+        double total;
+        {
+            auto start = chrono::steady_clock::now();
+            result = Compile(ctx, src, MODE_RISCV);
+            total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+        FILE *out = fdopen(fds[1], "w");
+        if (result.ok)
+        {
+            fprintf(out, "total %f\n", total);
+            for (auto &p : timer.phaseWall())
+                fprintf(out, "%s %f\n", p.first.c_str(), p.second);
+        }
+        else
+            fprintf(stderr, "bench: %s\n", result.error.c_str());
+        fclose(out);
+        _exit(result.ok ? 0 : 1);
+    }
+    close(fds[1]);
+    FILE *in = fdopen(fds[0], "r");
+    char name[64];
+    double ms;
+    while (fscanf(in, "%63s %lf", name, &ms) == 2)
+    {
+        if (string(name) == "total")
+            sample.total = ms;
+        else
+            sample.phases[name] = ms;
+    }
+    fclose(in);
+    int status;
+    rusage ru;
+    if (pid > 0 && wait4(pid, &status, 0, &ru) == pid)
+    {
+        sample.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        sample.peak_rss = ru.ru_maxrss;
+    }
+    return sample;
+}
+
+static int countLines(const string &s)
+{
+    int n = 0;
+    for (char c : s)
+        n += c == '\n';
+    return n;
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc == 4 && string(argv[1]) == "-gen")
+    {
+        for (auto &g : generators)
+        {
+            if (g.name == string(argv[2]))
+            {
+                fputs(g.gen(atoi(argv[3])).c_str(), stdout);
+                return 0;
+            }
+        }
+        fprintf(stderr, "bench: unknown kind %s\n", argv[2]);
+        return 1;
+    }
+
+    vector<const Generator *> kinds;
+    int steps = 6, repeat = 3, opt_level = 2;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "-steps" && i + 1 < argc)
+            steps = atoi(argv[++i]);
+        else if (arg == "-r" && i + 1 < argc)
+            repeat = max(1, atoi(argv[++i]));
+        else if (arg.substr(0, 2) == "-O")
+            opt_level = atoi(argv[i] + 2);
+        else
+        {
+            bool found = false;
+            for (auto &g : generators)
+            {
+                if (g.name == arg)
+                {
+                    kinds.push_back(&g);
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                fprintf(stderr, "bench: unknown kind %s\n", arg.c_str());
+                return 1;
+            }
+        }
+    }
+    if (kinds.empty())
+    {
+        for (auto &g : generators)
+            kinds.push_back(&g);
+    }
+
+    // 各阶段的列，pass 的耗时合并为 opt
+    const char *columns[] = {"parse", "irgen", "opt", "isel", "regalloc", "emit-asm"};
+    printf("%-7s %8s %8s %10s %12s", "kind", "size", "lines", "total(ms)", "lines/s");
+    for (auto c : columns)
+        printf(" %9s", c);
+    printf(" %10s\n", "rss(MB)");
+    int failed = 0;
+    for (auto g : kinds)
+    {
+        for (int step = 0, n = g->base; step < steps; step++, n *= 2)
+        {
+            string src = g->gen(n);
+            int lines = countLines(src);
+            // 取多次中最快的一次，减少噪声
+            Sample best;
+            for (int r = 0; r < repeat; r++)
+            {
+                Sample s = measure(src, opt_level);
+                if (!s.ok)
+                {
+                    best = s;
+                    break;
+                }
+                if (!best.ok || s.total < best.total)
+                    best = s;
+            }
+            if (!best.ok)
+            {
+                printf("%-7s %8d %8d FAIL\n", g->name, n, lines);
+                failed++;
+                break;      // 更大的规模同样会失败
+            }
+            map<string, double> cols;
+            for (auto &p : best.phases)
+            {
+                bool known = false;
+                for (auto c : columns)
+                    known |= p.first == c;
+                cols[known ? p.first : "opt"] += p.second;
+            }
+            printf("%-7s %8d %8d %10.2f %12.0f", g->name, n, lines, best.total, lines / best.total * 1000);
+            for (auto c : columns)
+                printf(" %9.2f", cols[c]);
+            printf(" %10.1f\n", best.peak_rss / 1024.0);
+            fflush(stdout);
+        }
+    }
+    return failed ? 1 : 0;
+}
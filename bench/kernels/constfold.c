@@ -0,0 +1,34 @@
+// 常量条件：条件恒为假的分支中含有循环（循环头的 phi 位于不可达的块中），以及可以在编译时确定的比较和算术，
+// 主要检查常量传播删除不可达的代码后结果正确，并衡量折叠掉的运算
+int main()
+{
+  int x = 0;
+  if (0) {
+    while (x < 10) x = x + 1;
+  }
+  int n = 100;
+  int debug = 0;
+  int s = 0;
+  int i = 0;
+  while (i < 20000) {
+    if (debug) {
+      int j = 0;
+      while (j < n) {
+        s = s - j;
+        j = j + 1;
+      }
+    }
+    int k = n * 4 + 1;
+    if (k > 400) s = s + i % 7 + k / n;
+    else s = s - 1;
+    if (n - 100) {
+      while (s > 0) s = s - 1;
+    }
+    i = i + 1;
+  }
+  putint(s);
+  putch(32);
+  putint(x);
+  putch(10);
+  return x;
+}
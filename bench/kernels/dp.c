@@ -0,0 +1,65 @@
+// 动态规划：两个伪随机序列的最长公共子序列，以及 0-1 背包
+const int LEN = 200;
+int x[LEN], y[LEN];
+int f[LEN + 1][LEN + 1];
+int w[60], v[60], best[1001];
+
+int max(int a, int b)
+{
+  if (a > b) return a;
+  return b;
+}
+
+int lcs()
+{
+  int i = 1;
+  while (i <= LEN) {
+    int j = 1;
+    while (j <= LEN) {
+      if (x[i - 1] == y[j - 1]) f[i][j] = f[i - 1][j - 1] + 1;
+      else f[i][j] = max(f[i - 1][j], f[i][j - 1]);
+      j = j + 1;
+    }
+    i = i + 1;
+  }
+  return f[LEN][LEN];
+}
+
+int knapsack(int n, int cap)
+{
+  int i = 0;
+  while (i < n) {
+    int c = cap;
+    while (c >= w[i]) {
+      best[c] = max(best[c], best[c - w[i]] + v[i]);
+      c = c - 1;
+    }
+    i = i + 1;
+  }
+  return best[cap];
+}
+
+int main()
+{
+  int seed = 7, i = 0;
+  while (i < LEN) {
+    seed = (seed * 75 + 74) % 65537;
+    x[i] = seed % 4;
+    seed = (seed * 75 + 74) % 65537;
+    y[i] = seed % 4;
+    i = i + 1;
+  }
+  i = 0;
+  while (i < 60) {
+    seed = (seed * 75 + 74) % 65537;
+    w[i] = seed % 50 + 1;
+    v[i] = seed / 50 % 100;
+    i = i + 1;
+  }
+  int l = lcs(), k = knapsack(60, 1000);
+  putint(l);
+  putch(32);
+  putint(k);
+  putch(10);
+  return l % 256;
+}
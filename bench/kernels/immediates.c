@@ -0,0 +1,30 @@
+// 常量操作数在 32 位整数和 12 位立即数边界附近的算术与比较，常量传播后这些常量直接出现在指令的操作数中
+// 主要检查后端把常量折叠进立即数时的范围判断：减去 INT_MIN、与 INT_MAX 比较等不能溢出
+int main()
+{
+  int min = -2147483647 - 1;
+  int max = 2147483647;
+  int s = 0;
+  int t = 0;
+  int i = 0;
+  while (i < 10000) {
+    int v = i * 3 - 15000;
+    s = s + (v - min) / 65536;
+    s = s + (v - -2048) % 1000 + (v - 2048) % 1000 + (v - 2047) % 1000 + (v + min) / 65536;
+    if (v <= max) t = t + 1;
+    if (v > max) t = t - 1000;
+    if (v <= min) t = t - 1000;
+    if (v > min) t = t + 1;
+    if (v <= 2046) t = t + 2;
+    if (v <= 2047) t = t + 3;
+    if (v > 2047) t = t + 5;
+    if (v > -2049) t = t + 7;
+    if (v >= -2048) t = t + 11;
+    i = i + 1;
+  }
+  putint(s);
+  putch(32);
+  putint(t);
+  putch(10);
+  return t % 256;
+}
@@ -0,0 +1,56 @@
+// 矩阵乘法：C = A * B，输出 C 的对角线之和和所有元素的校验和
+const int N = 24;
+int a[N][N], b[N][N], c[N][N];
+
+void init()
+{
+  int i = 0;
+  while (i < N) {
+    int j = 0;
+    while (j < N) {
+      a[i][j] = (i * 7 + j * 3) % 17 - 8;
+      b[i][j] = (i * 5 + j * 11) % 13 - 6;
+      j = j + 1;
+    }
+    i = i + 1;
+  }
+}
+
+void multiply()
+{
+  int i = 0;
+  while (i < N) {
+    int j = 0;
+    while (j < N) {
+      int k = 0, s = 0;
+      while (k < N) {
+        s = s + a[i][k] * b[k][j];
+        k = k + 1;
+      }
+      c[i][j] = s;
+      j = j + 1;
+    }
+    i = i + 1;
+  }
+}
+
+int main()
+{
+  init();
+  multiply();
+  int i = 0, trace = 0, sum = 0;
+  while (i < N) {
+    trace = trace + c[i][i];
+    int j = 0;
+    while (j < N) {
+      sum = sum * 31 + c[i][j];
+      j = j + 1;
+    }
+    i = i + 1;
+  }
+  putint(trace);
+  putch(32);
+  putint(sum);
+  putch(10);
+  return trace % 256;
+}
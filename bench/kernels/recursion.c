@@ -0,0 +1,37 @@
+// 递归：斐波那契、汉诺塔的步数和 Ackermann 函数，主要是函数调用和栈帧的开销
+int fib(int n)
+{
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+int moves;
+
+void hanoi(int n, int from, int to, int via)
+{
+  if (n == 0) return;
+  hanoi(n - 1, from, via, to);
+  moves = moves + 1;
+  hanoi(n - 1, via, to, from);
+}
+
+int ack(int m, int n)
+{
+  if (m == 0) return n + 1;
+  if (n == 0) return ack(m - 1, 1);
+  return ack(m - 1, ack(m, n - 1));
+}
+
+int main()
+{
+  int f = fib(20);
+  hanoi(12, 1, 3, 2);
+  int a = ack(2, 9);
+  putint(f);
+  putch(32);
+  putint(moves);
+  putch(32);
+  putint(a);
+  putch(10);
+  return a;
+}
@@ -0,0 +1,25 @@
+// 埃拉托斯特尼筛法：求 N 以内的素数个数和素数之和
+const int N = 30000;
+int composite[N + 1];
+
+int main()
+{
+  int i = 2, count = 0, sum = 0;
+  while (i <= N) {
+    if (!composite[i]) {
+      count = count + 1;
+      sum = sum + i;
+      int j = i * 2;
+      while (j <= N) {
+        composite[j] = 1;
+        j = j + i;
+      }
+    }
+    i = i + 1;
+  }
+  putint(count);
+  putch(32);
+  putint(sum);
+  putch(10);
+  return count % 256;
+}
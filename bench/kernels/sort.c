@@ -0,0 +1,48 @@
+// 快速排序：对伪随机生成的数组排序，检查结果有序并输出校验和
+int n;
+int a[2000];
+
+void quicksort(int arr[], int lo, int hi)
+{
+  if (lo >= hi) return;
+  int pivot = arr[(lo + hi) / 2];
+  int i = lo, j = hi;
+  while (i <= j) {
+    while (arr[i] < pivot) i = i + 1;
+    while (arr[j] > pivot) j = j - 1;
+    if (i <= j) {
+      int t = arr[i];
+      arr[i] = arr[j];
+      arr[j] = t;
+      i = i + 1;
+      j = j - 1;
+    }
+  }
+  quicksort(arr, lo, j);
+  quicksort(arr, i, hi);
+}
+
+int main()
+{
+  n = getint();
+  int seed = getint(), i = 0;
+  while (i < n) {
+    seed = (seed * 75 + 74) % 65537;
+    a[i] = seed % 10000;
+    i = i + 1;
+  }
+  quicksort(a, 0, n - 1);
+  int sorted = 1, sum = 0;
+  i = 0;
+  while (i < n) {
+    if (i > 0 && a[i - 1] > a[i]) sorted = 0;
+    sum = sum * 7 + a[i];
+    i = i + 1;
+  }
+  putint(sorted);
+  putch(32);
+  putint(sum);
+  putch(10);
+  putarray(10, a);
+  return sorted;
+}
@@ -0,0 +1,317 @@
+// 生成代码的性能回归测试：在每个优化等级下编译 bench/kernels 中的程序，分别用 IR 解释器（-interp）和 RV32IM 模拟器（-sim）运行，
+// 检查输出与 .out 文件一致，并把 IR 的动态指令数、汇编的动态指令数和估计的周期数与基线文件比较，任何一项变多即为回归
+// 用法：build/perf [-kernels 目录] [-baseline 文件] [-tolerance 百分比] [-update] [-qemu] [-sylib 文件] [内核名...]
+//       -update 用本次的结果更新基线；-qemu 另外用交叉编译器（环境变量 RISCV_CC）与 sylib 链接，在 qemu-riscv32 中运行并检查输出
+// 构建和运行见 make perf，发现回归、输出错误或运行失败时返回 1
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "compiler.hpp"
+#include "context.hpp"
+#include "driver.hpp"
+
+using namespace std;
+
+static const int MAX_OPT_LEVEL = 2;
+
+// 一个内核在一个优化等级下的结果
+struct Measure
+{
+    int ret = 0;
+    long ir_insts = 0;  // IR 解释器执行的指令数
+    long insts = 0;     // 模拟器执行的指令数
+    long cycles = 0;    // 模拟器估计的周期数
+};
+
+static bool readFile(const string &path, string &s)
+{
+    ifstream is(path, ios::binary);
+    if (!is)
+        return false;
+    stringstream ss;
+    ss << is.rdbuf();
+    s = ss.str();
+    return true;
+}
+
+static bool exists(const string &path)
+{
+    return access(path.c_str(), R_OK) == 0;
+}
+
+// 在子进程中运行 -interp 或 -sim，标准输入来自 input，标准输出收集到 output，剖析报告的内容放到 profile 中
+static bool runChild(bool sim, const string &src, const string &input, int opt_level, string &output, string &profile)
+{
+    char prof_path[] = "/tmp/perf-profile-XXXXXX";
+    int prof_fd = mkstemp(prof_path);
+    int fds[2];
+    if (prof_fd < 0 || pipe(fds) != 0)
+        return false;
+    close(prof_fd);
+    fflush(stdout);     // 否则子进程会把父进程缓冲区中的内容一并输出到管道中
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        if (!freopen(input.empty() ? "/dev/null" : input.c_str(), "r", stdin))
+            _exit(2);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        CompilerContext ctx;
+        ctx.opt_level = opt_level;
+        int ret = 0;
+        bool ok = sim ? SimulateFile(ctx, src.c_str(), prof_path, ret) : InterpretFile(ctx, src.c_str(), prof_path, ret);
+        fflush(stdout);
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    output.clear();
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+        output.append(buf, n);
+    close(fds[0]);
+    int status = 1;
+    bool ok = pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    ok = readFile(prof_path, profile) && ok;
+    unlink(prof_path);
+    return ok;
+}
+
+// 从剖析报告中取出 main 的返回值和 total 一行的前两个数
+static void parseProfile(const string &profile, int &ret, long &first, long &second)
+{
+    istringstream is(profile);
+    string line;
+    while (getline(is, line))
+    {
+        sscanf(line.c_str(), "main returned %d", &ret);
+        sscanf(line.c_str(), "total %*s %ld %ld", &first, &second);
+    }
+}
+
+// 用交叉编译器和 qemu-riscv32 运行编译出的汇编，检查输出和返回值
+static bool runQemu(const string &src, const string &input, int opt_level, const string &sylib, const string &expected,
+                    int expected_ret)
+{
+    string asm_path = "/tmp/perf-qemu.s", exe = "/tmp/perf-qemu", out_path = "/tmp/perf-qemu.out";
+    {
+        CompilerContext ctx;
+        ctx.opt_level = opt_level;
+        if (!CompileFile(ctx, "-riscv", src.c_str(), asm_path.c_str()))
+            return false;
+    }
+    const char *cc = getenv("RISCV_CC");
+    string cmd = string(cc ? cc : "riscv64-unknown-elf-gcc -march=rv32im -mabi=ilp32") + " -static -o " + exe + " " +
+                 asm_path + " " + sylib;
+    if (system(cmd.c_str()) != 0)
+        return false;
+    cmd = "qemu-riscv32 " + exe + " < " + (input.empty() ? "/dev/null" : input) + " > " + out_path;
+    int status = system(cmd.c_str());
+    string output;
+    return WIFEXITED(status) && WEXITSTATUS(status) == (expected_ret & 0xff) && readFile(out_path, output) &&
+           output == expected;
+}
+
+// 基线文件每行为 "内核 优化等级 返回值 IR指令数 汇编指令数 周期数"，# 开头的行是注释
+static map<pair<string, int>, Measure> readBaseline(const string &path)
+{
+    map<pair<string, int>, Measure> baseline;
+    ifstream is(path);
+    string line;
+    while (getline(is, line))
+    {
+        istringstream ss(line);
+        string name;
+        int level;
+        Measure m;
+        if (!(ss >> name) || name[0] == '#')
+            continue;
+        if (ss >> level >> m.ret >> m.ir_insts >> m.insts >> m.cycles)
+            baseline[{name, level}] = m;
+    }
+    return baseline;
+}
+
+static bool writeBaseline(const string &path, const map<pair<string, int>, Measure> &baseline)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f)
+        return false;
+    fprintf(f, "# 生成代码的性能基线，由 build/perf -update（make perf PERF_ARGS=-update）生成\n");
+    fprintf(f, "# 内核 优化等级 返回值 IR指令数 汇编指令数 周期数\n");
+    for (auto &r : baseline)
+        fprintf(f, "%s %d %d %ld %ld %ld\n", r.first.first.c_str(), r.first.second, r.second.ret, r.second.ir_insts,
+                r.second.insts, r.second.cycles);
+    return fclose(f) == 0;
+}
+
+// 与基线相比的变化，如 "+1.2%"
+static string delta(long cur, long base)
+{
+    if (base == 0)
+        return "";
+    char buf[32];
+    snprintf(buf, sizeof(buf), "(%+.1f%%)", (cur - base) * 100.0 / base);
+    return buf;
+}
+
+int main(int argc, const char *argv[])
+{
+    string dir = "bench/kernels", baseline_path = "bench/perf-baseline.txt", sylib = "bench/sylib.c";
+    double tolerance = 0;
+    bool update = false, qemu = false;
+    vector<string> names;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "-kernels" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "-baseline" && i + 1 < argc)
+            baseline_path = argv[++i];
+        else if (arg == "-tolerance" && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else if (arg == "-update")
+            update = true;
+        else if (arg == "-qemu")
+            qemu = true;
+        else if (arg == "-sylib" && i + 1 < argc)
+            sylib = argv[++i];
+        else if (arg[0] == '-')
+        {
+            fprintf(stderr, "perf: unknown option %s\n", arg.c_str());
+            return 1;
+        }
+        else
+            names.push_back(arg);
+    }
+    if (names.empty())
+    {
+        DIR *d = opendir(dir.c_str());
+        if (!d)
+        {
+            perror(dir.c_str());
+            return 1;
+        }
+        while (dirent *e = readdir(d))
+        {
+            string name = e->d_name;
+            if (name.size() > 2 && name.substr(name.size() - 2) == ".c")
+                names.push_back(name.substr(0, name.size() - 2));
+            else if (name.size() > 6 && name.substr(name.size() - 6) == ".koopa")
+                names.push_back(name.substr(0, name.size() - 6));
+        }
+        closedir(d);
+        sort(names.begin(), names.end());
+    }
+    if (qemu && system("command -v qemu-riscv32 > /dev/null") != 0)
+    {
+        fprintf(stderr, "perf: qemu-riscv32 not found, skipping -qemu\n");
+        qemu = false;
+    }
+
+    map<pair<string, int>, Measure> baseline = readBaseline(baseline_path);
+    map<pair<string, int>, Measure> updated = baseline;    // 只测量了部分内核时，其余的基线保持不变
+    int failed = 0, regressed = 0, improved = 0;
+    printf("%-10s %3s  %-22s %-22s %-22s %s\n", "kernel", "opt", "ir-insts", "insts", "cycles", "status");
+    for (auto &name : names)
+    {
+        // SysY 前端生成不了的控制流用 .koopa 编写，跳过前端直接导入
+        string src = dir + "/" + name + ".c";
+        if (!exists(src) && exists(dir + "/" + name + ".koopa"))
+            src = dir + "/" + name + ".koopa";
+        string input = exists(dir + "/" + name + ".in") ? dir + "/" + name + ".in" : "";
+        string expected;
+        bool has_expected = readFile(dir + "/" + name + ".out", expected);
+        for (int level = 0; level <= MAX_OPT_LEVEL; level++)
+        {
+            Measure m;
+            string interp_out, sim_out, profile;
+            long unused = 0;
+            bool ok = runChild(false, src, input, level, interp_out, profile);
+            parseProfile(profile, m.ret, m.ir_insts, unused);
+            int sim_ret = 0;
+            ok = runChild(true, src, input, level, sim_out, profile) && ok;
+            parseProfile(profile, sim_ret, m.insts, m.cycles);
+
+            // 解释器和模拟器的输出必须相同，且与 .out 一致
+            string status;
+            if (!ok)
+                status = "FAIL";
+            else if (interp_out != sim_out || m.ret != sim_ret || (has_expected && interp_out != expected))
+                status = "WRONG OUTPUT";
+            else if (qemu && !runQemu(src, input, level, sylib, interp_out, m.ret))
+                status = "QEMU MISMATCH";
+            auto it = baseline.find({name, level});
+            Measure base;
+            if (status.empty() && it == baseline.end())
+                status = "new";
+            else if (status.empty())
+            {
+                base = it->second;
+                double limit = 1 + tolerance / 100;
+                if (m.ret != base.ret)
+                    status = "WRONG OUTPUT (baseline returned " + to_string(base.ret) + ")";
+                else if (m.ir_insts > base.ir_insts * limit || m.insts > base.insts * limit ||
+                         m.cycles > base.cycles * limit)
+                {
+                    status = "REGRESSION:";
+                    if (m.ir_insts > base.ir_insts * limit)
+                        status += " ir-insts";
+                    if (m.insts > base.insts * limit)
+                        status += " insts";
+                    if (m.cycles > base.cycles * limit)
+                        status += " cycles";
+                }
+                else if (m.ir_insts < base.ir_insts || m.insts < base.insts || m.cycles < base.cycles)
+                    status = "improved";
+                else
+                    status = "ok";
+            }
+            if (status.compare(0, 10, "REGRESSION") == 0)
+                regressed++;
+            else if (status == "improved")
+                improved++;
+            else if (status != "ok" && status != "new")
+                failed++;
+            auto column = [](long cur, long base) { return to_string(cur) + " " + delta(cur, base); };
+            printf("%-10s  O%d  %-22s %-22s %-22s %s\n", name.c_str(), level, column(m.ir_insts, base.ir_insts).c_str(),
+                   column(m.insts, base.insts).c_str(), column(m.cycles, base.cycles).c_str(), status.c_str());
+            fflush(stdout);
+            updated[{name, level}] = m;
+        }
+    }
+
+    if (update)
+    {
+        if (failed)
+        {
+            fprintf(stderr, "perf: not updating the baseline, %d runs failed\n", failed);
+            return 1;
+        }
+        if (!writeBaseline(baseline_path, updated))
+        {
+            perror(baseline_path.c_str());
+            return 1;
+        }
+        printf("baseline written to %s\n", baseline_path.c_str());
+        return 0;
+    }
+    if (failed || regressed)
+    {
+        fprintf(stderr, "perf: %d regressions, %d failures\n", regressed, failed);
+        return 1;
+    }
+    if (improved)
+        printf("%d measurements improved, run with -update to lower the baseline\n", improved);
+    return 0;
+}
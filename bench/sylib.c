@@ -0,0 +1,49 @@
+// 运行库的最小实现，perf -qemu 用交叉编译器把它和编译出的汇编链接在一起，行为与模拟器中的库函数一致
+#include <stdio.h>
+
+int getint(void)
+{
+    int x = 0;
+    scanf("%d", &x);
+    return x;
+}
+
+int getch(void)
+{
+    return getchar();
+}
+
+int getarray(int a[])
+{
+    int n = 0;
+    scanf("%d", &n);
+    for (int i = 0; i < n; i++)
+        scanf("%d", &a[i]);
+    return n;
+}
+
+void putint(int x)
+{
+    printf("%d", x);
+}
+
+void putch(int c)
+{
+    putchar(c);
+}
+
+void putarray(int n, int a[])
+{
+    printf("%d:", n);
+    for (int i = 0; i < n; i++)
+        printf(" %d", a[i]);
+    printf("\n");
+}
+
+void starttime(void)
+{
+}
+
+void stoptime(void)
+{
+}
@@ -0,0 +1,462 @@
+#include <climits>
+#include <unordered_set>
+#include "include/mir.hpp"
+
+using namespace std;
+
+// George & Appel 的迭代寄存器合并，各工作表和函数名与论文保持一致
+// 预着色结点为可分配的物理寄存器，不可分配的物理寄存器（x0, sp, ra, t0~t2 等）不参与构图
+// 实际溢出的结点不重写程序重新分配，而是像线性扫描一样借助保留的 t0/t1 访问栈帧
+class IRCAllocator
+{
+private:
+    enum NodeState
+    {
+        PRECOLORED,
+        INITIAL,
+        SIMPLIFY,
+        FREEZE,
+        SPILL,
+        SPILLED,
+        COALESCED,
+        COLORED,
+        SELECTED
+    };
+    enum MoveState
+    {
+        M_COALESCED,
+        M_CONSTRAINED,
+        M_FROZEN,
+        M_WORKLIST,
+        M_ACTIVE
+    };
+    struct Move
+    {
+        int dst, src;
+    };
+
+    MachineFunction &mf;
+    int n;
+    vector<NodeState> state;
+    vector<vector<int>> adj_list;
+    unordered_set<uint64_t> adj_set;
+    vector<int> degree, alias, color;
+    vector<double> cost;
+    vector<vector<int>> move_list;
+    vector<Move> moves;
+    vector<MoveState> move_state;
+    unordered_set<int> simplify_wl, freeze_wl, spill_wl;
+    unordered_set<int> worklist_moves;
+    vector<int> select_stack;
+
+    bool relevant(int r) const
+    {
+        return isVirtual(r) || isAllocatable(r);
+    }
+
+    bool adjacentTo(int u, int v) const
+    {
+        return adj_set.count((uint64_t)u << 32 | v);
+    }
+
+    void addEdge(int u, int v)
+    {
+        if (u == v || adjacentTo(u, v))
+            return;
+        adj_set.insert((uint64_t)u << 32 | v);
+        adj_set.insert((uint64_t)v << 32 | u);
+        if (state[u] != PRECOLORED)
+        {
+            adj_list[u].push_back(v);
+            degree[u]++;
+        }
+        if (state[v] != PRECOLORED)
+        {
+            adj_list[v].push_back(u);
+            degree[v]++;
+        }
+    }
+
+    // 构建冲突图，同时记录 mv 指令和按循环深度加权的溢出代价
+    void build()
+    {
+        vector<RegSet> live_in, live_out;
+        ComputeLiveness(mf, live_in, live_out);
+        vector<int> defs, uses;
+        for (auto &bb : mf.blocks)
+        {
+            double weight = 1;
+            for (int i = 0; i < bb->loop_depth && i < 8; i++)
+                weight *= 10;
+            RegSet live = live_out[bb->index];
+            for (int i = (int)bb->insts.size() - 1; i >= 0; i--)
+            {
+                const MachineInst &inst = bb->insts[i];
+                inst.defs(defs);
+                inst.uses(uses);
+                for (int r : defs)
+                    cost[r] += weight;
+                for (int r : uses)
+                    cost[r] += weight;
+                if (inst.isMove() && relevant(inst.rd) && relevant(inst.rs1) && inst.rd != inst.rs1)
+                {
+                    // mv 的源和目的之间不必冲突，这样才有机会合并
+                    live.reset(inst.rs1);
+                    moves.push_back({inst.rd, inst.rs1});
+                    move_state.push_back(M_WORKLIST);
+                    move_list[inst.rd].push_back(moves.size() - 1);
+                    move_list[inst.rs1].push_back(moves.size() - 1);
+                    worklist_moves.insert(moves.size() - 1);
+                }
+                for (int d : defs)
+                {
+                    if (!relevant(d))
+                        continue;
+                    live.forEach([&](int l) {
+                        if (relevant(l))
+                            addEdge(l, d);
+                    });
+                }
+                for (int d : defs)
+                    live.reset(d);
+                for (int u : uses)
+                    live.set(u);
+            }
+        }
+    }
+
+    template <typename F>
+    void forAdjacent(int v, F f)
+    {
+        for (int t : adj_list[v])
+        {
+            if (state[t] != SELECTED && state[t] != COALESCED)
+                f(t);
+        }
+    }
+
+    template <typename F>
+    void forNodeMoves(int v, F f)
+    {
+        for (int m : move_list[v])
+        {
+            if (move_state[m] == M_ACTIVE || move_state[m] == M_WORKLIST)
+                f(m);
+        }
+    }
+
+    bool moveRelated(int v)
+    {
+        bool related = false;
+        forNodeMoves(v, [&](int) { related = true; });
+        return related;
+    }
+
+    void makeWorklist()
+    {
+        for (int v = VREG_BASE; v < n; v++)
+        {
+            if (state[v] != INITIAL)
+                continue;
+            if (degree[v] >= ALLOC_NUM)
+            {
+                state[v] = SPILL;
+                spill_wl.insert(v);
+            }
+            else if (moveRelated(v))
+            {
+                state[v] = FREEZE;
+                freeze_wl.insert(v);
+            }
+            else
+            {
+                state[v] = SIMPLIFY;
+                simplify_wl.insert(v);
+            }
+        }
+    }
+
+    void enableMoves(int v)
+    {
+        forNodeMoves(v, [&](int m) {
+            if (move_state[m] == M_ACTIVE)
+            {
+                move_state[m] = M_WORKLIST;
+                worklist_moves.insert(m);
+            }
+        });
+    }
+
+    void decrementDegree(int m)
+    {
+        if (state[m] == PRECOLORED)
+            return;
+        int d = degree[m]--;
+        if (d == ALLOC_NUM)
+        {
+            enableMoves(m);
+            forAdjacent(m, [&](int t) { enableMoves(t); });
+            spill_wl.erase(m);
+            if (moveRelated(m))
+            {
+                state[m] = FREEZE;
+                freeze_wl.insert(m);
+            }
+            else
+            {
+                state[m] = SIMPLIFY;
+                simplify_wl.insert(m);
+            }
+        }
+    }
+
+    void simplify()
+    {
+        int v = *simplify_wl.begin();
+        simplify_wl.erase(simplify_wl.begin());
+        state[v] = SELECTED;
+        select_stack.push_back(v);
+        for (int t : adj_list[v])
+        {
+            if (state[t] != SELECTED && state[t] != COALESCED)
+                decrementDegree(t);
+        }
+    }
+
+    int getAlias(int v)
+    {
+        while (state[v] == COALESCED)
+            v = alias[v];
+        return v;
+    }
+
+    void addWorkList(int u)
+    {
+        if (state[u] != PRECOLORED && !moveRelated(u) && degree[u] < ALLOC_NUM)
+        {
+            freeze_wl.erase(u);
+            state[u] = SIMPLIFY;
+            simplify_wl.insert(u);
+        }
+    }
+
+    // George 准则：v 的每个邻居要么度数低，要么已经与 u 冲突
+    bool ok(int t, int r)
+    {
+        return degree[t] < ALLOC_NUM || state[t] == PRECOLORED || adjacentTo(t, r);
+    }
+
+    // Briggs 准则：合并后高度数的邻居少于 K 个
+    bool conservative(int u, int v)
+    {
+        unordered_set<int> seen;
+        int k = 0;
+        auto count = [&](int t) {
+            if (seen.insert(t).second && degree[t] >= ALLOC_NUM)
+                k++;
+        };
+        forAdjacent(u, count);
+        forAdjacent(v, count);
+        return k < ALLOC_NUM;
+    }
+
+    void combine(int u, int v)
+    {
+        if (freeze_wl.erase(v) == 0)
+            spill_wl.erase(v);
+        state[v] = COALESCED;
+        alias[v] = u;
+        move_list[u].insert(move_list[u].end(), move_list[v].begin(), move_list[v].end());
+        enableMoves(v);
+        vector<int> neighbors;
+        forAdjacent(v, [&](int t) { neighbors.push_back(t); });
+        for (int t : neighbors)
+        {
+            addEdge(t, u);
+            decrementDegree(t);
+        }
+        if (degree[u] >= ALLOC_NUM && state[u] == FREEZE)
+        {
+            freeze_wl.erase(u);
+            state[u] = SPILL;
+            spill_wl.insert(u);
+        }
+    }
+
+    void coalesce()
+    {
+        int m = *worklist_moves.begin();
+        worklist_moves.erase(worklist_moves.begin());
+        int x = getAlias(moves[m].dst), y = getAlias(moves[m].src);
+        int u = x, v = y;
+        if (state[y] == PRECOLORED)
+        {
+            u = y;
+            v = x;
+        }
+        if (u == v)
+        {
+            move_state[m] = M_COALESCED;
+            addWorkList(u);
+        }
+        else if (state[v] == PRECOLORED || adjacentTo(u, v))
+        {
+            move_state[m] = M_CONSTRAINED;
+            addWorkList(u);
+            addWorkList(v);
+        }
+        else
+        {
+            bool can = true;
+            if (state[u] == PRECOLORED)
+                forAdjacent(v, [&](int t) { can = can && ok(t, u); });
+            else
+                can = conservative(u, v);
+            if (can)
+            {
+                move_state[m] = M_COALESCED;
+                combine(u, v);
+                addWorkList(u);
+            }
+            else
+                move_state[m] = M_ACTIVE;
+        }
+    }
+
+    void freezeMoves(int u)
+    {
+        forNodeMoves(u, [&](int m) {
+            int x = getAlias(moves[m].dst), y = getAlias(moves[m].src);
+            int v = y == getAlias(u) ? x : y;
+            move_state[m] = M_FROZEN;
+            worklist_moves.erase(m);
+            if (state[v] == FREEZE && !moveRelated(v) && degree[v] < ALLOC_NUM)
+            {
+                freeze_wl.erase(v);
+                state[v] = SIMPLIFY;
+                simplify_wl.insert(v);
+            }
+        });
+    }
+
+    void freeze()
+    {
+        int u = *freeze_wl.begin();
+        freeze_wl.erase(freeze_wl.begin());
+        state[u] = SIMPLIFY;
+        simplify_wl.insert(u);
+        freezeMoves(u);
+    }
+
+    // 选择 代价/度数 最小的结点作为潜在溢出结点，循环中的值代价更高
+    void selectSpill()
+    {
+        int best = -1;
+        for (int v : spill_wl)
+        {
+            if (best < 0 || cost[v] / degree[v] < cost[best] / degree[best])
+                best = v;
+        }
+        spill_wl.erase(best);
+        state[best] = SIMPLIFY;
+        simplify_wl.insert(best);
+        freezeMoves(best);
+    }
+
+    void assignColors()
+    {
+        while (select_stack.size())
+        {
+            int v = select_stack.back();
+            select_stack.pop_back();
+            vector<bool> forbidden(VREG_BASE);
+            for (int t : adj_list[v])
+            {
+                int a = getAlias(t);
+                if (state[a] == COLORED || state[a] == PRECOLORED)
+                    forbidden[color[a]] = true;
+            }
+            state[v] = SPILLED;
+            for (int i = 0; i < ALLOC_NUM; i++)
+            {
+                if (!forbidden[alloc_order[i]])
+                {
+                    state[v] = COLORED;
+                    color[v] = alloc_order[i];
+                    break;
+                }
+            }
+        }
+    }
+
+public:
+    IRCAllocator(MachineFunction &_mf) : mf(_mf), n(_mf.vreg_count)
+    {
+        state.assign(n, INITIAL);
+        color.assign(n, -1);
+        for (int r = 0; r < VREG_BASE; r++)
+        {
+            state[r] = PRECOLORED;
+            color[r] = r;
+        }
+        adj_list.assign(n, {});
+        degree.assign(n, 0);
+        for (int r = 0; r < VREG_BASE; r++)
+            degree[r] = INT_MAX / 2;
+        alias.assign(n, -1);
+        cost.assign(n, 0);
+        move_list.assign(n, {});
+    }
+
+    // 冲突图等数据结构占用的字节数（估计），冲突图在 build 之后最大
+    size_t memoryUsage() const
+    {
+        size_t bytes = adj_set.size() * (sizeof(uint64_t) + 2 * sizeof(void *)) + adj_set.bucket_count() * sizeof(void *) +
+                       n * (2 * sizeof(vector<int>) + sizeof(NodeState) + 3 * sizeof(int) + sizeof(double)) +
+                       moves.capacity() * (sizeof(Move) + sizeof(MoveState));
+        for (int v = 0; v < n; v++)
+            bytes += (adj_list[v].capacity() + move_list[v].capacity()) * sizeof(int);
+        return bytes;
+    }
+
+    void run()
+    {
+        build();
+        mf.regalloc_bytes = mf.livenessBytes() + memoryUsage();
+        makeWorklist();
+        while (simplify_wl.size() || worklist_moves.size() || freeze_wl.size() || spill_wl.size())
+        {
+            if (simplify_wl.size())
+                simplify();
+            else if (worklist_moves.size())
+                coalesce();
+            else if (freeze_wl.size())
+                freeze();
+            else
+                selectSpill();
+        }
+        assignColors();
+
+        // 合并的结点与其代表结点使用同一个寄存器或同一个槽位
+        vector<int> phys(n, -1), slots(n, -1);
+        for (int v = VREG_BASE; v < n; v++)
+        {
+            if (state[v] == SPILLED)
+                slots[v] = mf.newSlot(4);
+        }
+        for (int v = VREG_BASE; v < n; v++)
+        {
+            int a = getAlias(v);
+            if (state[a] == SPILLED)
+                slots[v] = slots[a];
+            else
+                phys[v] = color[a];
+        }
+        RewriteVRegs(mf, phys, slots);
+    }
+};
+
+void GraphColoring(MachineFunction &mf)
+{
+    IRCAllocator(mf).run();
+}
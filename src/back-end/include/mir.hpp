@@ -0,0 +1,306 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// RISC-V 机器指令层的 IR（MIR），指令选择时使用无限多的虚拟寄存器，寄存器分配后改写为物理寄存器
+// 寄存器编号：0~31 为物理寄存器 x0~x31，从 VREG_BASE 开始为虚拟寄存器
+const int VREG_BASE = 32;
+
+enum PhysReg
+{
+    ZERO = 0, RA = 1, SP = 2,
+    T0 = 5, T1 = 6, T2 = 7,
+    S0 = 8, S1 = 9,
+    A0 = 10, A7 = 17,
+    S2 = 18, S11 = 27,
+    T3 = 28, T6 = 31
+};
+
+inline const char *regName(int reg)
+{
+    static const char *names[] = {
+        "x0", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+        "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+        "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+        "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
+    return names[reg];
+}
+
+inline bool isVirtual(int reg)
+{
+    return reg >= VREG_BASE;
+}
+
+// 调用者保存的寄存器，call 之后其值不再可用
+inline bool isCallerSaved(int reg)
+{
+    return reg == RA || (reg >= T0 && reg <= T2) || (reg >= A0 && reg <= A7) || reg >= T3;
+}
+
+inline bool isCalleeSaved(int reg)
+{
+    return reg == S0 || reg == S1 || (reg >= S2 && reg <= S11);
+}
+
+// t0~t2 保留给溢出代码和大立即数，不参与分配
+inline bool isScratch(int reg)
+{
+    return reg >= T0 && reg <= T2;
+}
+
+// 可以分配给虚拟寄存器的物理寄存器
+inline bool isAllocatable(int reg)
+{
+    return reg != RA && !isScratch(reg) && (isCallerSaved(reg) || isCalleeSaved(reg));
+}
+
+// 分配顺序：先用调用者保存的寄存器，用完后再用需要保存恢复的 s 寄存器
+const int ALLOC_NUM = 24;
+const int alloc_order[ALLOC_NUM] = {
+    T3, 29, 30, T6, A7, 16, 15, 14, 13, 12, 11, A0,
+    S1, S0, S2, 19, 20, 21, 22, 23, 24, 25, 26, S11};
+
+class MachineInst
+{
+public:
+    enum TAG
+    {
+        RTYPE,  // op rd, rs1, rs2
+        ITYPE,  // op rd, rs1, imm
+        UNARY,  // op rd, rs1，如 mv, seqz, snez
+        LI,     // li rd, imm
+        LA,     // la rd, sym
+        LW,     // lw rd, imm(rs1)
+        SW,     // sw rs2, imm(rs1)
+        BRANCH, // op rs1, sym，如 bnez
+        J,      // j sym
+        CALL,   // call sym，使用 a0~a(imm-1) 传参，破坏所有调用者保存的寄存器
+        RET     // ret，imm 为 1 时使用 a0 返回
+    };
+
+    TAG tag;
+    string op;
+    int rd = -1, rs1 = -1, rs2 = -1;
+    int imm = 0;
+    string sym;     // 标号或全局符号
+    int slot = -1;  // 非负时 LW/SW/ITYPE 相对 sp 访问该栈帧槽位，实际偏移量为槽位偏移加 imm，在栈帧确定后计算
+
+    MachineInst(TAG _tag, const string &_op = "") : tag(_tag), op(_op) {}
+
+    // 该指令写入的寄存器
+    void defs(vector<int> &regs) const
+    {
+        regs.clear();
+        if (tag == CALL)
+        {
+            for (int r = 1; r < VREG_BASE; r++)
+            {
+                if (isCallerSaved(r))
+                    regs.push_back(r);
+            }
+        }
+        else if (rd >= 0)
+            regs.push_back(rd);
+    }
+
+    // 该指令读取的寄存器
+    void uses(vector<int> &regs) const
+    {
+        regs.clear();
+        if (tag == CALL)
+        {
+            for (int i = 0; i < imm && i < 8; i++)
+                regs.push_back(A0 + i);
+            return;
+        }
+        if (tag == RET)
+        {
+            if (imm)
+                regs.push_back(A0);
+            return;
+        }
+        if (rs1 >= 0)
+            regs.push_back(rs1);
+        if (rs2 >= 0)
+            regs.push_back(rs2);
+    }
+
+    bool isMove() const
+    {
+        return tag == UNARY && op == "mv";
+    }
+};
+
+class MachineBlock
+{
+public:
+    string label;
+    int index;      // 在 MachineFunction::blocks 中的位置
+    int loop_depth = 0; // 所在循环的嵌套深度，用于估计溢出代价
+    vector<MachineInst> insts;
+    vector<MachineBlock *> succs, preds;
+
+    MachineBlock(const string &_label, int _index) : label(_label), index(_index) {}
+};
+
+class MachineFunction
+{
+public:
+    string name;
+    vector<unique_ptr<MachineBlock>> blocks;  // 按输出顺序排列，第一个为入口
+    int vreg_count = VREG_BASE;               // 已使用的寄存器编号上界
+    vector<int> slot_size;                    // 栈帧中各槽位的大小（字节）
+    vector<int> slot_arg;                     // 非负时该槽位是调用者栈帧中的第几个栈上参数
+    vector<int> slot_offset;                  // 各槽位相对 sp 的偏移量，由 layoutFrame 计算
+    vector<int> saved_regs;                   // 用到的被调用者保存寄存器，需要在序言中保存
+    bool has_call = false;                    // 是否调用了其他函数，叶子函数不需要保存 ra
+    int out_args = 0;                         // 传给被调用函数的栈上参数所占的字节数
+    int ra_offset = 0, save_offset = 0;       // ra 和 s 寄存器的保存位置
+    int frame_size = 0;
+    size_t regalloc_bytes = 0;                // 寄存器分配中活跃性和冲突图等临时数据的峰值（估计），用于 --mem-report
+
+    MachineFunction(const string &_name) : name(_name) {}
+
+    // 机器指令和基本块占用的字节数（估计）
+    size_t memoryUsage() const
+    {
+        size_t n = sizeof(MachineFunction) + blocks.capacity() * sizeof(void *);
+        for (auto &bb : blocks)
+            n += sizeof(MachineBlock) + bb->insts.capacity() * sizeof(MachineInst) +
+                 (bb->succs.capacity() + bb->preds.capacity()) * sizeof(void *);
+        return n;
+    }
+
+    // 活跃性分析中每个基本块的 use、def、live_in 和 live_out 四个位集合
+    size_t livenessBytes() const
+    {
+        return 4 * blocks.size() * ((vreg_count + 63) / 64 * sizeof(uint64_t));
+    }
+
+    int newVReg()
+    {
+        return vreg_count++;
+    }
+
+    int newSlot(int size)
+    {
+        slot_size.push_back(size);
+        slot_arg.push_back(-1);
+        return slot_size.size() - 1;
+    }
+
+    // 第 k 个（从 0 开始）通过栈传入的参数，位于调用者的栈帧中
+    int newArgSlot(int k)
+    {
+        slot_size.push_back(0);
+        slot_arg.push_back(k);
+        return slot_size.size() - 1;
+    }
+
+    MachineBlock *newBlock(const string &label)
+    {
+        blocks.emplace_back(new MachineBlock(label, blocks.size()));
+        return blocks.back().get();
+    }
+
+    // 计算栈帧布局，从低地址到高地址依次为：
+    // 传给被调用函数的栈上参数 | ra | s 寄存器 | 局部槽位（小的在前，使溢出槽位的偏移量尽量落在 12 位立即数内）
+    // 总大小按 16 字节对齐，栈上传入的参数位于 sp + frame_size 之上
+    void layoutFrame()
+    {
+        int offset = out_args;
+        ra_offset = offset;
+        if (has_call)
+            offset += 4;
+        save_offset = offset;
+        offset += saved_regs.size() * 4;
+
+        vector<int> order;
+        for (int i = 0; i < (int)slot_size.size(); i++)
+        {
+            if (slot_arg[i] < 0)
+                order.push_back(i);
+        }
+        stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return slot_size[a] < slot_size[b];
+        });
+        slot_offset.assign(slot_size.size(), 0);
+        for (int i : order)
+        {
+            slot_offset[i] = offset;
+            offset += slot_size[i];
+        }
+        frame_size = (offset + 15) / 16 * 16;
+        for (int i = 0; i < (int)slot_size.size(); i++)
+        {
+            if (slot_arg[i] >= 0)
+                slot_offset[i] = frame_size + 4 * slot_arg[i];
+        }
+    }
+};
+
+// 寄存器集合（位图），用于活跃变量分析
+class RegSet
+{
+private:
+    vector<uint64_t> bits;
+
+public:
+    RegSet(int n = 0) : bits((n + 63) / 64) {}
+
+    bool test(int r) const
+    {
+        return bits[r >> 6] >> (r & 63) & 1;
+    }
+
+    void set(int r)
+    {
+        bits[r >> 6] |= 1ull << (r & 63);
+    }
+
+    void reset(int r)
+    {
+        bits[r >> 6] &= ~(1ull << (r & 63));
+    }
+
+    // 并入 other，返回是否有变化
+    bool unionWith(const RegSet &other)
+    {
+        bool changed = false;
+        for (int i = 0; i < (int)bits.size(); i++)
+        {
+            uint64_t old = bits[i];
+            bits[i] |= other.bits[i];
+            changed |= bits[i] != old;
+        }
+        return changed;
+    }
+
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (int i = 0; i < (int)bits.size(); i++)
+        {
+            for (uint64_t w = bits[i]; w; w &= w - 1)
+                f(i * 64 + __builtin_ctzll(w));
+        }
+    }
+};
+
+// 活跃变量分析，live_in/live_out 按基本块的 index 索引，包含物理寄存器和虚拟寄存器
+void ComputeLiveness(const MachineFunction &mf, vector<RegSet> &live_in, vector<RegSet> &live_out);
+
+// 按分配结果把虚拟寄存器改写为物理寄存器，phys 为 -1 的寄存器溢出到 slots 指定的槽位，
+// 借助 t0/t1 在使用前读取、定义后写回；同时记录需要保存的 s 寄存器
+void RewriteVRegs(MachineFunction &mf, const vector<int> &phys, const vector<int> &slots);
+
+// 线性扫描寄存器分配，将 mf 中的虚拟寄存器改写为物理寄存器，必要时溢出到栈帧
+void LinearScan(MachineFunction &mf);
+
+// 迭代寄存器合并（Iterated Register Coalescing）的图着色分配，编译较慢但溢出和 mv 更少，-O2 时使用
+void GraphColoring(MachineFunction &mf);
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+class Writer;
+
+// 模拟执行的统计，按函数（.text 中不以 .L 开头的标号）汇总
+class SimProfile
+{
+public:
+    struct Func
+    {
+        string name;
+        long calls = 0;         // 被调用的次数
+        long insts = 0;         // 执行的指令数，li/la 按展开后的指令数计算
+        long cycles = 0;        // 按代价模型估计的周期数
+        long loads = 0, stores = 0;
+        long load_stalls = 0;   // 等待 load 结果的周期数
+        long muldiv_stalls = 0; // 等待乘除法结果的周期数
+        long taken = 0;         // 发生跳转的分支数
+    };
+
+    vector<Func> funcs;         // 按在汇编中出现的顺序
+    int ret = 0;                // main 的返回值
+
+    void print(Writer &out) const;
+};
+
+// 汇编并在 RV32IM 模拟器上执行编译器输出的汇编（-sim），用于在没有 RISC-V 环境的机器上比较后端的改动
+// 代价模型是单发射的顺序流水线：每条指令 1 个周期，结果的延迟为 load 2、mul 3、div/rem 20 个周期，
+// 读取尚未就绪的寄存器时停顿；条件分支发生跳转时多 2 个周期，j/call 多 1 个周期，ret 等间接跳转多 2 个周期
+// 库函数由模拟器直接实现，只计入 call 指令本身：getint/getch/getarray 从 in 读入，putint/putch/putarray 输出到 out
+// 正常结束时返回 true；汇编错误、非法访存等在 error 中给出原因并返回 false，此时 profile 中是已执行部分的数据
+bool Simulate(string_view assembly, FILE *in, FILE *out, SimProfile &profile, string &error);
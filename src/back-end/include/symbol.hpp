@@ -5,41 +5,95 @@
 #include <vector>
 #include <queue>
 #include <memory>
-#include "koopa.h"
+#include "../../middle-end/include/dominance.hpp"
+#include "../../middle-end/include/ir.hpp"
+#include "mir.hpp"
 
 using namespace std;
 
-// Riscv的数据管理器
+// Riscv的数据管理器，记录当前函数指令选择的状态
+// 指令选择只产生虚拟寄存器，由寄存器分配器决定实际使用的物理寄存器
 class RiscvDateManager
 { 
 public:
-    int register_num;     // 寄存器分配号
+    int opt_level;          // 优化等级，-O2 及以上使用图着色分配寄存器
+    MachineFunction *mf;    // 当前函数
+    MachineBlock *cur;      // 当前插入指令的基本块
 
-    unordered_map<koopa_raw_value_t, int> regmap;    // 当前指令对应的寄存器号
+    unordered_map<const IRValue *, int> regmap;    // IR中的值对应的虚拟寄存器
+    unordered_map<const IRValue *, int> slotmap;   // alloc 对应的栈帧槽位
+    unordered_map<const IRBasicBlock *, MachineBlock *> blockmap;  // IR基本块对应的机器基本块
+    int edge_cnt;           // 为关键边新建的基本块数
+    const DominatorTree *dt;    // 当前函数的支配树，用于识别回边
 
-    RiscvDateManager() : register_num(0){}
+    RiscvDateManager() : opt_level(1), mf(nullptr), cur(nullptr), edge_cnt(0), dt(nullptr) {}
     ~RiscvDateManager() = default;
 
-    void reset(){       //刚进入函数的时候可以将ir信息恢复为初值
-        register_num = 0;
+    void reset(MachineFunction *_mf){       //刚进入函数的时候可以将信息恢复为初值
+        mf = _mf;
+        cur = nullptr;
+        regmap.clear();
+        slotmap.clear();
+        blockmap.clear();
+        edge_cnt = 0;
     }
-    // 生成一个新的的寄存器
-    string getNewReg(){
-        string reg;
-        if (register_num > 6)
-            reg = "a" + to_string(register_num-7);
-        else
-            reg = "t" + to_string(register_num);
-        register_num++;
-        return reg;
+    // 生成一个新的虚拟寄存器
+    int newReg(){
+        return mf->newVReg();
     }
-    // 获取当前指令对应的寄存器,暂时不考虑用完的情况
-    string get_reg(const koopa_raw_value_t &value)
+    // 在当前基本块末尾插入一条指令
+    MachineInst &emit(MachineInst::TAG tag, const string &op = ""){
+        cur->insts.emplace_back(tag, op);
+        return cur->insts.back();
+    }
+    // IR中的值对应的虚拟寄存器，第一次访问时分配；phi 的值可能在定义之前就被前驱使用
+    int vreg(const IRValue *value)
+    {
+        auto it = regmap.find(value);
+        if (it != regmap.end())
+            return it->second;
+        return regmap[value] = newReg();
+    }
+    // 获取 IR中的值所在的寄存器，整数常量先用 li 读入寄存器，0 和 undef 直接使用 x0
+    // 局部数组和全局变量的地址在每次使用时重新计算，不占用长期存活的寄存器
+    int get_reg(const IRValue *value)
+    {
+        switch (value->tag)
+        {
+        case IRValue::INTEGER:
+        {
+            if (value->value == 0)
+                return ZERO;
+            MachineInst &li = emit(MachineInst::LI, "li");
+            li.rd = newReg();
+            li.imm = value->value;
+            return li.rd;
+        }
+        case IRValue::UNDEF:
+            return ZERO;
+        case IRValue::ALLOC:
+        {
+            MachineInst &addi = emit(MachineInst::ITYPE, "addi");
+            addi.rd = newReg();
+            addi.rs1 = SP;
+            addi.slot = slotmap.at(value);
+            return addi.rd;
+        }
+        case IRValue::GLOBAL_ALLOC:
+        {
+            MachineInst &la = emit(MachineInst::LA, "la");
+            la.rd = newReg();
+            la.sym = value->name.substr(1);
+            return la.rd;
+        }
+        default:
+            return vreg(value);
+        }
+    }
+    // 控制流图的边，供活跃变量分析使用
+    void addEdge(MachineBlock *from, MachineBlock *to)
     {
-        // 当t0~t6用完时,用a0~a7
-        if (regmap[value] > 6)
-            return "a" + to_string(regmap[value] - 7);
-        else
-            return "t" + to_string(regmap[value]);
+        from->succs.push_back(to);
+        to->preds.push_back(from);
     }
-};
\ No newline at end of file
+};
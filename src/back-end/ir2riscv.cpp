@@ -4,20 +4,33 @@
 #include <fstream>
 #include <unordered_map>
 #include "../util.hpp"
+#include "../middle-end/include/dominance.hpp"
 #include "include/symbol.hpp"
+#include "../threadpool.hpp"
+#include "../memreport.hpp"
+#include "../timer.hpp"
 
 using namespace std;
 
-// 重载 Visit，遍历访问每一种 Koopa IR结构
-void Visit(const koopa_raw_program_t &program);
-void Visit(const koopa_raw_slice_t &slice);
-void Visit(const koopa_raw_function_t &func);
-void Visit(const koopa_raw_basic_block_t &bb);
-void Visit(const koopa_raw_value_t &value);
-void Visit(const koopa_raw_return_t &ret);
-void Visit(const koopa_raw_integer_t &integer);
-void Visit_binary(const koopa_raw_value_t &value);
-void get_left_right_reg(koopa_raw_value_t l, koopa_raw_value_t r, string &lreg, string &rreg);
+// 重载 Visit，遍历访问每一种 IR结构，生成使用虚拟寄存器的机器指令
+// 指令选择的状态保存在每个函数自己的 RiscvDateManager 中，汇编写入调用者给出的 RiscvString
+void Visit(IRProgram &program, RiscvString &rvs, int opt_level, ThreadPool *pool = nullptr, TimeReport *timer = nullptr,
+           MemReport *mem = nullptr);
+void Visit_global(RiscvString &rvs, const IRValue *global);
+void Visit(RiscvString &rvs, IRFunction *func, int opt_level, TimeReport *timer = nullptr, MemReport *mem = nullptr);
+void Visit(RiscvDateManager &dm, const IRBasicBlock *bb);
+void Visit(RiscvDateManager &dm, const IRValue *value);
+void Visit_ret(RiscvDateManager &dm, const IRValue *value);
+void Visit_binary(RiscvDateManager &dm, const IRValue *value);
+void Visit_alloc(RiscvDateManager &dm, const IRValue *value);
+void Visit_load(RiscvDateManager &dm, const IRValue *value);
+void Visit_store(RiscvDateManager &dm, const IRValue *value);
+void Visit_getptr(RiscvDateManager &dm, const IRValue *value);
+void Visit_branch(RiscvDateManager &dm, const IRValue *value);
+void Visit_jump(RiscvDateManager &dm, const IRValue *value);
+void Visit_call(RiscvDateManager &dm, const IRValue *value);
+// 寄存器分配之后输出汇编
+void Emit(RiscvString &rvs, MachineFunction &mf);
 
 // 查询 value对应的指令
 const char *op2inst[] = {
@@ -26,190 +39,727 @@ const char *op2inst[] = {
     "rem", "and", "or", "xor",
     "sll", "srl", "sra"};
 
-RiscvString rvs;
-RiscvDateManager dm;
+// 能否作为 12 位立即数
+static bool isImm12(int v)
+{
+    return v >= -2048 && v <= 2047;
+}
+
+static MachineInst &rtype(RiscvDateManager &dm, const string &op, int rd, int rs1, int rs2)
+{
+    MachineInst &inst = dm.emit(MachineInst::RTYPE, op);
+    inst.rd = rd;
+    inst.rs1 = rs1;
+    inst.rs2 = rs2;
+    return inst;
+}
+
+static MachineInst &itype(RiscvDateManager &dm, const string &op, int rd, int rs1, int imm)
+{
+    MachineInst &inst = dm.emit(MachineInst::ITYPE, op);
+    inst.rd = rd;
+    inst.rs1 = rs1;
+    inst.imm = imm;
+    return inst;
+}
+
+static MachineInst &unary(RiscvDateManager &dm, const string &op, int rd, int rs1)
+{
+    MachineInst &inst = dm.emit(MachineInst::UNARY, op);
+    inst.rd = rd;
+    inst.rs1 = rs1;
+    return inst;
+}
 
-// 函数声明略
-// ...
+// 把 IR中的值放入指定的寄存器，常量直接 li
+static void move_to(RiscvDateManager &dm, int rd, const IRValue *value)
+{
+    if (value->tag == IRValue::INTEGER && value->value != 0)
+    {
+        MachineInst &li = dm.emit(MachineInst::LI, "li");
+        li.rd = rd;
+        li.imm = value->value;
+    }
+    else
+        unary(dm, "mv", rd, dm.get_reg(value));
+}
 
-// 访问 raw program
-void Visit(const koopa_raw_program_t &program)
+// 访问 IR program，opt_level 决定使用的寄存器分配算法
+// pool 非空时各函数并行生成，分别写入自己的缓冲区，最后按源码顺序拼接，与串行的输出完全相同
+// 增量编译时复用的函数直接输出缓存的汇编，需要存入缓存的函数写入自己的 output
+// timer 非空时记录每个函数指令选择、寄存器分配和输出汇编的耗时，mem 非空时记录机器指令和缓冲区占用的内存
+void Visit(IRProgram &program, RiscvString &rvs, int opt_level, ThreadPool *pool, TimeReport *timer, MemReport *mem)
 {
     // 访问所有全局变量
-    Visit(program.values);
+    for (auto global : program.globals)
+        Visit_global(rvs, global);
     // 访问所有函数
-    Visit(program.funcs);
+    vector<IRFunction *> defs;
+    for (auto func : program.funcs)
+    {
+        if (!func->isDecl())
+            defs.push_back(func);
+    }
+    if (!pool || defs.size() <= 1)
+    {
+        for (auto func : defs)
+        {
+            if (func->record)
+            {
+                Writer out(&func->output);
+                RiscvString func_rvs;
+                func_rvs.setWriter(&out);
+                Visit(func_rvs, func, opt_level, timer, mem);
+            }
+            if (func->reused || func->record)
+                rvs.append(func->output);
+            else
+                Visit(rvs, func, opt_level, timer, mem);
+        }
+        return;
+    }
+    vector<string> bufs(defs.size());
+    pool->parallelFor(defs.size(), [&](int i) {
+        if (defs[i]->reused)
+            return;
+        Writer out(defs[i]->record ? &defs[i]->output : &bufs[i]);
+        RiscvString func_rvs;
+        func_rvs.setWriter(&out);
+        Visit(func_rvs, defs[i], opt_level, timer, mem);
+    });
+    // 各函数的汇编在拼接之前同时保存在内存中
+    size_t buf_bytes = 0;
+    for (auto &buf : bufs)
+        buf_bytes += buf.capacity();
+    if (mem)
+        mem->add("output", buf_bytes);
+    for (int i = 0; i < (int)defs.size(); i++)
+        rvs.append(defs[i]->reused || defs[i]->record ? defs[i]->output : bufs[i]);
+    if (mem)
+        mem->sub("output", buf_bytes);
+}
+
+// 把初始值展开为 4 字节的字，连续的 0 合并为 .zero
+static void flatten(const IRValue *init, vector<int> &words)
+{
+    if (init->tag == IRValue::INTEGER)
+        words.push_back(init->value);
+    else if (init->tag == IRValue::AGGREGATE)
+    {
+        for (auto elem : init->ops)
+            flatten(elem, words);
+    }
+    else
+        words.insert(words.end(), init->ty->size() / 4, 0);
 }
 
-// 访问 raw slice
-void Visit(const koopa_raw_slice_t &slice)
+// 访问全局变量
+void Visit_global(RiscvString &rvs, const IRValue *global)
 {
-    for (size_t i = 0; i < slice.len; ++i)
+    string name = global->name.substr(1);
+    rvs.append("  .data\n");
+    rvs.one(".globl", name);
+    rvs.label(name);
+    vector<int> words;
+    flatten(global->ops[0], words);
+    for (int i = 0; i < (int)words.size();)
     {
-        auto ptr = slice.buffer[i];
-        // 根据 slice 的 kind 决定将 ptr 视作何种元素
-        switch (slice.kind)
+        if (words[i])
         {
-        case KOOPA_RSIK_FUNCTION:
-            // 访问函数
-            Visit(reinterpret_cast<koopa_raw_function_t>(ptr));
-            break;
-        case KOOPA_RSIK_BASIC_BLOCK:
-            // 访问基本块
-            Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
-            break;
-        case KOOPA_RSIK_VALUE:
-            // 访问指令
-            Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
-            break;
-        default:
-            // 我们暂时不会遇到其他内容, 于是不对其做任何处理
-            assert(false);
+            rvs.one(".word", words[i]);
+            i++;
+            continue;
         }
+        int j = i;
+        while (j < (int)words.size() && words[j] == 0)
+            j++;
+        rvs.one(".zero", 4 * (j - i));
+        i = j;
     }
+    rvs.append("\n");
 }
 
 // 访问函数
-void Visit(const koopa_raw_function_t &func)
+void Visit(RiscvString &rvs, IRFunction *func, int opt_level, TimeReport *timer, MemReport *mem)
 {
     // 如果是函数声明则跳过
-    if (func->bbs.len == 0)
+    if (func->isDecl())
         return;
-    dm.reset();
-    string func_name = string(func->name).substr(1);
-    rvs.append("  .text\n");
-    rvs.append("  .globl " + func_name + "\n");
-    rvs.append(func_name + ":\n");
-    // 访问所有基本块
-    Visit(func->bbs);
+    MachineFunction mf(func->name.substr(1));
+    {
+        ScopedTimer t(timer, "isel", &func->name);
+        RiscvDateManager dm;
+        dm.opt_level = opt_level;
+        dm.reset(&mf);
+        func->buildCFG();
+        DominatorTree dt(func);
+        dm.dt = &dt;
+        // 先为所有基本块创建对应的机器基本块，跳转时可以直接引用
+        for (auto bb : func->bbs)
+            dm.blockmap[bb] = mf.newBlock(".L" + mf.name + "_" + bb->name.substr(1));
+
+        // 前 8 个参数通过 a0~a7 传入，其余的在调用者的栈帧中
+        dm.cur = dm.blockmap[func->entry()];
+        for (int i = 0; i < (int)func->params.size(); i++)
+        {
+            int reg = dm.vreg(func->params[i]);
+            if (i < 8)
+                unary(dm, "mv", reg, A0 + i);
+            else
+            {
+                MachineInst &lw = dm.emit(MachineInst::LW, "lw");
+                lw.rd = reg;
+                lw.rs1 = SP;
+                lw.slot = mf.newArgSlot(i - 8);
+            }
+        }
+        // 访问所有基本块
+        for (auto bb : func->bbs)
+            Visit(dm, bb);
+    }
+
+    {
+        ScopedTimer t(timer, "regalloc", &func->name);
+        if (opt_level >= 2)
+        {
+            // 图着色按循环深度估计溢出代价
+            func->buildCFG();
+            DominatorTree dt(func);
+            vector<int> depth = dt.loopDepth();
+            for (int i = 0; i < (int)func->bbs.size(); i++)
+            {
+                auto it = dt.index.find(func->bbs[i]);
+                if (it != dt.index.end())
+                    mf.blocks[i]->loop_depth = depth[it->second];
+            }
+            // 关键边上新建的基本块与其后继处在同一循环中
+            for (int i = func->bbs.size(); i < (int)mf.blocks.size(); i++)
+                mf.blocks[i]->loop_depth = mf.blocks[i]->succs[0]->loop_depth;
+            GraphColoring(mf);
+        }
+        else
+            LinearScan(mf);
+    }
+    // 寄存器分配结束时机器指令最多，与分配中的临时数据一起计为该函数的峰值；并行时各函数同时占用
+    size_t bytes = mf.memoryUsage() + mf.regalloc_bytes;
+    if (mem)
+        mem->add("backend", bytes);
+    {
+        ScopedTimer t(timer, "emit-asm", &func->name);
+        Emit(rvs, mf);
+    }
+    if (mem)
+        mem->sub("backend", bytes);
 }
 
 // 访问基本块
-void Visit(const koopa_raw_basic_block_t &bb)
+void Visit(RiscvDateManager &dm, const IRBasicBlock *bb)
 {
-    // inputstr.append()
+    dm.cur = dm.blockmap.at(bb);
     // 访问所有指令
-    Visit(bb->insts);
+    for (auto inst : bb->insts)
+        Visit(dm, inst);
 }
 
 // 访问指令
-void Visit(const koopa_raw_value_t &value)
+void Visit(RiscvDateManager &dm, const IRValue *value)
 {
     // 根据指令类型判断后续需要如何访问
-    const auto &kind = value->kind;
-    switch (kind.tag)
+    switch (value->tag)
     {
-    case KOOPA_RVT_RETURN:
+    case IRValue::RETURN:
         // 访问 return 指令
-        Visit(kind.data.ret);
-        break;
-    case KOOPA_RVT_INTEGER:
-        // 访问 integer 指令
-        Visit(kind.data.integer);
+        Visit_ret(dm, value);
         break;
-    case KOOPA_RVT_BINARY:
+    case IRValue::BINARY:
         // 访问 binary 指令
-        Visit_binary(value);
+        Visit_binary(dm, value);
+        break;
+    case IRValue::ALLOC:
+        Visit_alloc(dm, value);
+        break;
+    case IRValue::LOAD:
+        Visit_load(dm, value);
+        break;
+    case IRValue::STORE:
+        Visit_store(dm, value);
+        break;
+    case IRValue::GET_PTR:
+    case IRValue::GET_ELEM_PTR:
+        Visit_getptr(dm, value);
+        break;
+    case IRValue::BRANCH:
+        Visit_branch(dm, value);
+        break;
+    case IRValue::JUMP:
+        Visit_jump(dm, value);
+        break;
+    case IRValue::CALL:
+        Visit_call(dm, value);
+        break;
+    case IRValue::PHI:
+        // phi 的值由前驱在跳转前写入，这里不生成指令
         break;
     default:
-        // 其他类型暂时遇不到
         assert(false);
     }
 }
 
 // 访问 return 指令
-void Visit(const koopa_raw_return_t &ret)
+void Visit_ret(RiscvDateManager &dm, const IRValue *value)
 {
-    if (ret.value)
+    MachineInst ret(MachineInst::RET, "ret");
+    if (value->ops.size())
     {
-        koopa_raw_value_t ret_value = ret.value;
-        // 特判return为一个整数情况
-        if (ret_value->kind.tag == KOOPA_RVT_INTEGER)
-        {
-            rvs.append("  li\ta0, ");
-            Visit(ret_value->kind.data.integer);
-            rvs.append("\n");
-        }
-        else
-        { // value指向了上一条指令的结果寄存器
-            string reg = dm.get_reg(ret_value);
-            rvs.two("mv", "a0", reg);
-        }
+        // 返回值放在 a0 中
+        move_to(dm, A0, value->ops[0]);
+        ret.imm = 1;
     }
-    rvs.ret();
+    dm.cur->insts.push_back(ret);
 }
 
-// 访问 integer 指令
-void Visit(const koopa_raw_integer_t &integer)
+// 访问binary指令，右操作数为小常量时尽量使用立即数形式的指令
+void Visit_binary(RiscvDateManager &dm, const IRValue *value)
 {
-    rvs.append(to_string(integer.value));
-}
+    const IRValue *l = value->ops[0], *r = value->ops[1];
+    IRValue::OP op = value->op;
+    // 可交换的运算把常量换到右边
+    bool commutative = op == IRValue::ADD || op == IRValue::MUL || op == IRValue::AND ||
+                       op == IRValue::OR || op == IRValue::XOR || op == IRValue::EQ || op == IRValue::NOT_EQ;
+    if (commutative && l->tag == IRValue::INTEGER && r->tag != IRValue::INTEGER)
+        swap(l, r);
+    int ans = dm.vreg(value);
 
-// 访问binary指令
-void Visit_binary(const koopa_raw_value_t &value)
-{
-    koopa_raw_binary_t binary = value->kind.data.binary;
-    string lreg, rreg;
-    get_left_right_reg(binary.lhs, binary.rhs, lreg, rreg);
-    string ans = dm.getNewReg();
-    dm.regmap[value] = dm.register_num - 1;
+    if (r->tag == IRValue::INTEGER)
+    {
+        int c = r->value;
+        switch (op)
+        {
+        case IRValue::ADD:
+            if (isImm12(c))
+            {
+                itype(dm, "addi", ans, dm.get_reg(l), c);
+                return;
+            }
+            break;
+        case IRValue::SUB:
+            if (c != INT32_MIN && isImm12(-c))
+            {
+                itype(dm, "addi", ans, dm.get_reg(l), -c);
+                return;
+            }
+            break;
+        case IRValue::AND:
+        case IRValue::OR:
+        case IRValue::XOR:
+            if (isImm12(c))
+            {
+                itype(dm, string(op2inst[op]) + "i", ans, dm.get_reg(l), c);
+                return;
+            }
+            break;
+        case IRValue::SHL:
+        case IRValue::SHR:
+        case IRValue::SAR:
+            itype(dm, string(op2inst[op]) + "i", ans, dm.get_reg(l), c & 31);
+            return;
+        case IRValue::MUL:
+            // 乘以 2 的幂转为左移
+            if (c > 0 && (c & (c - 1)) == 0)
+            {
+                itype(dm, "slli", ans, dm.get_reg(l), __builtin_ctz(c));
+                return;
+            }
+            break;
+        case IRValue::LT:
+            if (isImm12(c))
+            {
+                itype(dm, "slti", ans, dm.get_reg(l), c);
+                return;
+            }
+            break;
+        case IRValue::GE:
+            if (isImm12(c))
+            {
+                int tmp = dm.newReg();
+                itype(dm, "slti", tmp, dm.get_reg(l), c);
+                itype(dm, "xori", ans, tmp, 1);
+                return;
+            }
+            break;
+        case IRValue::LE:
+            // l <= c 即 l < c + 1
+            if (c != INT32_MAX && isImm12(c + 1))
+            {
+                itype(dm, "slti", ans, dm.get_reg(l), c + 1);
+                return;
+            }
+            break;
+        case IRValue::GT:
+            if (c != INT32_MAX && isImm12(c + 1))
+            {
+                int tmp = dm.newReg();
+                itype(dm, "slti", tmp, dm.get_reg(l), c + 1);
+                itype(dm, "xori", ans, tmp, 1);
+                return;
+            }
+            break;
+        case IRValue::EQ:
+        case IRValue::NOT_EQ:
+        {
+            const char *set = op == IRValue::EQ ? "seqz" : "snez";
+            if (c == 0)
+            {
+                unary(dm, set, ans, dm.get_reg(l));
+                return;
+            }
+            if (isImm12(c))
+            {
+                int tmp = dm.newReg();
+                itype(dm, "xori", tmp, dm.get_reg(l), c);
+                unary(dm, set, ans, tmp);
+                return;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    int lreg = dm.get_reg(l);
+    int rreg = dm.get_reg(r);
     // 根据运算符类型判断后续如何翻译
-    switch (binary.op)
+    switch (op)
     {
-    case KOOPA_RBO_NOT_EQ:
-        rvs.binary("xor", ans, lreg, rreg);
-        rvs.two("snez", ans, ans);
+    case IRValue::NOT_EQ:
+    {
+        int tmp = dm.newReg();
+        rtype(dm, "xor", tmp, lreg, rreg);
+        unary(dm, "snez", ans, tmp);
         break;
-    case KOOPA_RBO_EQ:
-        rvs.binary("xor", ans, lreg, rreg);
-        rvs.two("seqz", ans, ans);
+    }
+    case IRValue::EQ:
+    {
+        int tmp = dm.newReg();
+        rtype(dm, "xor", tmp, lreg, rreg);
+        unary(dm, "seqz", ans, tmp);
         break;
-    case KOOPA_RBO_GE:
-        rvs.binary("slt", ans, lreg, rreg);
-        rvs.two("seqz", ans, ans);
+    }
+    case IRValue::GE:
+    {
+        int tmp = dm.newReg();
+        rtype(dm, "slt", tmp, lreg, rreg);
+        unary(dm, "seqz", ans, tmp);
         break;
-    case KOOPA_RBO_LE:
-        rvs.binary("sgt", ans, lreg, rreg);
-        rvs.two("seqz", ans, ans);
+    }
+    case IRValue::LE:
+    {
+        int tmp = dm.newReg();
+        rtype(dm, "sgt", tmp, lreg, rreg);
+        unary(dm, "seqz", ans, tmp);
         break;
+    }
     default:
-        string op = op2inst[(int)binary.op];
-        rvs.binary(op, ans, lreg, rreg);
+        rtype(dm, op2inst[(int)op], ans, lreg, rreg);
         break;
     }
-    return;
 }
 
-// 找到操作数对应的寄存器
-void get_left_right_reg(koopa_raw_value_t l, koopa_raw_value_t r, string &lreg, string &rreg)
+// 访问 alloc 指令，在栈帧中分配槽位
+void Visit_alloc(RiscvDateManager &dm, const IRValue *value)
+{
+    dm.slotmap[value] = dm.mf->newSlot(value->ty->base->size());
+}
+
+// 访问 load 指令，局部变量直接相对 sp 读取
+void Visit_load(RiscvDateManager &dm, const IRValue *value)
+{
+    const IRValue *src = value->ops[0];
+    MachineInst lw(MachineInst::LW, "lw");
+    if (src->tag == IRValue::ALLOC)
+    {
+        lw.rs1 = SP;
+        lw.slot = dm.slotmap.at(src);
+    }
+    else
+        lw.rs1 = dm.get_reg(src);
+    lw.rd = dm.vreg(value);
+    dm.cur->insts.push_back(lw);
+}
+
+// 访问 store 指令
+void Visit_store(RiscvDateManager &dm, const IRValue *value)
 {
-    int cnt = 0;
-    if (l->kind.tag == KOOPA_RVT_INTEGER)
+    const IRValue *dest = value->ops[1];
+    MachineInst sw(MachineInst::SW, "sw");
+    sw.rs2 = dm.get_reg(value->ops[0]);
+    if (dest->tag == IRValue::ALLOC)
     {
-        if (l->kind.data.integer.value == 0)
-            lreg = "x0";
-        else
+        sw.rs1 = SP;
+        sw.slot = dm.slotmap.at(dest);
+    }
+    else
+        sw.rs1 = dm.get_reg(dest);
+    dm.cur->insts.push_back(sw);
+}
+
+// 访问 getelemptr/getptr 指令：地址 = 基址 + 下标 * 元素大小
+void Visit_getptr(RiscvDateManager &dm, const IRValue *value)
+{
+    const IRValue *src = value->ops[0], *index = value->ops[1];
+    int elem_size = value->tag == IRValue::GET_ELEM_PTR ? src->ty->base->base->size() : src->ty->base->size();
+    int ans = dm.vreg(value);
+    if (index->tag == IRValue::INTEGER)
+    {
+        // 常量下标直接加到偏移量上，局部数组与槽位的偏移量合并
+        int offset = index->value * elem_size;
+        if (src->tag == IRValue::ALLOC)
         {
-            lreg = dm.getNewReg();
-            cnt++;
-            rvs.li(lreg, l->kind.data.integer.value);
+            MachineInst &addi = itype(dm, "addi", ans, SP, offset);
+            addi.slot = dm.slotmap.at(src);
         }
+        else if (offset)
+            itype(dm, "addi", ans, dm.get_reg(src), offset);
+        else
+            unary(dm, "mv", ans, dm.get_reg(src));
+        return;
     }
+    int base = dm.get_reg(src);
+    int idx = dm.get_reg(index);
+    int scaled = dm.newReg();
+    if ((elem_size & (elem_size - 1)) == 0)
+        itype(dm, "slli", scaled, idx, __builtin_ctz(elem_size));
     else
-        lreg = dm.get_reg(l);
-    if (r->kind.tag == KOOPA_RVT_INTEGER)
     {
-        if (r->kind.data.integer.value == 0)
-            rreg = "x0";
-        else
+        int size_reg = dm.newReg();
+        MachineInst &li = dm.emit(MachineInst::LI, "li");
+        li.rd = size_reg;
+        li.imm = elem_size;
+        rtype(dm, "mul", scaled, idx, size_reg);
+    }
+    rtype(dm, "add", ans, base, scaled);
+}
+
+// 跳转到 to 之前为它的 phi 写入从 from 传入的值
+// 这些复制在语义上是并行的：只有当某个传入值本身就是 to 的 phi 时才需要经过临时寄存器
+static void copy_phis(RiscvDateManager &dm, const IRBasicBlock *from, const IRBasicBlock *to)
+{
+    int n = to->phiCount();
+    bool parallel = false;
+    for (int i = 0; i < n; i++)
+    {
+        const IRValue *v = to->insts[i]->getIncoming(from);
+        if (v && v->tag == IRValue::PHI && v->bb == to)
+            parallel = true;
+    }
+    vector<int> tmps;
+    for (int i = 0; i < n; i++)
+    {
+        const IRValue *phi = to->insts[i];
+        const IRValue *v = phi->getIncoming(from);
+        if (!v)
+            v = to->func->prog->getUndef(phi->ty);
+        int rd = parallel ? dm.newReg() : dm.vreg(phi);
+        move_to(dm, rd, v);
+        tmps.push_back(rd);
+    }
+    if (parallel)
+    {
+        for (int i = 0; i < n; i++)
+            unary(dm, "mv", dm.vreg(to->insts[i]), tmps[i]);
+    }
+}
+
+static void jump(RiscvDateManager &dm, MachineBlock *target)
+{
+    MachineInst &j = dm.emit(MachineInst::J, "j");
+    j.sym = target->label;
+    dm.addEdge(dm.cur, target);
+}
+
+// 为从 bb 到 to 的边新建一个基本块，放置 to 中 phi 的复制后跳到 to
+static MachineBlock *edge_block(RiscvDateManager &dm, const IRBasicBlock *bb, const IRBasicBlock *to)
+{
+    MachineBlock *cur = dm.cur;
+    MachineBlock *edge = dm.mf->newBlock(".L" + dm.mf->name + "_edge_" + to_string(dm.edge_cnt++));
+    dm.cur = edge;
+    copy_phis(dm, bb, to);
+    jump(dm, dm.blockmap.at(to));
+    dm.cur = cur;
+    return edge;
+}
+
+// 访问 br 指令：bnez 跳到真分支，否则落到后面的 j 跳到假分支
+// 真分支有 phi 时这条边是关键边，需要新建一个基本块放置 phi 的复制
+// 假分支的复制一般放在 bnez 之后；但如果假分支支配当前块（回边），它的 phi 的旧值可能在真分支上仍被使用，
+// 而按基本块计算的活跃区间会认为旧值在 bnez 处已经失效，此时同样放到新建的基本块中
+void Visit_branch(RiscvDateManager &dm, const IRValue *value)
+{
+    const IRBasicBlock *bb = value->bb;
+    const IRBasicBlock *t = value->targets[0], *f = value->targets[1];
+    if (t == f)
+    {
+        copy_phis(dm, bb, t);
+        jump(dm, dm.blockmap.at(t));
+        return;
+    }
+    MachineBlock *t_block = t->phiCount() ? edge_block(dm, bb, t) : dm.blockmap.at(t);
+    auto fi = dm.dt->index.find(f), bi = dm.dt->index.find(bb);
+    bool back_edge = fi != dm.dt->index.end() && bi != dm.dt->index.end() && dm.dt->dominates(fi->second, bi->second);
+    MachineBlock *f_block = back_edge && f->phiCount() ? edge_block(dm, bb, f) : dm.blockmap.at(f);
+    int cond = dm.get_reg(value->ops[0]);
+    MachineInst &bnez = dm.emit(MachineInst::BRANCH, "bnez");
+    bnez.rs1 = cond;
+    bnez.sym = t_block->label;
+    dm.addEdge(dm.cur, t_block);
+    if (f_block == dm.blockmap.at(f))
+        copy_phis(dm, bb, f);
+    jump(dm, f_block);
+}
+
+// 访问 jump 指令
+void Visit_jump(RiscvDateManager &dm, const IRValue *value)
+{
+    copy_phis(dm, value->bb, value->targets[0]);
+    jump(dm, dm.blockmap.at(value->targets[0]));
+}
+
+// 访问 call 指令：前 8 个参数放入 a0~a7，其余的从 sp 开始依次存放
+void Visit_call(RiscvDateManager &dm, const IRValue *value)
+{
+    int n = value->ops.size();
+    for (int i = 8; i < n; i++)
+    {
+        MachineInst sw(MachineInst::SW, "sw");
+        sw.rs2 = dm.get_reg(value->ops[i]);
+        sw.rs1 = SP;
+        sw.imm = 4 * (i - 8);
+        dm.cur->insts.push_back(sw);
+    }
+    for (int i = 0; i < n && i < 8; i++)
+        move_to(dm, A0 + i, value->ops[i]);
+    MachineInst &call = dm.emit(MachineInst::CALL, "call");
+    call.sym = value->callee->name.substr(1);
+    call.imm = min(n, 8);
+    dm.mf->has_call = true;
+    dm.mf->out_args = max(dm.mf->out_args, 4 * (n - 8));
+    if (value->hasResult())
+        unary(dm, "mv", dm.vreg(value), A0);
+}
+
+// 立即数超出 12 位时借助 t2 计算
+static void emit_addi(RiscvString &rvs, string_view rd, string_view rs, int imm)
+{
+    if (isImm12(imm))
+        rvs.binary("addi", rd, rs, imm);
+    else
+    {
+        rvs.li("t2", imm);
+        rvs.binary("add", rd, rs, "t2");
+    }
+}
+
+static void emit_mem(RiscvString &rvs, string_view op, string_view reg, string_view base, int offset)
+{
+    if (isImm12(offset))
+        rvs.mem(op, reg, offset, base);
+    else
+    {
+        rvs.li("t2", offset);
+        rvs.binary("add", "t2", "t2", base);
+        rvs.mem(op, reg, 0, "t2");
+    }
+}
+
+// 输出函数的汇编
+// 序言分配栈帧并保存 ra 和用到的 s 寄存器，每个 ret 前恢复；不需要栈帧的叶子函数没有序言和尾声
+void Emit(RiscvString &rvs, MachineFunction &mf)
+{
+    mf.layoutFrame();
+    auto epilogue = [&]() {
+        if (mf.has_call)
+            emit_mem(rvs, "lw", "ra", "sp", mf.ra_offset);
+        for (int i = 0; i < (int)mf.saved_regs.size(); i++)
+            emit_mem(rvs, "lw", regName(mf.saved_regs[i]), "sp", mf.save_offset + 4 * i);
+        if (mf.frame_size)
+            emit_addi(rvs, "sp", "sp", mf.frame_size);
+    };
+
+    rvs.append("  .text\n");
+    rvs.one(".globl", mf.name);
+    rvs.label(mf.name);
+    if (mf.frame_size)
+        emit_addi(rvs, "sp", "sp", -mf.frame_size);
+    if (mf.has_call)
+        emit_mem(rvs, "sw", "ra", "sp", mf.ra_offset);
+    for (int i = 0; i < (int)mf.saved_regs.size(); i++)
+        emit_mem(rvs, "sw", regName(mf.saved_regs[i]), "sp", mf.save_offset + 4 * i);
+
+    for (int b = 0; b < (int)mf.blocks.size(); b++)
+    {
+        auto &bb = mf.blocks[b];
+        auto &insts = bb->insts;
+        string next = b + 1 < (int)mf.blocks.size() ? mf.blocks[b + 1]->label : "";
+        // 跳转到下一个块的 j 可以省略；bnez 跳到下一个块时反转条件，省去后面的 j
+        int n = insts.size();
+        if (n >= 2 && insts[n - 2].tag == MachineInst::BRANCH && insts[n - 1].tag == MachineInst::J &&
+            insts[n - 2].sym == next)
+        {
+            insts[n - 2].op = insts[n - 2].op == "bnez" ? "beqz" : "bnez";
+            insts[n - 2].sym = insts[n - 1].sym;
+            insts.pop_back();
+        }
+        if (b || bb->preds.size())
+            rvs.label(bb->label);
+        for (int i = 0; i < (int)insts.size(); i++)
         {
-            rreg = dm.getNewReg();
-            cnt++;
-            rvs.li(rreg, r->kind.data.integer.value);
+            const MachineInst &inst = insts[i];
+            int offset = inst.imm;
+            if (inst.slot >= 0)
+                offset += mf.slot_offset[inst.slot];
+            switch (inst.tag)
+            {
+            case MachineInst::RTYPE:
+                rvs.binary(inst.op, regName(inst.rd), regName(inst.rs1), regName(inst.rs2));
+                break;
+            case MachineInst::ITYPE:
+                if (inst.op == "addi")
+                    emit_addi(rvs, regName(inst.rd), regName(inst.rs1), offset);
+                else
+                    rvs.binary(inst.op, regName(inst.rd), regName(inst.rs1), offset);
+                break;
+            case MachineInst::UNARY:
+                rvs.two(inst.op, regName(inst.rd), regName(inst.rs1));
+                break;
+            case MachineInst::LI:
+                rvs.li(regName(inst.rd), inst.imm);
+                break;
+            case MachineInst::LA:
+                rvs.two("la", regName(inst.rd), inst.sym);
+                break;
+            case MachineInst::LW:
+                emit_mem(rvs, "lw", regName(inst.rd), regName(inst.rs1), offset);
+                break;
+            case MachineInst::SW:
+                emit_mem(rvs, "sw", regName(inst.rs2), regName(inst.rs1), offset);
+                break;
+            case MachineInst::BRANCH:
+                rvs.two(inst.op, regName(inst.rs1), inst.sym);
+                break;
+            case MachineInst::J:
+                if (i + 1 < (int)insts.size() || inst.sym != next)
+                    rvs.one("j", inst.sym);
+                break;
+            case MachineInst::CALL:
+                rvs.one("call", inst.sym);
+                break;
+            case MachineInst::RET:
+                epilogue();
+                rvs.ret();
+                break;
+            }
         }
     }
-    else
-        rreg = dm.get_reg(r);
-    dm.register_num -= cnt;
-    return;
-}
\ No newline at end of file
+    rvs.append("\n");
+}
@@ -0,0 +1,49 @@
+#include "include/mir.hpp"
+
+using namespace std;
+
+void ComputeLiveness(const MachineFunction &mf, vector<RegSet> &live_in, vector<RegSet> &live_out)
+{
+    int n = mf.blocks.size();
+    vector<RegSet> use(n, RegSet(mf.vreg_count)), def(n, RegSet(mf.vreg_count));
+    vector<int> regs;
+    for (auto &bb : mf.blocks)
+    {
+        RegSet &u = use[bb->index], &d = def[bb->index];
+        for (auto &inst : bb->insts)
+        {
+            // 先读后写：同一条指令读取的寄存器在写入之前
+            inst.uses(regs);
+            for (int r : regs)
+            {
+                if (!d.test(r))
+                    u.set(r);
+            }
+            inst.defs(regs);
+            for (int r : regs)
+                d.set(r);
+        }
+    }
+
+    live_in.assign(n, RegSet(mf.vreg_count));
+    live_out.assign(n, RegSet(mf.vreg_count));
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        // 逆序遍历收敛更快
+        for (int i = n - 1; i >= 0; i--)
+        {
+            const MachineBlock *bb = mf.blocks[i].get();
+            for (auto succ : bb->succs)
+                live_out[i].unionWith(live_in[succ->index]);
+            // live_in = use ∪ (live_out - def)
+            RegSet in = use[i];
+            live_out[i].forEach([&](int r) {
+                if (!def[i].test(r))
+                    in.set(r);
+            });
+            changed |= live_in[i].unionWith(in);
+        }
+    }
+}
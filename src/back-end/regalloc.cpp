@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <unordered_map>
+#include "include/mir.hpp"
+
+using namespace std;
+
+// 一个寄存器的活跃区间，由若干个互不相交的 [from, to] 组成
+// 第 i 条指令读取寄存器的位置为 2i，写入的位置为 2i+1
+class Interval
+{
+public:
+    int reg;
+    vector<pair<int, int>> ranges;
+    int hint = -1;      // 与之有 mv 关系的物理寄存器，优先分配
+    int phys = -1;      // 分配到的物理寄存器，-1 表示溢出
+    int slot = -1;      // 溢出时使用的栈帧槽位
+
+    int start() const { return ranges.front().first; }
+    int end() const { return ranges.back().second; }
+
+    // 排序并合并相邻的区间
+    void normalize()
+    {
+        sort(ranges.begin(), ranges.end());
+        int n = 0;
+        for (auto &r : ranges)
+        {
+            if (n && r.first <= ranges[n - 1].second + 1)
+                ranges[n - 1].second = max(ranges[n - 1].second, r.second);
+            else
+                ranges[n++] = r;
+        }
+        ranges.resize(n);
+    }
+
+    bool overlaps(const vector<pair<int, int>> &other) const
+    {
+        int i = 0, j = 0;
+        while (i < (int)ranges.size() && j < (int)other.size())
+        {
+            if (ranges[i].second < other[j].first)
+                i++;
+            else if (other[j].second < ranges[i].first)
+                j++;
+            else
+                return true;
+        }
+        return false;
+    }
+};
+
+// 跨越 call 的区间与调用者保存寄存器在 call 处的定义冲突，自然只能分配到 s 寄存器
+
+// 根据活跃变量分析构建每个寄存器的活跃区间
+static void buildIntervals(const MachineFunction &mf, vector<Interval> &intervals)
+{
+    vector<RegSet> live_in, live_out;
+    ComputeLiveness(mf, live_in, live_out);
+    intervals.assign(mf.vreg_count, Interval());
+    for (int r = 0; r < mf.vreg_count; r++)
+        intervals[r].reg = r;
+
+    int pos = 0;
+    vector<int> regs;
+    for (auto &bb : mf.blocks)
+    {
+        int from = pos, to = pos + 2 * (int)bb->insts.size() - 1;
+        pos = to + 1;
+        // 从块尾向前扫描，open 记录当前活跃寄存器区间的终点
+        unordered_map<int, int> open;
+        live_out[bb->index].forEach([&](int r) { open[r] = to; });
+        for (int i = (int)bb->insts.size() - 1; i >= 0; i--)
+        {
+            const MachineInst &inst = bb->insts[i];
+            int p = from + 2 * i;
+            inst.defs(regs);
+            for (int r : regs)
+            {
+                auto it = open.find(r);
+                if (it != open.end())
+                {
+                    intervals[r].ranges.push_back({p + 1, it->second});
+                    open.erase(it);
+                }
+                else
+                    intervals[r].ranges.push_back({p + 1, p + 1});
+            }
+            inst.uses(regs);
+            for (int r : regs)
+            {
+                if (!open.count(r))
+                    open[r] = p;
+            }
+            // 与物理寄存器之间的 mv 作为分配提示，如传参和返回值
+            if (inst.isMove())
+            {
+                if (isVirtual(inst.rd) && !isVirtual(inst.rs1))
+                    intervals[inst.rd].hint = inst.rs1;
+                if (isVirtual(inst.rs1) && !isVirtual(inst.rd))
+                    intervals[inst.rs1].hint = inst.rd;
+            }
+        }
+        for (auto &it : open)
+            intervals[it.first].ranges.push_back({from, it.second});
+    }
+    for (auto &interval : intervals)
+        interval.normalize();
+}
+
+void RewriteVRegs(MachineFunction &mf, const vector<int> &phys, const vector<int> &slots)
+{
+    for (auto &bb : mf.blocks)
+    {
+        vector<MachineInst> insts;
+        for (auto inst : bb->insts)
+        {
+            int *srcs[] = {&inst.rs1, &inst.rs2};
+            int scratch[] = {T0, T1};
+            for (int k = 0; k < 2; k++)
+            {
+                int &r = *srcs[k];
+                if (r < 0 || !isVirtual(r))
+                    continue;
+                if (phys[r] >= 0)
+                    r = phys[r];
+                else
+                {
+                    MachineInst load(MachineInst::LW, "lw");
+                    load.rd = scratch[k];
+                    load.rs1 = SP;
+                    load.slot = slots[r];
+                    insts.push_back(load);
+                    r = scratch[k];
+                }
+            }
+            bool spill_def = false;
+            int slot = -1;
+            if (inst.rd >= 0 && isVirtual(inst.rd))
+            {
+                if (phys[inst.rd] >= 0)
+                    inst.rd = phys[inst.rd];
+                else
+                {
+                    spill_def = true;
+                    slot = slots[inst.rd];
+                    inst.rd = T0;
+                }
+            }
+            if (inst.isMove() && spill_def)
+            {
+                // 写入溢出寄存器的 mv 直接把源寄存器存入槽位
+                MachineInst store(MachineInst::SW, "sw");
+                store.rs2 = inst.rs1;
+                store.rs1 = SP;
+                store.slot = slot;
+                insts.push_back(store);
+                continue;
+            }
+            if (inst.isMove() && inst.rs1 == T0 && insts.back().tag == MachineInst::LW && insts.back().rd == T0)
+            {
+                // 从溢出寄存器读出的 mv 直接读入目的寄存器
+                insts.back().rd = inst.rd;
+                continue;
+            }
+            // 分配到同一寄存器的 mv 可以删去
+            if (inst.isMove() && inst.rd == inst.rs1)
+                continue;
+            insts.push_back(inst);
+            if (spill_def)
+            {
+                MachineInst store(MachineInst::SW, "sw");
+                store.rs2 = T0;
+                store.rs1 = SP;
+                store.slot = slot;
+                insts.push_back(store);
+            }
+        }
+        bb->insts.swap(insts);
+    }
+
+    // 记录用到的被调用者保存寄存器
+    vector<bool> used(VREG_BASE);
+    for (int r = VREG_BASE; r < mf.vreg_count; r++)
+    {
+        if (phys[r] >= 0)
+            used[phys[r]] = true;
+    }
+    for (int r = 0; r < VREG_BASE; r++)
+    {
+        if (used[r] && isCalleeSaved(r))
+            mf.saved_regs.push_back(r);
+    }
+}
+
+void LinearScan(MachineFunction &mf)
+{
+    vector<Interval> intervals;
+    buildIntervals(mf, intervals);
+    mf.regalloc_bytes = mf.livenessBytes() + intervals.size() * sizeof(Interval);
+    for (auto &interval : intervals)
+        mf.regalloc_bytes += interval.ranges.capacity() * sizeof(pair<int, int>);
+
+    // 按起点排序的虚拟寄存器区间
+    vector<Interval *> order;
+    for (int r = VREG_BASE; r < mf.vreg_count; r++)
+    {
+        if (intervals[r].ranges.size())
+            order.push_back(&intervals[r]);
+    }
+    sort(order.begin(), order.end(), [](Interval *a, Interval *b) {
+        return a->start() < b->start();
+    });
+
+    vector<Interval *> active;
+    vector<bool> busy(VREG_BASE);
+    // 物理寄存器自身的区间来自指令直接使用它的地方（传参、返回值、call 的破坏），不能与之重叠
+    auto usable = [&](Interval *interval, int r) {
+        return !intervals[r].overlaps(interval->ranges);
+    };
+    auto spill = [&](Interval *interval) {
+        interval->phys = -1;
+        interval->slot = mf.newSlot(4);
+    };
+
+    for (auto cur : order)
+    {
+        // 释放已经结束的区间占用的寄存器
+        int n = 0;
+        for (auto interval : active)
+        {
+            if (interval->end() < cur->start())
+                busy[interval->phys] = false;
+            else
+                active[n++] = interval;
+        }
+        active.resize(n);
+
+        int reg = -1;
+        if (cur->hint >= 0 && isAllocatable(cur->hint) && !busy[cur->hint] && usable(cur, cur->hint))
+            reg = cur->hint;
+        for (int i = 0; reg < 0 && i < ALLOC_NUM; i++)
+        {
+            int r = alloc_order[i];
+            if (!busy[r] && usable(cur, r))
+                reg = r;
+        }
+        if (reg >= 0)
+        {
+            cur->phys = reg;
+            busy[reg] = true;
+            active.push_back(cur);
+            continue;
+        }
+
+        // 没有空闲的寄存器：溢出结束最晚的区间
+        Interval *victim = nullptr;
+        for (auto interval : active)
+        {
+            if (usable(cur, interval->phys) && (!victim || interval->end() > victim->end()))
+                victim = interval;
+        }
+        if (victim && victim->end() > cur->end())
+        {
+            cur->phys = victim->phys;
+            spill(victim);
+            active.erase(find(active.begin(), active.end(), victim));
+            active.push_back(cur);
+        }
+        else
+            spill(cur);
+    }
+
+    vector<int> phys(mf.vreg_count, -1), slots(mf.vreg_count, -1);
+    for (auto interval : order)
+    {
+        phys[interval->reg] = interval->phys;
+        slots[interval->reg] = interval->slot;
+    }
+    RewriteVRegs(mf, phys, slots);
+}
@@ -0,0 +1,838 @@
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "include/rvsim.hpp"
+#include "include/mir.hpp"
+#include "../util.hpp"
+
+using namespace std;
+
+// 地址空间：代码从 TEXT_BASE 开始，每条指令占 4 字节（只用于返回地址和 la 代码标号）；
+// 数据段从 DATA_BASE 开始，其后是栈，sp 的初值是栈顶；main 返回到地址 0 时程序结束
+static const uint32_t TEXT_BASE = 0x10000;
+static const uint32_t DATA_BASE = 0x10000000;
+static const uint32_t STACK_SIZE = 32 << 20;
+
+// 代价模型的参数（周期），见 rvsim.hpp
+static const int LOAD_LATENCY = 2, MUL_LATENCY = 3, DIV_LATENCY = 20;
+static const int BRANCH_PENALTY = 2, JUMP_PENALTY = 1, INDIRECT_PENALTY = 2;
+
+// 库函数调用后，调用者保存的寄存器填入这个值，依赖它们在调用前后不变的错误代码会算出错误的结果
+static const int32_t CLOBBER = 0x5a5a5a5a;
+
+enum AluOp
+{
+    ADD, SUB, SLL, SLT, SLTU, XOR, SRL, SRA, OR, AND,
+    MUL, MULH, MULHSU, MULHU, DIV, DIVU, REM, REMU
+};
+
+enum Cond
+{
+    BEQ, BNE, BLT, BGE, BLTU, BGEU
+};
+
+enum Builtin
+{
+    GETINT, GETCH, GETARRAY, PUTINT, PUTCH, PUTARRAY, STARTTIME, STOPTIME
+};
+
+// 汇编后的指令，伪指令展开为对应的基本指令（li/la 仍是一条，size 为展开后的指令数）
+struct RvInst
+{
+    enum KIND
+    {
+        ALU,    // rd = rs1 op (rs2 或 imm)
+        LI,     // rd = imm
+        LOAD,   // rd = mem[rs1 + imm]，width 字节
+        STORE,  // mem[rs1 + imm] = rs2
+        BRANCH, // if (rs1 cond rs2) goto target
+        JAL,    // rd = 返回地址; goto target
+        JALR,   // rd = 返回地址; goto rs1 + imm
+        LIB     // 调用库函数
+    };
+    KIND kind;
+    int op = 0;             // AluOp / Cond / Builtin
+    int rd = 0, rs1 = 0, rs2 = 0;
+    bool use_imm = false;
+    int32_t imm = 0;
+    int width = 4;
+    bool is_unsigned = false;
+    int target = -1;        // BRANCH/JAL 的目标指令下标
+    int size = 1;
+    int func = 0;           // 所在函数在 SimProfile::funcs 中的下标
+};
+
+static int parseReg(string_view s)
+{
+    if (s == "fp")
+        return S0;
+    for (int i = 0; i < 32; i++)
+    {
+        if (s == regName(i))
+            return i;
+    }
+    if (s.size() >= 2 && s.size() <= 3 && s[0] == 'x' && isdigit(s[1]))
+    {
+        int r = atoi(string(s.substr(1)).c_str());
+        return r < 32 ? r : -1;
+    }
+    return -1;
+}
+
+static bool parseImm(string_view s, long &v)
+{
+    if (s.empty())
+        return false;
+    string str(s);
+    char *end;
+    v = strtol(str.c_str(), &end, 0);
+    return *end == '\0';
+}
+
+static string_view trim(string_view s)
+{
+    while (!s.empty() && isspace((unsigned char)s.front()))
+        s.remove_prefix(1);
+    while (!s.empty() && isspace((unsigned char)s.back()))
+        s.remove_suffix(1);
+    return s;
+}
+
+class Simulator
+{
+private:
+    vector<RvInst> code;
+    vector<uint8_t> mem;                // [DATA_BASE, DATA_BASE + mem.size())
+    uint32_t data_size = 0;
+    unordered_map<string, uint32_t> labels;   // 标号的地址
+    vector<pair<int, string>> fixups;         // 引用了标号的指令，汇编结束后填入地址
+    vector<int> entry_func;                   // 每条指令是哪个函数的入口，不是入口为 -1
+    bool in_text = true;
+    int line_no = 0;
+
+    bool fail(const string &msg)
+    {
+        error = "line " + to_string(line_no) + ": " + msg;
+        return false;
+    }
+
+    void label(const string &name)
+    {
+        if (in_text)
+        {
+            labels[name] = TEXT_BASE + 4 * code.size();
+            if (name.compare(0, 2, ".L") != 0)
+            {
+                profile.funcs.emplace_back();
+                profile.funcs.back().name = name;
+                entry_func.resize(code.size() + 1, -1);
+                entry_func[code.size()] = profile.funcs.size() - 1;
+            }
+        }
+        else
+            labels[name] = DATA_BASE + data_size;
+    }
+
+    void emitData(long v, int width)
+    {
+        mem.resize(data_size + width);
+        memcpy(&mem[data_size], &v, width);     // 小端序
+        data_size += width;
+    }
+
+    bool directive(string_view op, const vector<string_view> &args)
+    {
+        if (op == ".text")
+            in_text = true;
+        else if (op == ".data" || op == ".bss" || op == ".rodata")
+            in_text = false;
+        else if (op == ".section")
+            in_text = !args.empty() && args[0].compare(0, 5, ".text") == 0;
+        else if (op == ".word" || op == ".half" || op == ".byte" || op == ".zero" || op == ".space")
+        {
+            if (in_text)
+                return fail("data directive " + string(op) + " in .text");
+            for (auto a : args)
+            {
+                long v;
+                if (!parseImm(a, v))
+                    return fail("bad operand " + string(a));
+                if (op == ".zero" || op == ".space")
+                {
+                    if (v < 0 || v > (long)INT_MAX - data_size)
+                        return fail("bad size " + string(a));
+                    mem.resize(data_size + v);
+                    data_size += v;
+                }
+                else
+                    emitData(v, op == ".word" ? 4 : op == ".half" ? 2 : 1);
+            }
+        }
+        else if (op == ".align" || op == ".p2align" || op == ".balign")
+        {
+            long v;
+            if (args.empty() || !parseImm(args[0], v) || v < 0 || v > 4096)
+                return fail("bad alignment");
+            long align = op == ".balign" ? v : 1L << min(v, 12L);
+            if (!in_text && align > 1)
+            {
+                data_size = (data_size + align - 1) / align * align;
+                mem.resize(data_size);
+            }
+        }
+        // .globl、.type、.size 等不影响执行
+        return true;
+    }
+
+    bool instruction(const string &op, const vector<string_view> &args)
+    {
+        if (!in_text)
+            return fail("instruction " + op + " outside .text");
+        static const pair<const char *, AluOp> rtype[] = {
+            {"add", ADD}, {"sub", SUB}, {"sll", SLL}, {"slt", SLT}, {"sltu", SLTU}, {"xor", XOR},
+            {"srl", SRL}, {"sra", SRA}, {"or", OR}, {"and", AND}, {"mul", MUL}, {"mulh", MULH},
+            {"mulhsu", MULHSU}, {"mulhu", MULHU}, {"div", DIV}, {"divu", DIVU}, {"rem", REM}, {"remu", REMU}};
+        static const pair<const char *, AluOp> itype[] = {
+            {"addi", ADD}, {"slti", SLT}, {"sltiu", SLTU}, {"xori", XOR}, {"ori", OR}, {"andi", AND},
+            {"slli", SLL}, {"srli", SRL}, {"srai", SRA}};
+        static const pair<const char *, Cond> branches[] = {
+            {"beq", BEQ}, {"bne", BNE}, {"blt", BLT}, {"bge", BGE}, {"bltu", BLTU}, {"bgeu", BGEU}};
+        // 与 x0 比较的分支伪指令，swap 为真时 x0 在左边
+        static const struct { const char *name; Cond cond; bool swap; } zero_branches[] = {
+            {"beqz", BEQ, false}, {"bnez", BNE, false}, {"bltz", BLT, false}, {"bgez", BGE, false},
+            {"blez", BGE, true}, {"bgtz", BLT, true}};
+        // 交换操作数的伪指令
+        static const pair<const char *, Cond> swapped_branches[] = {
+            {"bgt", BLT}, {"ble", BGE}, {"bgtu", BLTU}, {"bleu", BGEU}};
+
+        RvInst inst;
+        inst.func = profile.funcs.empty() ? -1 : profile.funcs.size() - 1;
+        int n = args.size();
+        vector<int> regs(n, -1);
+        for (int i = 0; i < n; i++)
+            regs[i] = parseReg(args[i]);
+        auto need = [&](int count, int nreg) {
+            if (n != count)
+                return fail(op + " expects " + to_string(count) + " operands");
+            for (int i = 0; i < nreg; i++)
+            {
+                if (regs[i] < 0)
+                    return fail("bad register " + string(args[i]));
+            }
+            return true;
+        };
+        auto imm = [&](string_view s, long lo, long hi) {
+            long v;
+            if (!parseImm(s, v) || v < lo || v > hi)
+                return fail("bad immediate " + string(s));
+            inst.imm = v;
+            return true;
+        };
+        // offset(base)
+        auto address = [&](string_view s) {
+            size_t l = s.find('('), r = s.rfind(')');
+            if (l == string_view::npos || r != s.size() - 1)
+                return fail("bad address " + string(s));
+            inst.rs1 = parseReg(s.substr(l + 1, r - l - 1));
+            if (inst.rs1 < 0)
+                return fail("bad address " + string(s));
+            return l == 0 ? true : imm(trim(s.substr(0, l)), -2048, 2047);
+        };
+        auto alu = [&](AluOp aop, int rd, int rs1, int rs2) {
+            inst.kind = RvInst::ALU;
+            inst.op = aop;
+            inst.rd = rd;
+            inst.rs1 = rs1;
+            inst.rs2 = rs2;
+        };
+        auto aluImm = [&](AluOp aop, int rd, int rs1, int32_t v) {
+            alu(aop, rd, rs1, 0);
+            inst.use_imm = true;
+            inst.imm = v;
+        };
+        auto branch = [&](Cond cond, int rs1, int rs2, string_view target) {
+            inst.kind = RvInst::BRANCH;
+            inst.op = cond;
+            inst.rs1 = rs1;
+            inst.rs2 = rs2;
+            fixups.emplace_back(code.size(), string(target));
+        };
+
+        bool ok = true, found = true;
+        if (op == "li" || op == "lui")
+        {
+            if (!need(2, 1) || !imm(args[1], op == "li" ? INT_MIN : 0, op == "li" ? UINT_MAX : 0xfffff))
+                return false;
+            inst.kind = RvInst::LI;
+            inst.rd = regs[0];
+            if (op == "lui")
+                inst.imm = (uint32_t)inst.imm << 12;
+            else if ((inst.imm < -2048 || inst.imm > 2047) && (inst.imm & 0xfff))
+                inst.size = 2;  // lui + addi
+        }
+        else if (op == "la")
+        {
+            if (!need(2, 1))
+                return false;
+            inst.kind = RvInst::LI;
+            inst.rd = regs[0];
+            inst.size = 2;      // auipc + addi
+            fixups.emplace_back(code.size(), string(args[1]));
+        }
+        else if (op == "mv")
+            ok = need(2, 2) && (aluImm(ADD, regs[0], regs[1], 0), true);
+        else if (op == "neg")
+            ok = need(2, 2) && (alu(SUB, regs[0], ZERO, regs[1]), true);
+        else if (op == "not")
+            ok = need(2, 2) && (aluImm(XOR, regs[0], regs[1], -1), true);
+        else if (op == "seqz")
+            ok = need(2, 2) && (aluImm(SLTU, regs[0], regs[1], 1), true);
+        else if (op == "snez")
+            ok = need(2, 2) && (alu(SLTU, regs[0], ZERO, regs[1]), true);
+        else if (op == "sltz")
+            ok = need(2, 2) && (alu(SLT, regs[0], regs[1], ZERO), true);
+        else if (op == "sgtz")
+            ok = need(2, 2) && (alu(SLT, regs[0], ZERO, regs[1]), true);
+        else if (op == "sgt" || op == "sgtu")
+            ok = need(3, 3) && (alu(op == "sgt" ? SLT : SLTU, regs[0], regs[2], regs[1]), true);
+        else if (op == "nop")
+            ok = need(0, 0) && (aluImm(ADD, ZERO, ZERO, 0), true);
+        else if (op == "lw" || op == "lh" || op == "lhu" || op == "lb" || op == "lbu")
+        {
+            if (!need(2, 1) || !address(args[1]))
+                return false;
+            inst.kind = RvInst::LOAD;
+            inst.rd = regs[0];
+            inst.width = op[1] == 'w' ? 4 : op[1] == 'h' ? 2 : 1;
+            inst.is_unsigned = op.back() == 'u';
+        }
+        else if (op == "sw" || op == "sh" || op == "sb")
+        {
+            if (!need(2, 1) || !address(args[1]))
+                return false;
+            inst.kind = RvInst::STORE;
+            inst.rs2 = regs[0];
+            inst.width = op[1] == 'w' ? 4 : op[1] == 'h' ? 2 : 1;
+        }
+        else if (op == "j")
+        {
+            if (!need(1, 0))
+                return false;
+            inst.kind = RvInst::JAL;
+            fixups.emplace_back(code.size(), string(args[0]));
+        }
+        else if (op == "jal" || op == "call")
+        {
+            if (n == 2 && op == "jal")
+            {
+                if (!need(2, 1))
+                    return false;
+                inst.rd = regs[0];
+            }
+            else if (!need(1, 0))
+                return false;
+            else
+                inst.rd = RA;
+            inst.kind = RvInst::JAL;
+            fixups.emplace_back(code.size(), string(args[n - 1]));
+        }
+        else if (op == "ret" || op == "jr")
+        {
+            if (!(op == "ret" ? need(0, 0) : need(1, 1)))
+                return false;
+            inst.kind = RvInst::JALR;
+            inst.rs1 = op == "ret" ? RA : regs[0];
+        }
+        else if (op == "jalr")
+        {
+            inst.kind = RvInst::JALR;
+            if (n == 1 && regs[0] >= 0)
+            {
+                inst.rd = RA;
+                inst.rs1 = regs[0];
+            }
+            else if (!need(2, 1) || !address(args[1]))
+                return false;
+            else
+                inst.rd = regs[0];
+        }
+        else
+            found = false;
+
+        for (auto &p : rtype)
+        {
+            if (!found && op == p.first)
+            {
+                ok = need(3, 3);
+                alu(p.second, regs[0], regs[1], regs[2]);
+                found = true;
+            }
+        }
+        for (auto &p : itype)
+        {
+            if (!found && op == p.first)
+            {
+                bool shift = p.second == SLL || p.second == SRL || p.second == SRA;
+                ok = need(3, 2) && imm(args[2], shift ? 0 : -2048, shift ? 31 : 2047);
+                aluImm(p.second, regs[0], regs[1], inst.imm);
+                found = true;
+            }
+        }
+        for (auto &p : branches)
+        {
+            if (!found && op == p.first)
+            {
+                ok = need(3, 2);
+                branch(p.second, regs[0], regs[1], args[2]);
+                found = true;
+            }
+        }
+        for (auto &p : swapped_branches)
+        {
+            if (!found && op == p.first)
+            {
+                ok = need(3, 2);
+                branch(p.second, regs[1], regs[0], args[2]);
+                found = true;
+            }
+        }
+        for (auto &b : zero_branches)
+        {
+            if (!found && op == b.name)
+            {
+                ok = need(2, 1);
+                branch(b.cond, b.swap ? ZERO : regs[0], b.swap ? regs[0] : ZERO, args[1]);
+                found = true;
+            }
+        }
+        if (!found)
+            return fail("unknown instruction " + op);
+        if (!ok)
+            return false;
+        if (inst.func < 0)
+        {
+            // .text 开头没有标号的指令
+            profile.funcs.emplace_back();
+            profile.funcs.back().name = "<text>";
+            inst.func = 0;
+        }
+        code.push_back(inst);
+        return true;
+    }
+
+    bool resolve()
+    {
+        static const pair<const char *, Builtin> libs[] = {
+            {"getint", GETINT}, {"getch", GETCH}, {"getarray", GETARRAY}, {"putint", PUTINT},
+            {"putch", PUTCH}, {"putarray", PUTARRAY}, {"starttime", STARTTIME}, {"stoptime", STOPTIME},
+            {"_sysy_starttime", STARTTIME}, {"_sysy_stoptime", STOPTIME}};
+        for (auto &f : fixups)
+        {
+            RvInst &inst = code[f.first];
+            auto it = labels.find(f.second);
+            if (it == labels.end())
+            {
+                bool found = false;
+                for (auto &l : libs)
+                {
+                    if (inst.kind == RvInst::JAL && inst.rd == RA && f.second == l.first)
+                    {
+                        inst.kind = RvInst::LIB;
+                        inst.op = l.second;
+                        found = true;
+                    }
+                }
+                if (!found)
+                {
+                    error = "undefined symbol " + f.second;
+                    return false;
+                }
+                continue;
+            }
+            if (inst.kind == RvInst::LI)
+                inst.imm = it->second;
+            else if (it->second >= DATA_BASE)
+            {
+                error = "jump to data label " + f.second;
+                return false;
+            }
+            else
+                inst.target = (it->second - TEXT_BASE) / 4;
+        }
+        entry_func.resize(code.size() + 1, -1);
+        return true;
+    }
+
+    // 检查 [addr, addr + width) 是否在数据段或栈中且对齐，返回在 mem 中的下标
+    bool access(uint32_t addr, int width, size_t &index)
+    {
+        if (addr % width)
+        {
+            error = "misaligned access at " + to_string(addr);
+            return false;
+        }
+        if (addr < DATA_BASE || addr - DATA_BASE + width > mem.size())
+        {
+            error = "out-of-bounds access at " + to_string(addr);
+            return false;
+        }
+        index = addr - DATA_BASE;
+        return true;
+    }
+
+    static int32_t aluResult(int op, int32_t a, int32_t b)
+    {
+        uint32_t ua = a, ub = b;
+        switch (op)
+        {
+        case ADD: return ua + ub;
+        case SUB: return ua - ub;
+        case SLL: return ua << (ub & 31);
+        case SLT: return a < b;
+        case SLTU: return ua < ub;
+        case XOR: return a ^ b;
+        case SRL: return ua >> (ub & 31);
+        case SRA: return a >> (ub & 31);
+        case OR: return a | b;
+        case AND: return a & b;
+        case MUL: return ua * ub;
+        case MULH: return ((int64_t)a * b) >> 32;
+        case MULHSU: return ((int64_t)a * (int64_t)ub) >> 32;
+        case MULHU: return ((uint64_t)ua * ub) >> 32;
+        // 除零和溢出的结果按 RISC-V 的规定，不产生异常
+        case DIV: return b == 0 ? -1 : a == INT_MIN && b == -1 ? INT_MIN : a / b;
+        case DIVU: return ub == 0 ? UINT32_MAX : ua / ub;
+        case REM: return b == 0 ? a : a == INT_MIN && b == -1 ? 0 : a % b;
+        case REMU: return ub == 0 ? ua : ua % ub;
+        }
+        return 0;
+    }
+
+    static int latency(const RvInst &inst)
+    {
+        if (inst.kind == RvInst::LOAD)
+            return LOAD_LATENCY;
+        if (inst.kind == RvInst::ALU && inst.op >= DIV)
+            return DIV_LATENCY;
+        if (inst.kind == RvInst::ALU && inst.op >= MUL)
+            return MUL_LATENCY;
+        return 1;
+    }
+
+    // 库函数与 sylib 的行为一致；读到文件末尾时 getint 返回 0，getch 返回 -1
+    bool callLib(int lib, int32_t *x)
+    {
+        size_t index;
+        switch (lib)
+        {
+        case GETINT:
+            if (fscanf(in, "%d", &x[A0]) != 1)
+                x[A0] = 0;
+            break;
+        case GETCH:
+            x[A0] = fgetc(in);
+            break;
+        case GETARRAY:
+        {
+            int n = 0;
+            if (fscanf(in, "%d", &n) != 1)
+                n = 0;
+            for (int i = 0; i < n; i++)
+            {
+                int v = 0;
+                if (fscanf(in, "%d", &v) != 1)
+                    v = 0;
+                if (!access(x[A0] + 4 * i, 4, index))
+                    return false;
+                memcpy(&mem[index], &v, 4);
+            }
+            x[A0] = n;
+            break;
+        }
+        case PUTINT:
+            fprintf(out, "%d", x[A0]);
+            break;
+        case PUTCH:
+            fputc(x[A0], out);
+            break;
+        case PUTARRAY:
+            fprintf(out, "%d:", x[A0]);
+            for (int i = 0; i < x[A0]; i++)
+            {
+                int32_t v;
+                if (!access(x[A0 + 1] + 4 * i, 4, index))
+                    return false;
+                memcpy(&v, &mem[index], 4);
+                fprintf(out, " %d", v);
+            }
+            fputc('\n', out);
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+public:
+    FILE *in, *out;
+    SimProfile &profile;
+    string error;
+
+    Simulator(FILE *_in, FILE *_out, SimProfile &_profile) : in(_in), out(_out), profile(_profile) {}
+
+    bool assemble(string_view text)
+    {
+        while (!text.empty())
+        {
+            line_no++;
+            size_t eol = text.find('\n');
+            string_view line = text.substr(0, eol);
+            text.remove_prefix(eol == string_view::npos ? text.size() : eol + 1);
+            line = trim(line.substr(0, line.find('#')));
+            // 行首可以有多个标号
+            size_t colon;
+            while ((colon = line.find(':')) != string_view::npos)
+            {
+                string_view name = trim(line.substr(0, colon));
+                if (name.empty() || name.find_first_of(" \t,(") != string_view::npos)
+                    break;
+                label(string(name));
+                line = trim(line.substr(colon + 1));
+            }
+            if (line.empty())
+                continue;
+            size_t space = line.find_first_of(" \t");
+            string op(line.substr(0, space));
+            vector<string_view> args;
+            if (space != string_view::npos)
+            {
+                string_view rest = trim(line.substr(space));
+                while (!rest.empty())
+                {
+                    size_t comma = rest.find(',');
+                    args.push_back(trim(rest.substr(0, comma)));
+                    rest = comma == string_view::npos ? string_view() : rest.substr(comma + 1);
+                }
+            }
+            if (!(op[0] == '.' ? directive(op, args) : instruction(op, args)))
+                return false;
+        }
+        return resolve();
+    }
+
+    bool run()
+    {
+        auto it = labels.find("main");
+        if (it == labels.end() || it->second >= DATA_BASE)
+        {
+            error = "no main function";
+            return false;
+        }
+        // 数据段之后是栈
+        size_t stack_base = (data_size + 15) / 16 * 16;
+        mem.resize(stack_base + STACK_SIZE);
+        int32_t x[32] = {0};
+        x[SP] = DATA_BASE + mem.size();
+        long ready[32] = {0};           // 寄存器的结果在哪个周期就绪
+        bool from_load[32] = {false};   // 寄存器的值是否来自 load，用于区分停顿的原因
+        long cycle = 0;
+        int pc = (it->second - TEXT_BASE) / 4;
+        if (entry_func[pc] >= 0)
+            profile.funcs[entry_func[pc]].calls++;
+
+        while (true)
+        {
+            if (pc < 0 || pc >= (int)code.size())
+            {
+                error = "jump outside .text";
+                return false;
+            }
+            const RvInst &inst = code[pc];
+            SimProfile::Func &func = profile.funcs[inst.func];
+            func.insts += inst.size;
+
+            // 等待源寄存器就绪
+            long start = cycle;
+            int reads[2] = {inst.rs1, inst.kind == RvInst::LIB ? A0 + 1 : inst.rs2};
+            if (inst.kind == RvInst::LI || inst.kind == RvInst::JAL || (inst.kind == RvInst::ALU && inst.use_imm))
+                reads[1] = 0;
+            if (inst.kind == RvInst::LI || inst.kind == RvInst::JAL)
+                reads[0] = 0;
+            if (inst.kind == RvInst::LIB)
+                reads[0] = A0;
+            bool load_stall = false;
+            for (int r : reads)
+            {
+                if (r && ready[r] > start)
+                {
+                    start = ready[r];
+                    load_stall = from_load[r];
+                }
+            }
+            (load_stall ? func.load_stalls : func.muldiv_stalls) += start - cycle;
+            long end = start + inst.size;
+
+            int next = pc + 1;
+            int32_t result = 0;
+            bool writes = inst.rd != 0;
+            size_t index;
+            switch (inst.kind)
+            {
+            case RvInst::ALU:
+                result = aluResult(inst.op, x[inst.rs1], inst.use_imm ? inst.imm : x[inst.rs2]);
+                break;
+            case RvInst::LI:
+                result = inst.imm;
+                break;
+            case RvInst::LOAD:
+                func.loads++;
+                if (!access(x[inst.rs1] + inst.imm, inst.width, index))
+                    return false;
+                if (inst.width == 4)
+                    memcpy(&result, &mem[index], 4);
+                else if (inst.width == 2)
+                {
+                    int16_t h;
+                    memcpy(&h, &mem[index], 2);
+                    result = inst.is_unsigned ? (int32_t)(uint16_t)h : h;
+                }
+                else
+                    result = inst.is_unsigned ? (int32_t)mem[index] : (int8_t)mem[index];
+                break;
+            case RvInst::STORE:
+                func.stores++;
+                if (!access(x[inst.rs1] + inst.imm, inst.width, index))
+                    return false;
+                memcpy(&mem[index], &x[inst.rs2], inst.width);
+                writes = false;
+                break;
+            case RvInst::BRANCH:
+            {
+                int32_t a = x[inst.rs1], b = x[inst.rs2];
+                bool taken;
+                switch (inst.op)
+                {
+                case BEQ: taken = a == b; break;
+                case BNE: taken = a != b; break;
+                case BLT: taken = a < b; break;
+                case BGE: taken = a >= b; break;
+                case BLTU: taken = (uint32_t)a < (uint32_t)b; break;
+                default: taken = (uint32_t)a >= (uint32_t)b; break;
+                }
+                if (taken)
+                {
+                    next = inst.target;
+                    func.taken++;
+                    end += BRANCH_PENALTY;
+                }
+                writes = false;
+                break;
+            }
+            case RvInst::JAL:
+                result = TEXT_BASE + 4 * (pc + 1);
+                next = inst.target;
+                end += JUMP_PENALTY;
+                if (inst.rd == RA && entry_func[next] >= 0)
+                    profile.funcs[entry_func[next]].calls++;
+                break;
+            case RvInst::JALR:
+            {
+                result = TEXT_BASE + 4 * (pc + 1);
+                uint32_t addr = x[inst.rs1] + inst.imm;
+                end += INDIRECT_PENALTY;
+                if (addr == 0)
+                {
+                    // main 返回
+                    func.cycles += end - cycle;
+                    profile.ret = x[A0];
+                    return true;
+                }
+                next = (addr - TEXT_BASE) / 4;
+                if (addr < TEXT_BASE || addr % 4 || next >= (int)code.size())
+                {
+                    error = "jump to invalid address " + to_string(addr);
+                    return false;
+                }
+                if (inst.rd == RA && entry_func[next] >= 0)
+                    profile.funcs[entry_func[next]].calls++;
+                break;
+            }
+            case RvInst::LIB:
+                end += JUMP_PENALTY;
+                if (!callLib(inst.op, x))
+                    return false;
+                // 库函数破坏所有调用者保存的寄存器，a0 是返回值
+                for (int r = 1; r < 32; r++)
+                {
+                    if (isCallerSaved(r) && r != A0)
+                        x[r] = CLOBBER;
+                }
+                x[RA] = TEXT_BASE + 4 * (pc + 1);
+                result = x[A0];
+                writes = true;
+                break;
+            }
+            if (inst.kind != RvInst::LIB && writes)
+            {
+                x[inst.rd] = result;
+                ready[inst.rd] = start + inst.size - 1 + latency(inst);
+                from_load[inst.rd] = inst.kind == RvInst::LOAD;
+            }
+            else if (inst.kind == RvInst::LIB)
+            {
+                ready[A0] = end;
+                from_load[A0] = false;
+            }
+            x[ZERO] = 0;
+            func.cycles += end - cycle;
+            cycle = end;
+            pc = next;
+        }
+    }
+};
+
+bool Simulate(string_view assembly, FILE *in, FILE *out, SimProfile &profile, string &error)
+{
+    Simulator sim(in, out, profile);
+    bool ok = sim.assemble(assembly) && sim.run();
+    fflush(out);
+    error = sim.error;
+    return ok;
+}
+
+void SimProfile::print(Writer &out) const
+{
+    char buf[256];
+    auto line = [&](const Func &f, bool show_calls) {
+        snprintf(buf, sizeof(buf), "%-24s %10s %12ld %12ld %6.2f %10ld %10ld %10ld %10ld %10ld\n", f.name.c_str(),
+                 show_calls ? to_string(f.calls).c_str() : "-", f.insts, f.cycles, f.insts ? (double)f.cycles / f.insts : 0.0, f.loads, f.stores,
+                 f.load_stalls, f.muldiv_stalls, f.taken);
+        out << buf;
+    };
+    out << "===== simulator profile =====\n";
+    out << "main returned " << ret << '\n';
+    snprintf(buf, sizeof(buf), "%-24s %10s %12s %12s %6s %10s %10s %10s %10s %10s\n", "function", "calls", "insts",
+             "cycles", "CPI", "loads", "stores", "load-use", "mul/div", "taken br");
+    out << buf;
+    Func total;
+    total.name = "total";
+    for (auto &f : funcs)
+    {
+        line(f, true);
+        total.insts += f.insts;
+        total.cycles += f.cycles;
+        total.loads += f.loads;
+        total.stores += f.stores;
+        total.load_stalls += f.load_stalls;
+        total.muldiv_stalls += f.muldiv_stalls;
+        total.taken += f.taken;
+    }
+    line(total, false);
+}
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.hpp"
+
+using namespace std;
+
+// 输出格式变化时修改这个版本号，使旧的缓存条目失效
+static const char *CACHE_FORMAT = "sysy-cache 1";
+
+// 临时文件超过这个时间还没有被 rename，说明写入的进程已经退出
+static const time_t STALE_TMP_SECS = 3600;
+
+// SHA-256，见 FIPS 180-4
+class Sha256
+{
+private:
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    unsigned char block[64];
+    size_t block_len = 0;
+    uint64_t total = 0;
+
+    static uint32_t rotr(uint32_t x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    void compress(const unsigned char *p)
+    {
+        static const uint32_t k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+        for (int i = 16; i < 64; i++)
+        {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e, h[5] += f, h[6] += g, h[7] += hh;
+    }
+
+public:
+    void update(string_view s)
+    {
+        const unsigned char *p = (const unsigned char *)s.data();
+        size_t n = s.size();
+        total += n;
+        while (n)
+        {
+            size_t k = min(n, 64 - block_len);
+            copy(p, p + k, block + block_len);
+            block_len += k;
+            p += k;
+            n -= k;
+            if (block_len == 64)
+            {
+                compress(block);
+                block_len = 0;
+            }
+        }
+    }
+
+    // 返回十六进制的摘要，之后不能再 update
+    string hex()
+    {
+        uint64_t bits = total * 8;
+        unsigned char pad[72] = {0x80};
+        size_t n = (block_len < 56 ? 56 : 120) - block_len;
+        for (int i = 0; i < 8; i++)
+            pad[n + i] = bits >> (56 - 8 * i);
+        update(string_view((const char *)pad, n + 8));
+        static const char *digits = "0123456789abcdef";
+        string s;
+        for (uint32_t x : h)
+        {
+            for (int i = 28; i >= 0; i -= 4)
+                s += digits[(x >> i) & 15];
+        }
+        return s;
+    }
+};
+
+CompileCache::CompileCache(const string &_dir, long _max_bytes) : dir(_dir), max_bytes(_max_bytes)
+{
+    version = CACHE_FORMAT;
+    struct stat st;
+    if (stat("/proc/self/exe", &st) == 0)
+        version += " " + to_string(st.st_size) + " " + to_string(st.st_mtime);
+    mkdir(dir.c_str(), 0755);
+}
+
+string CompileCache::key(string_view src, CompileMode mode, int opt_level) const
+{
+    Sha256 sha;
+    string head = version + '\0' + (mode == MODE_KOOPA ? "koopa" : "riscv") + '\0' + to_string(opt_level) + '\0';
+    sha.update(head);
+    sha.update(src);
+    return sha.hex();
+}
+
+bool CompileCache::lookup(const string &key, string &output) const
+{
+    string path = entryPath(key);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && st.st_size > (off_t)key.size();
+    if (ok)
+    {
+        string data(st.st_size, '\0');
+        size_t got = 0;
+        while (got < data.size())
+        {
+            ssize_t r = read(fd, &data[got], data.size() - got);
+            if (r <= 0)
+                break;
+            got += r;
+        }
+        // 文件头是完整的键，防止读到损坏或被截断的条目
+        ok = got == data.size() && data.compare(0, key.size(), key) == 0 && data[key.size()] == '\n';
+        if (ok)
+            output = data.substr(key.size() + 1);
+    }
+    close(fd);
+    // 更新修改时间，淘汰时按最近使用的时间排序
+    if (ok)
+        utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    return ok;
+}
+
+void CompileCache::store(const string &key, string_view output) const
+{
+    static atomic<unsigned> counter{0};
+    string subdir = dir + "/" + key.substr(0, 2);
+    mkdir(subdir.c_str(), 0755);
+
+    // 临时文件名在进程和线程之间都唯一，写完后原子地 rename，其他进程不会看到写了一半的条目
+    string tmp = subdir + "/.tmp." + to_string(getpid()) + "." + to_string(hash<thread::id>()(this_thread::get_id())) +
+                 "." + to_string(counter++);
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+        return;
+    bool ok = fwrite(key.data(), 1, key.size(), f) == key.size() && fputc('\n', f) != EOF &&
+              fwrite(output.data(), 1, output.size(), f) == output.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), entryPath(key).c_str()) != 0)
+    {
+        unlink(tmp.c_str());
+        return;
+    }
+    evict(entryPath(key), key.size() + 1 + output.size());
+}
+
+void CompileCache::evict(const string &keep, long added) const
+{
+    struct Entry
+    {
+        string path;
+        time_t mtime;
+        long size;
+    };
+    lock_guard<mutex> lock(mtx);
+    if (total >= 0)
+    {
+        total += added;
+        if (total <= max_bytes)
+            return;
+    }
+
+    DIR *top = opendir(dir.c_str());
+    if (!top)
+        return;
+    vector<Entry> entries;
+    total = 0;
+    time_t now = time(nullptr);
+    while (dirent *t = readdir(top))
+    {
+        string shard = t->d_name;
+        if (shard.size() != 2 || !isxdigit((unsigned char)shard[0]) || !isxdigit((unsigned char)shard[1]))
+            continue;
+        string subdir = dir + "/" + shard;
+        DIR *d = opendir(subdir.c_str());
+        if (!d)
+            continue;
+        while (dirent *e = readdir(d))
+        {
+            string name = e->d_name;
+            if (name == "." || name == "..")
+                continue;
+            string path = subdir + "/" + name;
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0)
+                continue;   // 已被其他进程删除
+            if (name.compare(0, 5, ".tmp.") == 0)
+            {
+                if (now - st.st_mtime > STALE_TMP_SECS)
+                    unlink(path.c_str());
+                continue;
+            }
+            entries.push_back({path, st.st_mtime, (long)st.st_size});
+            total += st.st_size;
+        }
+        closedir(d);
+    }
+    closedir(top);
+
+    if (total <= max_bytes)
+        return;
+    // 删到容量的 90%，避免之后每次写入都重新扫描；其他进程可能同时在淘汰，删除不存在的文件不会出错，最多多删几个条目
+    long limit = max_bytes / 10 * 9;
+    sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.mtime < b.mtime; });
+    for (auto &e : entries)
+    {
+        if (total <= limit)
+            break;
+        if (e.path == keep)
+            continue;
+        unlink(e.path.c_str());
+        total -= e.size;
+    }
+}
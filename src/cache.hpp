@@ -0,0 +1,46 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "compiler.hpp"
+
+using namespace std;
+
+// 按内容寻址的编译缓存，保存在磁盘目录中
+// 键为源程序、模式、优化等级和编译器版本的 SHA-256，命中时直接返回保存的输出，跳过整个编译过程
+// 条目先写入临时文件再 rename 到位，读取时校验文件头中的键，因此多个进程可以同时使用同一个目录
+// 条目按键的前两个十六进制位分到 256 个子目录中
+// 第一次写入时扫描整个目录得到总大小，之后累加本进程写入的大小；超过容量时重新扫描，
+// 删除最久未使用的条目（命中时会更新条目的修改时间）直到不超过容量的 90%，刚写入的条目不会被删除
+class CompileCache
+{
+private:
+    string dir;
+    long max_bytes;
+    string version;     // 编译器版本及可执行文件的大小和修改时间，重新构建后旧的条目自动失效
+    mutable mutex mtx;  // 保护 total，多个线程可能同时写入条目
+    mutable long total = -1;    // 缓存的总大小，-1 表示还没有扫描过；其他进程写入的部分在下一次扫描时才计入
+
+    string entryPath(const string &key) const
+    {
+        return dir + "/" + key.substr(0, 2) + "/" + key.substr(2);
+    }
+
+    // 写入了大小为 added 的条目 keep 之后检查容量
+    void evict(const string &keep, long added) const;
+
+public:
+    static constexpr long DEFAULT_MAX_BYTES = 256L * 1024 * 1024;
+
+    CompileCache(const string &_dir, long _max_bytes = DEFAULT_MAX_BYTES);
+    CompileCache(const CompileCache &) = delete;
+    CompileCache &operator=(const CompileCache &) = delete;
+
+    string key(string_view src, CompileMode mode, int opt_level) const;
+
+    // 命中时把保存的输出放到 output 中并返回 true
+    bool lookup(const string &key, string &output) const;
+
+    // 写入失败（如磁盘已满）时静默放弃，不影响编译结果
+    void store(const string &key, string_view output) const;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// 供其他程序嵌入的编译接口，make lib 生成 build/libcompiler.a 和 build/libcompiler.so
+// 每次调用使用自己的 CompilerContext，没有全局状态，可以在多个线程中同时调用
+
+class ThreadPool;
+
+enum CompileMode
+{
+    MODE_KOOPA,     // 输出 Koopa IR
+    MODE_RISCV      // 输出 RISC-V 汇编
+};
+
+// 一类数据占用的内存（估计），current 为编译结束时仍占用的字节数，peak 为编译过程中的峰值
+class MemUsage
+{
+public:
+    string category;    // ast、symbols、ir、backend 或 output
+    size_t current = 0, peak = 0;
+};
+
+class CompileResult
+{
+public:
+    bool ok = false;
+    string output;  // 成功时为生成的 Koopa IR 或汇编
+    string error;   // 失败时为出错的原因，如语法错误、未定义的变量
+    vector<MemUsage> memory;    // 各类数据的内存统计，与 --mem-report 的内容相同
+};
+
+// 编译内存中的 SysY 源程序，出错时不会终止进程，而是在结果中返回原因
+// pool 非空时各函数的优化和代码生成在其中并行执行，输出与串行时相同
+CompileResult Compile(string_view src, CompileMode mode, int opt_level = 1, ThreadPool *pool = nullptr);
@@ -0,0 +1,72 @@
+#pragma once
+#include "front-end/include/arena.hpp"
+#include "front-end/include/intern.hpp"
+#include "front-end/include/symbol.hpp"
+#include "middle-end/include/ir.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+class ThreadPool;
+class CompileCache;
+class TimeReport;
+class MemReport;
+
+// 一次编译的全部状态，从源程序到输出的各阶段都只访问这里的数据
+// 不同的 CompilerContext 之间不共享任何可变状态，因此可以在多个线程中同时编译不同的文件
+class CompilerContext
+{
+public:
+    int opt_level = 1;
+    ThreadPool *pool = nullptr;     // 非空时各函数的优化和代码生成在其中并行执行，线程池可以由多个 context 共享
+    CompileCache *cache = nullptr;  // 非空时 CompileFile 先查找编译缓存，未命中时把输出存入缓存，可以由多个 context 共享
+    TimeReport *timer = nullptr;    // 非空时记录各阶段、各 pass 和各函数的耗时（-ftime-report）
+    MemReport *mem = nullptr;       // 非空时记录 AST、符号表、IR、后端等各类数据的内存（--mem-report）
+
+    // 前端：AST 和标识符，以及遍历 AST 生成 IR 时的状态
+    Arena arena;
+    Interner interner;
+    SymbolTableStack st;
+    IRBuilder irb;          // 构建内存中 IR 的辅助类，irb.program 为编译得到的 IR
+    BlockController bc;
+    WhileStack wst;
+    Ident scres;            // 短路求值结果的临时变量名
+
+    // 后端：汇编输出
+    RiscvString rvs;
+
+    // 第一个错误的原因，为空表示没有错误；出错后前端继续遍历但不再生成输出
+    string error;
+
+    CompilerContext() : st(interner), scres(interner.intern("SCRES")) {}
+    CompilerContext(const CompilerContext &) = delete;
+    CompilerContext &operator=(const CompilerContext &) = delete;
+
+    // 驻留的标识符超过这个数目时，reset 会清空 interner
+    static constexpr int MAX_WARM_IDENTS = 1 << 16;
+
+    // 为下一次编译清空状态，供编译服务器在多次请求之间复用同一个 context
+    // 保留 arena 的第一块内存和已驻留的标识符（库函数名、main、常见变量名等），
+    // 之后的编译不必再次申请内存、重新驻留这些名字
+    void reset()
+    {
+        arena.reset();
+        st.clear();
+        irb.reset();
+        if (interner.size() > MAX_WARM_IDENTS)
+        {
+            interner.clear();
+            scres = interner.intern("SCRES");
+        }
+        bc = BlockController();
+        wst = WhileStack();
+        rvs.setWriter(nullptr);
+        error.clear();
+    }
+
+    void fail(const string &msg)
+    {
+        if (error.empty())
+            error = msg;
+    }
+};
@@ -0,0 +1,543 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "front-end/include/ast.hpp"
+#include "middle-end/include/interp.hpp"
+#include "middle-end/include/ir.hpp"
+#include "middle-end/include/pass.hpp"
+#include "back-end/include/rvsim.hpp"
+#include "compiler.hpp"
+#include "cache.hpp"
+#include "driver.hpp"
+#include "memreport.hpp"
+#include "threadpool.hpp"
+#include "timer.hpp"
+
+using namespace std;
+
+extern void Visit(IRProgram &program, RiscvString &rvs, int opt_level, ThreadPool *pool, TimeReport *timer,
+                  MemReport *mem);
+
+// 记录前端结束后 AST、符号表和 IR 占用的内存
+static void recordFrontEnd(CompilerContext &ctx)
+{
+    if (!ctx.mem)
+        return;
+    ctx.mem->set("ast", ctx.arena.bytesReserved());
+    size_t names = ctx.interner.memoryUsage();
+    ctx.mem->set("symbols", ctx.st.memoryUsage() + names, ctx.st.peakMemoryUsage() + names);
+    ctx.mem->set("ir", ctx.irb.program.memoryUsage());
+}
+
+// 增量编译：按函数的指纹查找缓存，命中的函数标记为 reused，其余的标记为 record，返回各函数的键
+static vector<string> lookupFunctions(CompilerContext &ctx, CompileMode mode, const vector<IRFunction *> &defs)
+{
+    vector<string> keys(defs.size());
+    auto lookup = [&](int i) {
+        IRFunction *f = defs[i];
+        keys[i] = ctx.cache->key("function\n" + FunctionFingerprint(f), mode, ctx.opt_level);
+        f->reused = ctx.cache->lookup(keys[i], f->output);
+        f->record = !f->reused;
+    };
+    if (ctx.pool && defs.size() > 1)
+        ctx.pool->parallelFor(defs.size(), lookup);
+    else
+    {
+        for (int i = 0; i < (int)defs.size(); i++)
+            lookup(i);
+    }
+    return keys;
+}
+
+// 在内存中的 IR上运行优化 pass，然后按 mode 输出到 out
+// ctx.cache 非空时指纹未变的函数直接复用之前的输出，只有修改过的函数重新优化和生成代码
+static void Generate(CompilerContext &ctx, CompileMode mode, Writer &out)
+{
+    IRProgram &program = ctx.irb.program;
+    vector<IRFunction *> defs;
+    vector<string> keys;
+    if (ctx.cache)
+    {
+        for (auto f : program.funcs)
+        {
+            if (!f->isDecl())
+                defs.push_back(f);
+        }
+        ScopedTimer t(ctx.timer, "cache");
+        keys = lookupFunctions(ctx, mode, defs);
+    }
+
+    PassManager pm;
+    BuildPipeline(pm, ctx.opt_level);
+    pm.run(program, ctx.pool, ctx.timer);
+    if (ctx.mem)
+        ctx.mem->set("ir", program.memoryUsage());
+
+    if (mode == MODE_KOOPA)
+    {
+        ScopedTimer t(ctx.timer, "emit-koopa");
+        DumpKoopa(program, out);
+    }
+    else
+    {
+        ctx.rvs.setWriter(&out);
+        Visit(program, ctx.rvs, ctx.opt_level, ctx.pool, ctx.timer, ctx.mem);
+    }
+
+    size_t output_bytes = 0;
+    for (int i = 0; i < (int)defs.size(); i++)
+    {
+        if (defs[i]->record)
+            ctx.cache->store(keys[i], defs[i]->output);
+        output_bytes += defs[i]->output.capacity();
+    }
+    if (ctx.mem)
+        ctx.mem->add("output", output_bytes);
+}
+
+static BaseAST *parse(CompilerContext &ctx, string_view src, string &error)
+{
+    ScopedTimer t(ctx.timer, "parse");
+    return Parse(src, ctx.interner, ctx.arena, error);
+}
+
+// 遍历 AST 构建 IR，ast 为空（有语法错误）时什么也不做
+static void buildIR(CompilerContext &ctx, BaseAST *ast)
+{
+    if (!ast)
+        return;
+    {
+        ScopedTimer t(ctx.timer, "irgen");
+        ast->Dump(ctx);
+    }
+    recordFrontEnd(ctx);
+}
+
+CompileResult Compile(string_view src, CompileMode mode, int opt_level, ThreadPool *pool)
+{
+    CompilerContext ctx;
+    MemReport mem;
+    ctx.opt_level = opt_level;
+    ctx.pool = pool;
+    ctx.mem = &mem;
+    CompileResult result = Compile(ctx, src, mode);
+    mem.add("output", result.output.capacity());
+    result.memory = mem.usage();
+    return result;
+}
+
+CompileResult Compile(CompilerContext &ctx, string_view src, CompileMode mode)
+{
+    CompileResult result;
+    BaseAST *ast = parse(ctx, src, result.error);
+    if (!ast)
+        return result;
+    buildIR(ctx, ast);
+    if (!ctx.error.empty())
+    {
+        result.error = ctx.error;
+        return result;
+    }
+    {
+        Writer out(&result.output);
+        Generate(ctx, mode, out);
+    }
+    result.ok = true;
+    return result;
+}
+
+// 关闭输出文件，写入失败时（如磁盘已满）在标准错误输出原因并返回 false，此时输出文件不完整
+static bool closeOutput(Writer &out, const char *output)
+{
+    if (out.close())
+        return true;
+    fprintf(stderr, "%s: %s\n", output, strerror(out.error()));
+    return false;
+}
+
+// 使用编译缓存编译一个源文件：整个读入后计算键，命中时直接写出保存的输出，不经过词法分析、语法分析和代码生成
+static bool compileCached(CompilerContext &ctx, CompileMode mode, const char *input, const char *output, bool echo)
+{
+    ifstream is(input, ios::binary);
+    if (!is)
+    {
+        perror(input);
+        return false;
+    }
+    string src((istreambuf_iterator<char>(is)), istreambuf_iterator<char>());
+    string key, cached;
+    bool hit;
+    {
+        ScopedTimer t(ctx.timer, "cache");
+        key = ctx.cache->key(src, mode, ctx.opt_level);
+        hit = ctx.cache->lookup(key, cached);
+    }
+    if (hit)
+    {
+        Writer out;
+        if (!out.open(output, echo ? STDOUT_FILENO : -1))
+        {
+            perror(output);
+            return false;
+        }
+        out << cached;
+        return closeOutput(out, output);
+    }
+
+    buildIR(ctx, parse(ctx, src, ctx.error));
+    if (!ctx.error.empty())
+    {
+        fprintf(stderr, "%s: %s\n", input, ctx.error.c_str());
+        return false;
+    }
+    // 输出同时写入文件和内存，写完后存入缓存；出错的编译不会被缓存
+    {
+        Writer out(&cached);
+        if (!out.open(output, echo ? STDOUT_FILENO : -1))
+        {
+            perror(output);
+            return false;
+        }
+        Generate(ctx, mode, out);
+        if (!closeOutput(out, output))
+            return false;
+    }
+    ctx.cache->store(key, cached);
+    return true;
+}
+
+// 读入输入文件并构建 IR：.koopa 文件直接导入，跳过前端；出错时在标准错误输出原因并返回 false
+static bool loadFile(CompilerContext &ctx, const char *input)
+{
+    string input_name = input;
+    if (input_name.size() > 6 && input_name.substr(input_name.size() - 6) == ".koopa")
+    {
+        bool ok;
+        {
+            ScopedTimer t(ctx.timer, "import-koopa");
+            ok = ImportKoopa(input, ctx.irb.program, ctx.error);
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "%s: %s\n", input, ctx.error.c_str());
+            return false;
+        }
+        recordFrontEnd(ctx);
+        return true;
+    }
+
+    // 打开输入文件, 由 lexer 在解析的时候读取
+    FILE *in = fopen(input, "r");
+    if (!in)
+    {
+        perror(input);
+        return false;
+    }
+
+    // parse input file, AST 分配在 ctx.arena 中
+    BaseAST *ast;
+    {
+        ScopedTimer t(ctx.timer, "parse");
+        ast = Parse(in, ctx.interner, ctx.arena, ctx.error);
+    }
+    fclose(in);
+
+    // 遍历 AST的同时直接在内存中构建 IR
+    buildIR(ctx, ast);
+    if (!ctx.error.empty())
+    {
+        fprintf(stderr, "%s: %s\n", input, ctx.error.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool CompileFile(CompilerContext &ctx, const string &mode_str, const char *input, const char *output, bool echo)
+{
+    CompileMode mode;
+    if (mode_str == "-koopa")
+        mode = MODE_KOOPA;
+    else if (mode_str == "-riscv")
+        mode = MODE_RISCV;
+    else
+    {
+        fprintf(stderr, "unknown mode %s\n", mode_str.c_str());
+        return false;
+    }
+    string input_name = input;
+    bool is_koopa = input_name.size() > 6 && input_name.substr(input_name.size() - 6) == ".koopa";
+    if (!is_koopa && ctx.cache)
+        return compileCached(ctx, mode, input, output, echo);
+    if (!loadFile(ctx, input))
+        return false;
+
+    // 输出边生成边写入文件，不在内存中拼出完整的文本
+    Writer out;
+    if (!out.open(output, echo ? STDOUT_FILENO : -1))
+    {
+        perror(output);
+        return false;
+    }
+    Generate(ctx, mode, out);
+    return closeOutput(out, output);
+}
+
+bool InterpretFile(CompilerContext &ctx, const char *input, const char *output, int &ret)
+{
+    if (!loadFile(ctx, input))
+        return false;
+    IRProgram &program = ctx.irb.program;
+    PassManager pm;
+    BuildPipeline(pm, ctx.opt_level);
+    pm.run(program, ctx.pool, ctx.timer);
+
+    InterpProfile profile;
+    string error;
+    bool ok;
+    {
+        ScopedTimer t(ctx.timer, "interp");
+        ok = Interpret(program, stdin, stdout, profile, error);
+    }
+    // 出错时也输出已执行部分的剖析数据，便于定位
+    Writer out;
+    if (!out.open(output))
+    {
+        perror(output);
+        return false;
+    }
+    profile.print(program, out);
+    if (!closeOutput(out, output))
+        return false;
+    if (!ok)
+    {
+        fprintf(stderr, "%s: %s\n", input, error.c_str());
+        return false;
+    }
+    ret = profile.ret;
+    return true;
+}
+
+bool SimulateFile(CompilerContext &ctx, const char *input, const char *output, int &ret)
+{
+    string assembly;
+    string input_name = input;
+    if (input_name.size() > 2 && input_name.substr(input_name.size() - 2) == ".s")
+    {
+        ifstream is(input, ios::binary);
+        if (!is)
+        {
+            perror(input);
+            return false;
+        }
+        assembly.assign(istreambuf_iterator<char>(is), istreambuf_iterator<char>());
+    }
+    else
+    {
+        if (!loadFile(ctx, input))
+            return false;
+        Writer out(&assembly);
+        Generate(ctx, MODE_RISCV, out);
+    }
+
+    SimProfile profile;
+    string error;
+    bool ok;
+    {
+        ScopedTimer t(ctx.timer, "simulate");
+        ok = Simulate(assembly, stdin, stdout, profile, error);
+    }
+    Writer out;
+    if (!out.open(output))
+    {
+        perror(output);
+        return false;
+    }
+    profile.print(out);
+    if (!closeOutput(out, output))
+        return false;
+    if (!ok)
+    {
+        fprintf(stderr, "%s: %s\n", input, error.c_str());
+        return false;
+    }
+    ret = profile.ret;
+    return true;
+}
+
+// 批量编译中的一个文件及其结果
+struct BatchJob
+{
+    string input, output;
+    bool ok = false;
+    long in_bytes = 0, out_bytes = 0;
+    double ms = 0;
+};
+
+static long fileSize(const string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// 去掉目录和扩展名，如 dir/a.c -> a
+static string stem(const string &path)
+{
+    size_t slash = path.find_last_of('/');
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+
+// 读取清单文件，忽略空行和以 # 开头的行
+static bool readManifest(const char *path, vector<BatchJob> &jobs)
+{
+    ifstream is(path);
+    if (!is)
+    {
+        perror(path);
+        return false;
+    }
+    string line;
+    while (getline(is, line))
+    {
+        istringstream ss(line);
+        BatchJob job;
+        if (!(ss >> job.input) || job.input[0] == '#')
+            continue;
+        ss >> job.output;
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+int RunBatch(int argc, const char *argv[])
+{
+    if (argc < 5)
+    {
+        fprintf(stderr, "usage: %s -batch mode inputs... -o outdir [-On] [-jn] [-v] [-cache dir] [-cache-max MB]\n",
+                argv[0]);
+        return 1;
+    }
+    string mode = argv[2];
+    vector<BatchJob> jobs;
+    int i = 3;
+    for (; i < argc && string(argv[i]) != "-o"; i++)
+    {
+        if (argv[i][0] == '@')
+        {
+            if (!readManifest(argv[i] + 1, jobs))
+                return 1;
+        }
+        else
+        {
+            jobs.emplace_back();
+            jobs.back().input = argv[i];
+        }
+    }
+    if (i + 1 >= argc)
+    {
+        fprintf(stderr, "batch: missing -o outdir\n");
+        return 1;
+    }
+    if (jobs.empty())
+    {
+        fprintf(stderr, "batch: no input files\n");
+        return 1;
+    }
+    string outdir = argv[i + 1];
+    int opt_level = 1;
+    int n_threads = thread::hardware_concurrency();
+    bool verbose = false;
+    string cache_dir;
+    long cache_max = CompileCache::DEFAULT_MAX_BYTES;
+    for (i += 2; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.substr(0, 2) == "-O")
+            opt_level = atoi(argv[i] + 2);
+        else if (arg.substr(0, 2) == "-j")
+            n_threads = atoi(argv[i] + 2);
+        else if (arg == "-v")
+            verbose = true;
+        else if (arg == "-cache" && i + 1 < argc)
+            cache_dir = argv[++i];
+        else if (arg == "-cache-max" && i + 1 < argc)
+            cache_max = atol(argv[++i]) * 1024 * 1024;
+    }
+    if (n_threads < 1)
+        n_threads = 1;
+
+    // 未指定输出文件的放到输出目录中，同名时无法区分，直接报错
+    mkdir(outdir.c_str(), 0755);
+    string ext = mode == "-koopa" ? ".koopa" : ".s";
+    set<string> outputs;
+    for (auto &job : jobs)
+    {
+        if (job.output.empty())
+            job.output = outdir + "/" + stem(job.input) + ext;
+        if (!outputs.insert(job.output).second)
+        {
+            fprintf(stderr, "batch: %s is the output of more than one input\n", job.output.c_str());
+            return 1;
+        }
+    }
+
+    // 每个文件使用独立的 CompilerContext，调用者线程也参与编译
+    // 文件内的各函数也放到同一个线程池中，文件数少于线程数时仍能用满所有线程
+    unique_ptr<ThreadPool> pool;
+    if (n_threads > 1)
+        pool.reset(new ThreadPool(n_threads - 1));
+    unique_ptr<CompileCache> cache;
+    if (!cache_dir.empty())
+        cache.reset(new CompileCache(cache_dir, cache_max));
+    auto compile = [&](int k) {
+        BatchJob &job = jobs[k];
+        auto start = chrono::steady_clock::now();
+        {
+            CompilerContext ctx;
+            ctx.opt_level = opt_level;
+            ctx.pool = pool.get();
+            ctx.cache = cache.get();
+            job.ok = CompileFile(ctx, mode, job.input.c_str(), job.output.c_str());
+        }
+        job.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        job.in_bytes = fileSize(job.input);
+        job.out_bytes = job.ok ? fileSize(job.output) : 0;
+    };
+    auto start = chrono::steady_clock::now();
+    if (pool)
+        pool->parallelFor(jobs.size(), compile);
+    else
+    {
+        for (int k = 0; k < (int)jobs.size(); k++)
+            compile(k);
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // 按输入的顺序报告，与线程的调度无关
+    int failed = 0;
+    long in_bytes = 0, out_bytes = 0;
+    for (auto &job : jobs)
+    {
+        failed += !job.ok;
+        in_bytes += job.in_bytes;
+        out_bytes += job.out_bytes;
+        if (!job.ok)
+            printf("FAIL %s\n", job.input.c_str());
+        else if (verbose)
+            printf("ok   %8.2f ms  %s -> %s\n", job.ms, job.input.c_str(), job.output.c_str());
+    }
+    double mb = 1024.0 * 1024.0;
+    printf("compiled %d files (%d failed) with %d threads in %.3f s: %.1f files/s, %.2f MB/s in, %.2f MB/s out\n",
+           (int)jobs.size(), failed, n_threads, secs, jobs.size() / secs, in_bytes / mb / secs,
+           out_bytes / mb / secs);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "compiler.hpp"
+#include "context.hpp"
+
+using namespace std;
+
+// 用 ctx 编译内存中的源程序，优化等级和线程池取自 ctx；ctx 只能使用一次，再次使用前要调用 ctx.reset()
+CompileResult Compile(CompilerContext &ctx, string_view src, CompileMode mode);
+
+// 用 ctx 编译一个文件，mode 为 -koopa 或 -riscv，echo 为真时同时把输出打印到标准输出
+// ctx.pool 非空时各函数的优化和代码生成并行执行，输出与串行时相同
+// ctx.cache 非空时先按源程序的内容查找缓存，命中时直接写出保存的输出
+// 无法打开文件或有语法错误时在标准错误输出原因并返回 false
+bool CompileFile(CompilerContext &ctx, const string &mode, const char *input, const char *output, bool echo = false);
+
+// 解释执行一个文件的 IR（-interp），输入可以是 SysY 源程序或 .koopa 文件，IR 先经过 ctx.opt_level 对应的 pass
+// 程序从标准输入读入、向标准输出输出，各函数和基本块的动态指令数、访存和调用次数写入 output
+// 成功时 ret 为 main 的返回值；编译出错或运行时错误（如除零、越界访问）时在标准错误输出原因并返回 false
+bool InterpretFile(CompilerContext &ctx, const char *input, const char *output, int &ret);
+
+// 在内置的 RV32IM 模拟器上运行编译出的汇编（-sim），输入以 .s 结尾时直接汇编该文件，否则先按 ctx.opt_level 编译
+// 程序从标准输入读入、向标准输出输出，各函数执行的指令数、估计的周期数和停顿写入 output；ret 和出错时的行为同 InterpretFile
+bool SimulateFile(CompilerContext &ctx, const char *input, const char *output, int &ret);
+
+// 批量编译，命令行为 compiler -batch 模式 输入... -o 输出目录 [-O优化等级] [-j线程数] [-v] [-cache 缓存目录] [-cache-max 容量MB]
+// 以 @ 开头的输入为清单文件，每行一个输入文件，可在其后指定输出文件
+// 各文件在线程池中并行编译，结束后按输入的顺序报告结果并输出总的吞吐量，全部成功时返回 0
+int RunBatch(int argc, const char *argv[]);
+
+// 编译服务器，命令行为 compiler --server [套接字路径] [-j线程数]
+// 在 Unix 套接字上接受请求，每个请求为一行 "模式 优化等级 源程序字节数"，如 "-riscv 2 120"，后跟源程序
+// 回复为一行 "ok 字节数" 或 "error 字节数"，后跟输出或出错的原因；一个连接上可以依次发送多个请求
+// 线程池和各线程的 CompilerContext 在请求之间保留，省去了每次启动进程和重新申请内存的开销
+int RunServer(int argc, const char *argv[]);
@@ -1,30 +1,29 @@
 #include "include/ast.hpp"
 #include "include/symbol.hpp"
-#include "../util.hpp"
+#include "../context.hpp"
 #include <iostream>
 
 using namespace std;
 
-SymbolTableStack st;
-KoopaString ks;
-BlockController bc;
-WhileStack wst;
-
 // 部分实用函数（大部分是因为要递归因此单独拎出来）
+static bool isZero(IRValue *v)
+{
+    return v->tag == IRValue::INTEGER && v->value == 0;
+}
+
 // 局部变量数组初始化
-// 初始化内容在ptr所指的内存区域，数组类型由len描述. ptr[i]为常量，或者是KoopaIR中的名字
-void initLocalArray(string name, string *ptr, const vector<int> &len)
+// 初始化内容在ptr所指的内存区域，数组类型由len描述. ptr[i]为常量，或者是运行时求得的值
+void initLocalArray(CompilerContext &ctx, IRValue *base, IRValue **ptr, const vector<int> &len)
 {
     int n = len[0];
     if (len.size() == 1)
     {
         for (int i = 0; i < n; ++i)
         {
-            if(ptr[i] == "0")
+            if (isZero(ptr[i]))
                 continue;
-            string tmp = st.getTmpName();
-            ks.getelemptr(tmp, name, to_string(i));
-            ks.store(ptr[i], tmp);
+            IRValue *elem = ctx.irb.getelemptr(base, ctx.irb.integer(i));
+            ctx.irb.store(ptr[i], elem);
         }
     }
     else
@@ -35,27 +34,37 @@ void initLocalArray(string name, string *ptr, const vector<int> &len)
             width *= l;
         for (int i = 0; i < n; ++i)
         {
-            string tmp = st.getTmpName();
-            if (ptr[i*width] != "0"){
-                ks.getelemptr(tmp, name, to_string(i));
-            }
-            initLocalArray(tmp, ptr + i * width, sublen);
+            // 子数组全为 0 时已由 zeroinit 初始化，不必计算其地址
+            bool all_zero = true;
+            for (int j = 0; j < width && all_zero; ++j)
+                all_zero = isZero(ptr[i * width + j]);
+            if (all_zero)
+                continue;
+            IRValue *sub = ctx.irb.getelemptr(base, ctx.irb.integer(i));
+            initLocalArray(ctx, sub, ptr + i * width, sublen);
         }
     }
 }
 
+IRType *getArrayType(CompilerContext &ctx, const vector<int> &len)
+{
+    IRType *ans = ctx.irb.i32();
+    // 从最内层到最外层迭代
+    for (int i = len.size() - 1; i >= 0; i--)
+    {
+        ans = ctx.irb.program.getArray(ans, len[i]);
+    }
+    return ans;
+}
+
 // 全局变量数组初始化
-string initGlobalArray(string *ptr, const vector<int> &len)
+IRValue *initGlobalArray(CompilerContext &ctx, IRValue **ptr, const vector<int> &len)
 {
     int n = len[0];
-    string ret = "{";
+    vector<IRValue *> elems;
     if (len.size() == 1)
     {
-        ret += ptr[0];
-        for (int i = 1; i < n; ++i)
-        {
-            ret += ", " + ptr[i];
-        }
+        elems.assign(ptr, ptr + n);
     }
     else
     {
@@ -63,262 +72,218 @@ string initGlobalArray(string *ptr, const vector<int> &len)
         vector<int> sublen(len.begin() + 1, len.end());
         for (auto l : sublen)
             width *= l;
-        ret += initGlobalArray(ptr, sublen);
-        for (int i = 1; i < n; ++i)
+        for (int i = 0; i < n; ++i)
         {
-            ret += ", " + initGlobalArray(ptr + width * i, sublen);
+            elems.push_back(initGlobalArray(ctx, ptr + width * i, sublen));
         }
     }
-    ret += "}";
-    return ret;
+    return ctx.irb.program.getAggregate(getArrayType(ctx, len), elems);
 }
 
-string getArrayType(const vector<int> &len)
+IRValue *getElemPtr(CompilerContext &ctx, IRValue *base, const vector<IRValue *> &index)
 {
-    string ans = "i32";
-    // 从最内层到最外层迭代
-    for (int i = len.size() - 1; i >= 0; i--)
-    {
-        ans = "[" + ans + ", " + to_string(len[i]) + "]";
-    }
-    return ans;
+    IRValue *ptr = base;
+    for (auto i : index)
+        ptr = ctx.irb.getelemptr(ptr, i);
+    return ptr;
 }
 
-string getElemPtr(const string &name, const vector<string> &index)
-{
-    if (index.size() == 1)
-    {
-        string tmp = st.getTmpName();
-        ks.getelemptr(tmp, name, index[0]);
-        return tmp;
-    }
-    else
-    {
-        string tmp = st.getTmpName();
-        ks.getelemptr(tmp, name, index[0]);
-        return getElemPtr(
-            tmp,
-            vector<string>(index.begin() + 1, index.end()));
-    }
-}
-
-void CompUnitAST::Dump() const {
-    st.alloc();     // 全局作用域栈
+void CompUnitAST::Dump(CompilerContext &ctx) const {
+    ctx.st.alloc();     // 全局作用域栈
 
     // 库函数声明
-    ks.declLibFunc();
-    st.insertFUNC("getint", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("getch", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("getarray", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("putint", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("putch", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("putarray", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("starttime", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("stoptime", SysYType::SYSY_FUNC_VOID);
+    vector<IRFunction *> lib_funcs;
+    ctx.irb.declLibFunc(lib_funcs);
+    for (auto f : lib_funcs)
+    {
+        ctx.st.insertFUNC(ctx.interner.intern(string_view(f->name).substr(1)), f, f->retType()->tag == IRType::INT32 ?
+                SysYType::SYSY_FUNC_INT : SysYType::SYSY_FUNC_VOID);
+    }
 
     // 全局变量
     int len = decls.size();
     for (int i = 0; i < len; i++)
-        decls[i]->Dump(true);
-    if (len)
-        ks.append("\n");
+        decls[i]->Dump(ctx, true);
+    ctx.st.endGlobalNames();
 
     // 全局函数
     len = func_defs.size();
     for (int i = 0; i < len; i++)
-        func_defs[i]->Dump();
+        func_defs[i]->Dump(ctx);
 
-    st.quit();
+    ctx.st.quit();
     return;
 }
 
-void FuncDefAST::Dump() const {
-    st.resetNameManager();
-
-    // 函数名加到符号表 (全局)
-    st.insertFUNC(ident, func_type->tag == BTypeAST::INT ? 
-            SysYType::SYSY_FUNC_INT : SysYType::SYSY_FUNC_VOID);
-    ks.append("fun " + st.getName(ident) + "(");
+void FuncDefAST::Dump(CompilerContext &ctx) const {
+    ctx.st.resetNameManager();
 
-    st.alloc();
     int i = 0, len = func_f_params.size();
-    // 打印函数类型，但不直接使用参数中的变量，因此先不加入符号表中
+    // 生成参数的类型，但不直接使用参数中的变量，因此先不加入符号表中
     vector<string> var_names;
-    if(len){
-        var_names.push_back(st.getVarName(func_f_params[i]->ident));
-        ks.append(var_names.back() + ": ");
-        func_f_params[i]->Dump();
-        for (i++; i < len; i++)
-        {
-            ks.append(", ");
-            var_names.push_back(st.getVarName(func_f_params[i]->ident));
-            ks.append(var_names.back() + ": ");
-            func_f_params[i]->Dump();
-        }
-    }
-    ks.append(")");
-    if (func_type->tag == BTypeAST::INT)
+    vector<IRType *> param_tys;
+    for (i = 0; i < len; i++)
     {
-        ks.append(": i32");
+        var_names.push_back(ctx.st.getVarName(func_f_params[i]->ident));
+        param_tys.push_back(func_f_params[i]->getType(ctx));
     }
-    ks.append(" {\n");
+    IRFunction *func = ctx.irb.beginFunc(ctx.irb.declFunc("@" + ctx.interner.name(ident), param_tys,
+            func_type->tag == BTypeAST::INT ? ctx.irb.i32() : nullptr), var_names);
 
-    bc.set();           // 函数是一个基本块
-    ks.label("%entry");
+    // 函数名加到符号表 (全局)
+    ctx.st.insertFUNC(ident, func, func_type->tag == BTypeAST::INT ?
+            SysYType::SYSY_FUNC_INT : SysYType::SYSY_FUNC_VOID);
+
+    ctx.st.alloc();
+    ctx.bc.set();           // 函数是一个基本块
+    ctx.irb.label(ctx.irb.newBlock("%entry"));
 
     // 将参数中的变量映射为新变量后插入到函数作用域中，即参数中的变量并不在此函数中
     for (i = 0; i < len; i++)
     {
-        string var = var_names[i];
+        IRValue *var = func->params[i];
+        string name = ctx.st.getVarName(func_f_params[i]->ident);
+        IRValue *addr = ctx.irb.alloc(name, param_tys[i]);
+        ctx.irb.store(var, addr);
         if (func_f_params[i]->tag == FuncFParamAST::VARIABLE){
-            st.insertINT(func_f_params[i]->ident);
-            string name = st.getName(func_f_params[i]->ident);
-            ks.alloc(name);
-            ks.store(var, name);
+            ctx.st.insertINT(func_f_params[i]->ident, addr);
         }else{
             vector<int> len;
             vector<int> padding_len;    // 数组指针维度（第一维设置为-1，表示指针）
             padding_len.push_back(-1);
 
-            func_f_params[i]->getIndex(len);
+            func_f_params[i]->getIndex(ctx, len);
             for (int l : len)
                 padding_len.push_back(l);
 
             // 实际上插入的是数组指针，这里复用了接口
-            st.insertArray(func_f_params[i]->ident, padding_len, SysYType::SYSY_ARRAY);
-            string name = st.getName(func_f_params[i]->ident);
-
-            // 注意，这里应该传len，而不是padding_len
-            ks.alloc(name, "*" + getArrayType(len));
-            ks.store(var, name);
+            ctx.st.insertArray(func_f_params[i]->ident, addr, padding_len, SysYType::SYSY_ARRAY);
         }
     }
 
-    block->Dump();
+    block->Dump(ctx);
     // 特判空块
-    if (bc.alive())
+    if (ctx.bc.alive())
     {
         if (func_type->tag == BTypeAST::INT)
-            ks.ret("0");
+            ctx.irb.ret(ctx.irb.integer(0));
         else
-            ks.ret("");
-        bc.finish();
+            ctx.irb.ret(nullptr);
+        ctx.bc.finish();
     }
-    ks.append("}\n\n");
-    st.quit();
+    ctx.irb.endFunc();
+    ctx.st.quit();
+    return;
+}
+
+// 参数的类型由 FuncDefAST 通过 getType 统一处理
+void FuncFParamAST::Dump(CompilerContext &ctx) const
+{
     return;
 }
 
 // 返回参数类型，如i32, *[i32, 4]
-void FuncFParamAST::Dump() const
+IRType *FuncFParamAST::getType(CompilerContext &ctx) const
 {
     if (tag == VARIABLE)
     {
-        ks.append("i32");
-        return;
-    }
-    string ans = "i32";
-    for (auto &ce : const_exps)
-    {
-        ans = "[" + ans + ", " + to_string(ce->getValue()) + "]";
+        return ctx.irb.i32();
     }
-    ks.append("*" + ans);
-    return;
+    vector<int> len;
+    getIndex(ctx, len);
+    return ctx.irb.program.getPointer(getArrayType(ctx, len));
 }
 
 // 得到数组指针各维度的长度信息
-void FuncFParamAST::getIndex(vector<int> &len) const
+void FuncFParamAST::getIndex(CompilerContext &ctx, vector<int> &len) const
 {
     len.clear();
     for (auto &ce : const_exps)
     {
-        len.push_back(ce->getValue());
+        len.push_back(ce->getValue(ctx));
     }
     return;
 }
 
-void BTypeAST::Dump() const
+// 类型由使用者直接读取 tag，无需生成 IR
+void BTypeAST::Dump(CompilerContext &ctx) const
 {
-    if (tag == BTypeAST::INT)
-    {
-        ks.append("i32");
-    }
+    return;
 }
 
-void BlockAST::Dump() const {
-    st.alloc();
+void BlockAST::Dump(CompilerContext &ctx) const {
+    ctx.st.alloc();
     int len = block_items.size();
 
     for (int i = 0; i < len; i++)
     {
-        block_items[i]->Dump();
+        block_items[i]->Dump(ctx);
     }
-    st.quit();
+    ctx.st.quit();
     return;
 }
 
-void BlockItemAST::Dump() const
+void BlockItemAST::Dump(CompilerContext &ctx) const
 {
     // 若已存在跳转指令则不执行后面的语句
-    if(!bc.alive())
+    if(!ctx.bc.alive())
         return;
     if (decl)
-        decl->Dump();
+        decl->Dump(ctx);
     else
-        stmt->Dump();
+        stmt->Dump(ctx);
 }
 
-void DeclAST::Dump(bool is_global) const
+void DeclAST::Dump(CompilerContext &ctx, bool is_global) const
 {
     if (var_decl)
-        var_decl->Dump(is_global);
+        var_decl->Dump(ctx, is_global);
     else
-        const_decl->Dump(is_global);
+        const_decl->Dump(ctx, is_global);
 }
 
-void ConstDeclAST::Dump(bool is_global) const
+void ConstDeclAST::Dump(CompilerContext &ctx, bool is_global) const
 {
     int len = const_defs.size();
     for (int i = 0; i < len; i++)
     {
-        const_defs[i]->Dump(is_global);
+        const_defs[i]->Dump(ctx, is_global);
     }
 }
 
-void VarDeclAST::Dump(bool is_global) const
+void VarDeclAST::Dump(CompilerContext &ctx, bool is_global) const
 {
     int len = var_defs.size();
     for (int i = 0; i < len; i++)
     {
-        var_defs[i]->Dump(is_global);
+        var_defs[i]->Dump(ctx, is_global);
     }
 }
 
-void ConstDefAST::Dump(bool is_global) const
+void ConstDefAST::Dump(CompilerContext &ctx, bool is_global) const
 {
     if(const_exps.size()){
-        DumpArray(is_global);
+        DumpArray(ctx, is_global);
         return;
     }
-    int v = const_init_val->getValue();
-    st.insertINTCONST(ident, v);
+    int v = const_init_val->getValue(ctx);
+    ctx.st.insertINTCONST(ident, v);
 }
 
-void ConstDefAST::DumpArray(bool is_global) const
+void ConstDefAST::DumpArray(CompilerContext &ctx, bool is_global) const
 {
     vector<int> len;
     for (auto &ce : const_exps)
     {
-        len.push_back(ce->getValue());
+        len.push_back(ce->getValue(ctx));
     }
-    st.insertArray(ident, len, SysYType::SYSY_ARRAY_CONST);
 
-    string name = st.getName(ident);
-    string array_type = getArrayType(len);
+    string name = ctx.st.getVarName(ident);
+    IRType *array_type = getArrayType(ctx, len);
 
     // 若全局初始化列表为空，则用zeroinit初始化
     if (is_global && const_init_val->inits.size()==0){
-        ks.globalAllocArray(name, array_type);
+        ctx.st.insertArray(ident, ctx.irb.globalAlloc(name, array_type), len, SysYType::SYSY_ARRAY_CONST);
         return;
     }
 
@@ -326,80 +291,77 @@ void ConstDefAST::DumpArray(bool is_global) const
     int total_len = 1;
     for (auto i : len)
         total_len *= i;
-    string *init = new string[total_len];
-    for (int i = 0; i < total_len; i++)
-        init[i] = "0";
-    const_init_val->getInitVal(init, len);
+    vector<IRValue *> init(total_len, ctx.irb.integer(0));
+    const_init_val->getInitVal(ctx, init.data(), len);
 
     if (is_global)
     {
-        ks.globalAllocArray(name, array_type, initGlobalArray(init, len));
+        IRValue *arr = ctx.irb.globalAlloc(name, array_type, initGlobalArray(ctx, init.data(), len));
+        ctx.st.insertArray(ident, arr, len, SysYType::SYSY_ARRAY_CONST);
     }
     else
     {
-        ks.alloc(name, array_type);
-        ks.store("zeroinit", name);
-        initLocalArray(name, init, len);
+        IRValue *arr = ctx.irb.alloc(name, array_type);
+        ctx.st.insertArray(ident, arr, len, SysYType::SYSY_ARRAY_CONST);
+        ctx.irb.store(ctx.irb.program.getZeroInit(array_type), arr);
+        initLocalArray(ctx, arr, init.data(), len);
     }
     return;
 }
 
-void VarDefAST::Dump(bool is_global) const
+void VarDefAST::Dump(CompilerContext &ctx, bool is_global) const
 {
     if (const_exps.size())
     {
-        DumpArray(is_global);
+        DumpArray(ctx, is_global);
         return;
     }
-    st.insertINT(ident);
-    string name = st.getName(ident);
+    string name = ctx.st.getVarName(ident);
     if (is_global)
     {
         if (!init_val)
         {
-            ks.globalAllocINT(name);
+            ctx.st.insertINT(ident, ctx.irb.globalAlloc(name, ctx.irb.i32()));
         }
         else
         {
-            int v = init_val->getValue();
-            ks.globalAllocINT(name, to_string(v));
+            int v = init_val->getValue(ctx);
+            ctx.st.insertINT(ident, ctx.irb.globalAlloc(name, ctx.irb.i32(), ctx.irb.integer(v)));
         }
     }
     else{
-        ks.alloc(name);
+        IRValue *var = ctx.irb.alloc(name, ctx.irb.i32());
+        ctx.st.insertINT(ident, var);
         if (init_val)
         {
-            string s = init_val->Dump();
-            ks.store(s, name);
+            IRValue *s = init_val->Dump(ctx);
+            ctx.irb.store(s, var);
         }
     }
     return;
 }
 
-void VarDefAST::DumpArray(bool is_global) const
+void VarDefAST::DumpArray(CompilerContext &ctx, bool is_global) const
 {
     vector<int> len;
     for (auto &ce : const_exps)
     {
-        len.push_back(ce->getValue());
+        len.push_back(ce->getValue(ctx));
     }
-    st.insertArray(ident, len, SysYType::SYSY_ARRAY);
 
-    string name = st.getName(ident);
-    string array_type = getArrayType(len);
+    string name = ctx.st.getVarName(ident);
+    IRType *array_type = getArrayType(ctx, len);
 
     // 若没有初始化列表
     if(init_val == nullptr){
-        if(is_global)
-            ks.globalAllocArray(name, array_type);
-        else
-            ks.alloc(name, array_type);
+        IRValue *arr = is_global ? ctx.irb.globalAlloc(name, array_type) : ctx.irb.alloc(name, array_type);
+        ctx.st.insertArray(ident, arr, len, SysYType::SYSY_ARRAY);
         return;
     }
 
     // 若全局初始化列表为空，则用zeroinit初始化
     if (is_global && init_val->inits.size()==0){
-        ks.globalAllocArray(name, array_type);
+        ctx.st.insertArray(ident, ctx.irb.globalAlloc(name, array_type), len, SysYType::SYSY_ARRAY);
         return;
     }
 
@@ -407,396 +369,336 @@ void VarDefAST::DumpArray(bool is_global) const
     int total_len = 1;
     for (auto i : len)
         total_len *= i;
-    string *init = new string[total_len];
-    for (int i = 0; i < total_len; i++)
-        init[i] = "0";
+    vector<IRValue *> init(total_len, ctx.irb.integer(0));
 
     if (is_global)
     {
         // 全局变量初始化要在编译期求得初始值
-        init_val->getInitVal(init, len, true);
+        init_val->getInitVal(ctx, init.data(), len, true);
 
-        ks.globalAllocArray(name, array_type, initGlobalArray(init, len));
+        IRValue *arr = ctx.irb.globalAlloc(name, array_type, initGlobalArray(ctx, init.data(), len));
+        ctx.st.insertArray(ident, arr, len, SysYType::SYSY_ARRAY);
     }
     else
     {
+        IRValue *arr = ctx.irb.alloc(name, array_type);
+        ctx.st.insertArray(ident, arr, len, SysYType::SYSY_ARRAY);
+
         // 局部变量初始化是在运行时求值
-        // TO DO: 未初始化的变量不赋值
-        init_val->getInitVal(init, len, false);
+        init_val->getInitVal(ctx, init.data(), len, false);
 
-        ks.alloc(name, array_type);
-        ks.store("zeroinit",name);
-        initLocalArray(name, init, len);
+        ctx.irb.store(ctx.irb.program.getZeroInit(array_type), arr);
+        initLocalArray(ctx, arr, init.data(), len);
     }
     return;
 }
 
-void StmtAST::Dump() const {
+void StmtAST::Dump(CompilerContext &ctx) const {
     // 若已存在跳转指令则不执行后面的语句
-    if (!bc.alive())
+    if (!ctx.bc.alive())
         return;
     if (tag == RETURN)
     {
         if (exp)
         {
-            string name = exp->Dump();
-            ks.ret(name);
+            IRValue *val = exp->Dump(ctx);
+            ctx.irb.ret(val);
         }
         else
         {
-            ks.ret("");
+            ctx.irb.ret(nullptr);
         }
-        bc.finish();        // return语句之后的语句不再执行
+        ctx.bc.finish();        // return语句之后的语句不再执行
     }
     else if (tag == ASSIGN)
     {
-        string val = exp->Dump();
-        string to = lval->Dump(true);
-        ks.store(val, to);
+        IRValue *val = exp->Dump(ctx);
+        IRValue *to = lval->Dump(ctx, true);
+        ctx.irb.store(val, to);
     }
     else if (tag == BLOCK)
     {
-        block->Dump();
+        block->Dump(ctx);
     }
     else if (tag == EXP)
     {
         if (exp)
         {
-            exp->Dump();
+            exp->Dump(ctx);
         }
     }
     else if (tag == IF)
     {
-        string s = exp->Dump();
-        string t = st.getLabelName("then");
-        string e = st.getLabelName("else");
-        string j = st.getLabelName("end");
-        ks.br(s, t, else_stmt == nullptr ? j : e);
+        IRValue *s = exp->Dump(ctx);
+        IRBasicBlock *t = ctx.irb.newBlock(ctx.st.getLabelName("then"));
+        string else_name = ctx.st.getLabelName("else");
+        IRBasicBlock *e = else_stmt == nullptr ? nullptr : ctx.irb.newBlock(else_name);
+        IRBasicBlock *j = ctx.irb.newBlock(ctx.st.getLabelName("end"));
+        ctx.irb.br(s, t, else_stmt == nullptr ? j : e);
 
         // IF Stmt
-        bc.set();       // 进入新的基本块
-        ks.label(t);
-        if_stmt->Dump();
-        if (bc.alive()){
-            ks.jump(j);
-            bc.finish();
+        ctx.bc.set();       // 进入新的基本块
+        ctx.irb.label(t);
+        if_stmt->Dump(ctx);
+        if (ctx.bc.alive()){
+            ctx.irb.jump(j);
+            ctx.bc.finish();
         }
 
         // else stmt
         if (else_stmt != nullptr)
         {
-            bc.set();
-            ks.label(e);
-            else_stmt->Dump();
-            if (bc.alive()){
-                ks.jump(j);
-                bc.finish();
+            ctx.bc.set();
+            ctx.irb.label(e);
+            else_stmt->Dump(ctx);
+            if (ctx.bc.alive()){
+                ctx.irb.jump(j);
+                ctx.bc.finish();
             }
         }
         // end
-        bc.set();
-        ks.label(j);
+        ctx.bc.set();
+        ctx.irb.label(j);
     }
     else if (tag == WHILE)
     {
-        string while_entry = st.getLabelName("while_entry");
-        string while_body = st.getLabelName("while_body");
-        string while_end = st.getLabelName("while_end");
+        IRBasicBlock *while_entry = ctx.irb.newBlock(ctx.st.getLabelName("while_entry"));
+        IRBasicBlock *while_body = ctx.irb.newBlock(ctx.st.getLabelName("while_body"));
+        IRBasicBlock *while_end = ctx.irb.newBlock(ctx.st.getLabelName("while_end"));
 
-        wst.append(while_entry, while_body, while_end);
+        ctx.wst.append(while_entry, while_body, while_end);
 
-        ks.jump(while_entry);
+        ctx.irb.jump(while_entry);
 
-        bc.set();
-        ks.label(while_entry);
-        string cond = exp->Dump();
-        ks.br(cond, while_body, while_end);
+        ctx.bc.set();
+        ctx.irb.label(while_entry);
+        IRValue *cond = exp->Dump(ctx);
+        ctx.irb.br(cond, while_body, while_end);
 
-        bc.set();
-        ks.label(while_body);
-        stmt->Dump();
-        if (bc.alive()){
-            ks.jump(while_entry);
-            bc.finish();
+        ctx.bc.set();
+        ctx.irb.label(while_body);
+        stmt->Dump(ctx);
+        if (ctx.bc.alive()){
+            ctx.irb.jump(while_entry);
+            ctx.bc.finish();
         }
 
-        bc.set();
-        ks.label(while_end);
-        wst.quit(); // 该while处理已结束，退栈
+        ctx.bc.set();
+        ctx.irb.label(while_end);
+        ctx.wst.quit(); // 该while处理已结束，退栈
     }
     else if (tag == BREAK)
     {
-        ks.jump(wst.getEndName()); // 跳转到while_end
-        bc.finish();
+        ctx.irb.jump(ctx.wst.getEnd()); // 跳转到while_end
+        ctx.bc.finish();
     }
     else if (tag == CONTINUE)
     {
-        ks.jump(wst.getEntryName()); // 跳转到while_entry
-        bc.finish();
+        ctx.irb.jump(ctx.wst.getEntry()); // 跳转到while_entry
+        ctx.bc.finish();
     }
     return;
 }
 
-string PrimaryExpAST::Dump() const {
-    if (exp)
-        return exp->Dump();
-    else if(lval)
-        return lval->Dump();
+IRValue *PrimaryExpAST::Dump(CompilerContext &ctx) const {
+    if(lval)
+        return lval->Dump(ctx);
     else
-        return to_string(number);
+        return ctx.irb.integer(number);
 }
 
-int PrimaryExpAST::getValue() const {
-    if(exp)
-        return exp->getValue();
-    else if(lval)
-        return lval->getValue();
+int PrimaryExpAST::getValue(CompilerContext &ctx) const {
+    if(lval)
+        return lval->getValue(ctx);
     else
         return number;
 }
 
-string UnaryExpAST::Dump() const {
-    if (primary_exp)
-        return primary_exp->Dump();
-    else if (unary_exp)
+IRValue *UnaryExpAST::Dump(CompilerContext &ctx) const {
+    if (unary_op)
     {
-        string exp = unary_exp->Dump();
-        string ans;
-        if (unary_op == "+")
+        IRValue *exp = unary_exp->Dump(ctx);
+        IRValue *ans = nullptr;
+        if (unary_op == '+')
         {
             return exp;
         }
-        else if (unary_op == "-")
+        else if (unary_op == '-')
         {
-            ans = st.getTmpName();
-            ks.binary("sub", ans, "0", exp);
+            ans = ctx.irb.binary(IRValue::SUB, ctx.irb.integer(0), exp);
         }
-        else if (unary_op == "!")
+        else if (unary_op == '!')
         {
-            ans = st.getTmpName();
-            ks.binary("eq", ans, exp, "0");
+            ans = ctx.irb.binary(IRValue::EQ, exp, ctx.irb.integer(0));
         }
         return ans;
     }
     else
     {
-        // Func_Call
-        string tmp = "";
-        vector<string> par;
-        // 是否有返回值
-        if (st.getType(ident)->ty == SysYType::SYSY_FUNC_INT)
-        {
-            tmp = st.getTmpName();
-        }
+        // Func_Call，无返回值时结果为 nullptr
+        vector<IRValue *> par;
         int len = exps.size();
         for (int i = 0; i < len; i++)
         {
-            par.push_back(exps[i]->Dump());
+            par.push_back(exps[i]->Dump(ctx));
         }
-        ks.call(tmp, st.getName(ident), par);
-        return tmp;
+        Symbol *sym = ctx.st.lookup(ident);
+        if (!sym || !sym->func)
+        {
+            ctx.fail("undefined function " + ctx.interner.name(ident));
+            return ctx.irb.integer(0);
+        }
+        return ctx.irb.call(sym->func, par);
     }
 }
 
-int UnaryExpAST::getValue() const {
-    if (primary_exp)
-        return primary_exp->getValue();
-    int v = unary_exp->getValue();
-    return unary_op == "+" ? v : (unary_op == "-" ? -v : !v);
+int UnaryExpAST::getValue(CompilerContext &ctx) const {
+    int v = unary_exp->getValue(ctx);
+    return unary_op == '+' ? v : (unary_op == '-' ? -v : !v);
 }
 
-string MulExpAST::Dump() const
+IRValue *MulExpAST::Dump(CompilerContext &ctx) const
 {
-    if (unary_exp)
-        return unary_exp->Dump();
-    string exp1, exp2, ans;
-
-    exp1 = mul_exp_1->Dump();
-    exp2 = unary_exp_2->Dump();
+    IRValue *exp1, *exp2;
 
-    string op = mul_op == "*" ? "mul" : (mul_op == "/" ? "div" : "mod");
+    exp1 = mul_exp_1->Dump(ctx);
+    exp2 = unary_exp_2->Dump(ctx);
 
-    ans = st.getTmpName();
-    ks.binary(op, ans, exp1, exp2);
-    return ans;
+    return ctx.irb.binary(op, exp1, exp2);
 }
 
-int MulExpAST::getValue() const {
-    if (unary_exp)
-        return unary_exp->getValue();
-    int v1 = mul_exp_1->getValue(), v2 = unary_exp_2->getValue();
-    return mul_op == "*" ? v1 * v2 : (mul_op == "/" ? v1 / v2 : v1 % v2);
+int MulExpAST::getValue(CompilerContext &ctx) const {
+    int v1 = mul_exp_1->getValue(ctx), v2 = unary_exp_2->getValue(ctx);
+    if (op != IRValue::MUL && (v2 == 0 || (v1 == INT32_MIN && v2 == -1)))
+    {
+        ctx.fail("division by zero or overflow in constant expression");
+        return 0;
+    }
+    return op == IRValue::MUL ? v1 * v2 : (op == IRValue::DIV ? v1 / v2 : v1 % v2);
 }
 
-string AddExpAST::Dump() const {
-    if (mul_exp)
-        return mul_exp->Dump();
-    string exp1, exp2, ans;
+IRValue *AddExpAST::Dump(CompilerContext &ctx) const {
+    IRValue *exp1, *exp2;
 
-    exp1 = add_exp_1->Dump();
-    exp2 = mul_exp_2->Dump();
+    exp1 = add_exp_1->Dump(ctx);
+    exp2 = mul_exp_2->Dump(ctx);
 
-    string op = add_op == "+" ? "add" : "sub";
-
-    ans = st.getTmpName();
-    ks.binary(op, ans, exp1, exp2);
-    return ans;
+    return ctx.irb.binary(op, exp1, exp2);
 }
 
-int AddExpAST::getValue() const {
-    if (mul_exp)
-        return mul_exp->getValue();
-    int v1 = add_exp_1->getValue(), v2 = mul_exp_2->getValue();
-    return add_op == "+" ? v1 + v2 : v1 - v2;
-}
-
-string RelExpAST::Dump() const {
-    if(add_exp)
-        return add_exp->Dump();
-    string exp1, exp2, ans, op;
-    exp1 = rel_exp_1->Dump();
-    exp2 = add_exp_2->Dump();
-    if(rel_op == "<")
-        op = "lt";
-    else if(rel_op == "<=")
-        op = "le";
-    else if(rel_op == ">")
-        op = "gt";
-    else if (rel_op == ">=")
-        op = "ge";
-    ans = st.getTmpName();
-    ks.binary(op, ans, exp1, exp2);
-    return ans;
+int AddExpAST::getValue(CompilerContext &ctx) const {
+    int v1 = add_exp_1->getValue(ctx), v2 = mul_exp_2->getValue(ctx);
+    return op == IRValue::ADD ? v1 + v2 : v1 - v2;
 }
 
-int RelExpAST::getValue() const {
-    if (add_exp)
-        return add_exp->getValue();
+IRValue *RelExpAST::Dump(CompilerContext &ctx) const {
+    IRValue *exp1, *exp2;
+    exp1 = rel_exp_1->Dump(ctx);
+    exp2 = add_exp_2->Dump(ctx);
+    return ctx.irb.binary(op, exp1, exp2);
+}
 
-    int v1 = rel_exp_1->getValue(), v2 = add_exp_2->getValue();
-    if (rel_op == "<")
+int RelExpAST::getValue(CompilerContext &ctx) const {
+    int v1 = rel_exp_1->getValue(ctx), v2 = add_exp_2->getValue(ctx);
+    if (op == IRValue::LT)
         return v1 < v2;
-    else if (rel_op == "<=")
+    else if (op == IRValue::LE)
         return v1 <= v2;
-    else if (rel_op == ">")
+    else if (op == IRValue::GT)
         return v1 > v2;
     else
         return v1 >= v2;
 }
 
-string EqExpAST::Dump() const
+IRValue *EqExpAST::Dump(CompilerContext &ctx) const
 {
-    if (rel_exp)
-        return rel_exp->Dump();
-    string exp1, exp2, ans;
-
-    exp1 = eq_exp_1->Dump();
-    exp2 = rel_exp_2->Dump();
+    IRValue *exp1, *exp2;
 
-    string op = eq_op == "==" ? "eq" : "ne";
+    exp1 = eq_exp_1->Dump(ctx);
+    exp2 = rel_exp_2->Dump(ctx);
 
-    ans = st.getTmpName();
-    ks.binary(op, ans, exp1, exp2);
-    return ans;
+    return ctx.irb.binary(op, exp1, exp2);
 }
 
-int EqExpAST::getValue() const {
-    if (rel_exp)
-        return rel_exp->getValue();
-    int v1 = eq_exp_1->getValue(), v2 = rel_exp_2->getValue();
-    return eq_op == "==" ? (v1 == v2) : (v1 != v2);
+int EqExpAST::getValue(CompilerContext &ctx) const {
+    int v1 = eq_exp_1->getValue(ctx), v2 = rel_exp_2->getValue(ctx);
+    return op == IRValue::EQ ? (v1 == v2) : (v1 != v2);
 }
 
-string LAndExpAST::Dump() const
+IRValue *LAndExpAST::Dump(CompilerContext &ctx) const
 {
-    if (eq_exp)
-        return eq_exp->Dump();
     // 修改支持短路逻辑
-    string result = st.getVarName("SCRES");
-    ks.alloc(result);
-    ks.store("0", result);
+    IRValue *result = ctx.irb.alloc(ctx.st.getVarName(ctx.scres), ctx.irb.i32());
+    ctx.irb.store(ctx.irb.integer(0), result);
 
-    string lhs = l_and_exp_1->Dump();
-    string then_s = st.getLabelName("then_sc");
-    string end_s = st.getLabelName("end_sc");
+    IRValue *lhs = l_and_exp_1->Dump(ctx);
+    IRBasicBlock *then_s = ctx.irb.newBlock(ctx.st.getLabelName("then_sc"));
+    IRBasicBlock *end_s = ctx.irb.newBlock(ctx.st.getLabelName("end_sc"));
 
     // 若左条件是true，则继续判断右条件，否则结束
-    ks.br(lhs, then_s, end_s);
-
-    bc.set();
-    ks.label(then_s);
-    string rhs = eq_exp_2->Dump();
-    string tmp = st.getTmpName();
-    ks.binary("ne", tmp, rhs, "0");
-    ks.store(tmp, result);
-    ks.jump(end_s);
-    bc.finish();
-
-    bc.set();
-    ks.label(end_s);
-    string ret = st.getTmpName();
-    ks.load(ret, result);
-    return ret;
-}
-
-int LAndExpAST::getValue() const {
-    if (eq_exp)
-        return eq_exp->getValue();
-    int v1 = l_and_exp_1->getValue(), v2 = eq_exp_2->getValue();
+    ctx.irb.br(lhs, then_s, end_s);
+
+    ctx.bc.set();
+    ctx.irb.label(then_s);
+    IRValue *rhs = eq_exp_2->Dump(ctx);
+    IRValue *tmp = ctx.irb.binary(IRValue::NOT_EQ, rhs, ctx.irb.integer(0));
+    ctx.irb.store(tmp, result);
+    ctx.irb.jump(end_s);
+    ctx.bc.finish();
+
+    ctx.bc.set();
+    ctx.irb.label(end_s);
+    return ctx.irb.load(result);
+}
+
+int LAndExpAST::getValue(CompilerContext &ctx) const {
+    int v1 = l_and_exp_1->getValue(ctx), v2 = eq_exp_2->getValue(ctx);
     return v1 && v2;
 }
 
-string LOrExpAST::Dump() const {
-    if (l_and_exp)
-        return l_and_exp->Dump();
+IRValue *LOrExpAST::Dump(CompilerContext &ctx) const {
     // 修改支持短路逻辑
-    string result = st.getVarName("SCRES");
-    ks.alloc(result);
-    ks.store("1", result);
+    IRValue *result = ctx.irb.alloc(ctx.st.getVarName(ctx.scres), ctx.irb.i32());
+    ctx.irb.store(ctx.irb.integer(1), result);
 
-    string lhs = l_or_exp_1->Dump();
+    IRValue *lhs = l_or_exp_1->Dump(ctx);
 
-    string then_s = st.getLabelName("then_sc");
-    string end_s = st.getLabelName("end_sc");
+    IRBasicBlock *then_s = ctx.irb.newBlock(ctx.st.getLabelName("then_sc"));
+    IRBasicBlock *end_s = ctx.irb.newBlock(ctx.st.getLabelName("end_sc"));
 
     // 若左条件是false，则继续判断右条件，否则结束
-    ks.br(lhs, end_s, then_s);
-
-    bc.set();
-    ks.label(then_s);
-    string rhs = l_and_exp_2->Dump();
-    string tmp = st.getTmpName();
-    ks.binary("ne", tmp, rhs, "0");
-    ks.store(tmp, result);
-    ks.jump(end_s);
-    bc.finish();
-
-    bc.set();
-    ks.label(end_s);
-    string ret = st.getTmpName();
-    ks.load(ret, result);
-    return ret;
-}
-
-int LOrExpAST::getValue() const {
-    if (l_and_exp)
-        return l_and_exp->getValue();
-    int v1 = l_or_exp_1->getValue(), v2 = l_and_exp_2->getValue();
+    ctx.irb.br(lhs, end_s, then_s);
+
+    ctx.bc.set();
+    ctx.irb.label(then_s);
+    IRValue *rhs = l_and_exp_2->Dump(ctx);
+    IRValue *tmp = ctx.irb.binary(IRValue::NOT_EQ, rhs, ctx.irb.integer(0));
+    ctx.irb.store(tmp, result);
+    ctx.irb.jump(end_s);
+    ctx.bc.finish();
+
+    ctx.bc.set();
+    ctx.irb.label(end_s);
+    return ctx.irb.load(result);
+}
+
+int LOrExpAST::getValue(CompilerContext &ctx) const {
+    int v1 = l_or_exp_1->getValue(ctx), v2 = l_and_exp_2->getValue(ctx);
     return v1 || v2;
 }
 
-string InitValAST::Dump() const
+IRValue *InitValAST::Dump(CompilerContext &ctx) const
 {
-    return exp->Dump();
+    return exp->Dump(ctx);
 }
 
-int InitValAST::getValue() const
+int InitValAST::getValue(CompilerContext &ctx) const
 {
-    return exp->getValue();
+    return exp->getValue(ctx);
 }
 
 // 难点：得到填充0后的初始化列表
-void InitValAST::getInitVal(string *ptr, const vector<int> &len, bool is_global) const
+void InitValAST::getInitVal(CompilerContext &ctx, IRValue **ptr, const vector<int> &len, bool is_global) const
 {
     int n = len.size();
     vector<int> width(n);
@@ -814,12 +716,12 @@ void InitValAST::getInitVal(string *ptr, const vector<int> &len, bool is_global)
             // 全局变量要在编译期求得初始值
             if (is_global)
             {
-                ptr[i++] = to_string(init_val->exp->getValue());
+                ptr[i++] = ctx.irb.integer(init_val->exp->getValue(ctx));
             }
             // 局部变量在运行时算出
             else
             {
-                ptr[i++] = init_val->Dump();
+                ptr[i++] = init_val->Dump(ctx);
             }
         }
         else
@@ -839,7 +741,7 @@ void InitValAST::getInitVal(string *ptr, const vector<int> &len, bool is_global)
                 }
                 ++j; // j 指向最大的可除的维度
             }
-            init_val->getInitVal(
+            init_val->getInitVal(ctx, 
                 ptr + i,
                 vector<int>(len.begin() + j, len.end()));
             i += width[j];
@@ -849,12 +751,12 @@ void InitValAST::getInitVal(string *ptr, const vector<int> &len, bool is_global)
     }
 }
 
-int ConstInitValAST::getValue() const {
-    return const_exp->getValue();
+int ConstInitValAST::getValue(CompilerContext &ctx) const {
+    return const_exp->getValue(ctx);
 }
 
 // 对ptr指向的区域初始化，所指区域的数组类型由len规定
-void ConstInitValAST::getInitVal(string *ptr, const vector<int> &len) const
+void ConstInitValAST::getInitVal(CompilerContext &ctx, IRValue **ptr, const vector<int> &len) const
 {
     int n = len.size();
     vector<int> width(n);
@@ -868,7 +770,7 @@ void ConstInitValAST::getInitVal(string *ptr, const vector<int> &len) const
     {
         if (init_val->const_exp)
         {
-            ptr[i++] = to_string(init_val->getValue());
+            ptr[i++] = ctx.irb.integer(init_val->getValue(ctx));
         }
         else
         {
@@ -887,7 +789,7 @@ void ConstInitValAST::getInitVal(string *ptr, const vector<int> &len) const
                 }
                 ++j;               // j 指向最大的可除的维度
             }
-            init_val->getInitVal(
+            init_val->getInitVal(ctx, 
                 ptr + i,
                 vector<int>(len.begin() + j, len.end()));
             i += width[j];
@@ -897,20 +799,26 @@ void ConstInitValAST::getInitVal(string *ptr, const vector<int> &len) const
     }
 }
 
-string LValAST::Dump(bool dump_ptr) const {
-    SysYType *ty = st.getType(ident);
+IRValue *LValAST::Dump(CompilerContext &ctx, bool dump_ptr) const {
+    // 只查找一次符号，之后复用
+    Symbol *sym = ctx.st.lookup(ident);
+    if (!sym || sym->func)
+    {
+        ctx.fail("undefined variable " + ctx.interner.name(ident));
+        return ctx.irb.integer(0);
+    }
+    SysYType *ty = sym->ty;
+    IRValue *addr = sym->ir;
     if(!exps.size()){
         if (ty->ty == SysYType::SYSY_INT_CONST)
-            return to_string(getValue());
+            return ctx.irb.integer(ty->value);
         else if (ty->ty == SysYType::SYSY_INT)
         {
             if (dump_ptr == false)
             {
-                string tmp = st.getTmpName();
-                ks.load(tmp, st.getName(ident));
-                return tmp;
+                return ctx.irb.load(addr);
             }
-            return st.getName(ident);
+            return addr;
         }
         // 如int a[2][3] 中的 a,或int a[]中的 a
         else
@@ -918,26 +826,21 @@ string LValAST::Dump(bool dump_ptr) const {
             // 若是数组指针（变量）
             if (ty->value == -1)
             {
-                string tmp = st.getTmpName();
-                cout << tmp<<' '<<st.getName(ident) << "\n";
-                ks.load(tmp, st.getName(ident));
-                return tmp;
+                return ctx.irb.load(addr);
             }
             // 首值（常量）
-            string tmp = st.getTmpName();
-            ks.getelemptr(tmp, st.getName(ident), "0");
-            return tmp;
+            return ctx.irb.getelemptr(addr, ctx.irb.integer(0));
         }
     }
     // 多维数组指针或数组值（为int）
     else
     {
-        vector<string> index;
+        vector<IRValue *> index;
         vector<int> len;
 
         for (auto &e : exps)
         {
-            index.push_back(e->Dump());
+            index.push_back(e->Dump(ctx));
         }
 
         ty->getIndex(len);
@@ -946,51 +849,41 @@ string LValAST::Dump(bool dump_ptr) const {
         // 如 a[-1][3][2],表明a是参数 a[][3][2], 即 *[3][2].
         // 此时第一步不能用getelemptr，而应该getptr
 
-        string name = st.getName(ident);
-        string tmp;
+        IRValue *tmp;
         if (len.size() != 0 && len[0] == -1)
         {
-            vector<int> sublen(len.begin() + 1, len.end());
-            string tmp_val = st.getTmpName();
-            ks.load(tmp_val, name);
-            string first_indexed = st.getTmpName();
-            ks.getptr(first_indexed, tmp_val, index[0]);
-            if (index.size() > 1)
-            {
-                tmp = getElemPtr(
-                    first_indexed,
-                    vector<string>(
-                        index.begin() + 1, index.end()));
-            }
-            else
-            {
-                tmp = first_indexed;
-            }
+            IRValue *tmp_val = ctx.irb.load(addr);
+            IRValue *first_indexed = ctx.irb.getptr(tmp_val, index[0]);
+            tmp = getElemPtr(ctx, 
+                first_indexed,
+                vector<IRValue *>(index.begin() + 1, index.end()));
         }
         else
         {
-            tmp = getElemPtr(name, index);
+            tmp = getElemPtr(ctx, addr, index);
         }
 
         if (index.size() < len.size())
         {
             // 一定是作为函数参数即实参使用，因为下标不完整
-            string real_param = st.getTmpName();
-            ks.getelemptr(real_param, tmp, "0");
-            return real_param;
+            return ctx.irb.getelemptr(tmp, ctx.irb.integer(0));
         }
         if (dump_ptr)
             return tmp;
-        string tmp2 = st.getTmpName();
-        ks.load(tmp2, tmp);
-        return tmp2;
+        return ctx.irb.load(tmp);
     }
 }
 
-int LValAST::getValue() const {
-    return st.getValue(ident);
+int LValAST::getValue(CompilerContext &ctx) const {
+    Symbol *sym = ctx.st.lookup(ident);
+    if (!sym || sym->func)
+    {
+        ctx.fail("undefined variable " + ctx.interner.name(ident));
+        return 0;
+    }
+    return sym->ty->value;
 }
 
-int ConstExpAST::getValue() const {
-    return exp->getValue();
+int ConstExpAST::getValue(CompilerContext &ctx) const {
+    return exp->getValue(ctx);
 }
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// 按块分配的内存池，对象只能整体释放
+// 一次编译的 AST 节点和词法分析得到的标识符都放在这里，编译结束时随 Arena 一起释放，不逐个析构
+class Arena
+{
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    vector<unique_ptr<char[]>> chunks;
+    char *ptr = nullptr;    // 当前块中下一个可用的位置
+    char *end = nullptr;
+    size_t used = 0;        // 已分配的字节数，用于统计
+    size_t reserved = 0;    // 向系统申请的字节数
+    size_t first_size = 0;  // 第一块的大小，reset 时保留这一块
+
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *alloc(size_t size, size_t align = alignof(max_align_t))
+    {
+        size_t pad = -(uintptr_t)ptr & (align - 1);
+        if (ptr == nullptr || size + pad > (size_t)(end - ptr))
+        {
+            // 超过块大小的对象单独占一块
+            size_t n = max(size + align, CHUNK_SIZE);
+            chunks.emplace_back(new char[n]);
+            reserved += n;
+            if (chunks.size() == 1)
+                first_size = n;
+            ptr = chunks.back().get();
+            end = ptr + n;
+            pad = -(uintptr_t)ptr & (align - 1);
+        }
+        void *p = ptr + pad;
+        ptr += pad + size;
+        used += size;
+        return p;
+    }
+
+    // 在池中构造对象，析构函数不会被调用，因此要求类型可平凡析构
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        static_assert(is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (alloc(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+    }
+
+    // 复制一个以 '\0' 结尾的字符串
+    const char *strdup(const char *s, size_t len)
+    {
+        char *p = (char *)alloc(len + 1, 1);
+        memcpy(p, s, len);
+        p[len] = '\0';
+        return p;
+    }
+
+    // 丢弃所有对象，只保留第一块内存供之后复用，用于在多次编译之间复用同一个 Arena
+    void reset()
+    {
+        if (chunks.size() > 1)
+            chunks.erase(chunks.begin() + 1, chunks.end());
+        used = 0;
+        reserved = chunks.empty() ? 0 : first_size;
+        ptr = chunks.empty() ? nullptr : chunks[0].get();
+        end = ptr ? ptr + first_size : nullptr;
+    }
+
+    size_t bytesUsed() const
+    {
+        return used;
+    }
+
+    size_t bytesReserved() const
+    {
+        return reserved;
+    }
+};
+
+// 元素存放在 Arena 中的动态数组，扩容时旧的空间留在池中不回收
+// 只支持 AST 用到的操作：在末尾添加、遍历和下标访问
+template <typename T>
+class ArenaVector
+{
+private:
+    T *data_ = nullptr;
+    int size_ = 0, cap = 0;
+
+public:
+    static_assert(is_trivially_copyable<T>::value, "elements are moved with memcpy");
+
+    void push_back(Arena &arena, const T &v)
+    {
+        if (size_ == cap)
+        {
+            cap = cap ? cap * 2 : 4;
+            T *p = (T *)arena.alloc(sizeof(T) * cap, alignof(T));
+            if (size_)
+                memcpy((void *)p, data_, sizeof(T) * size_);
+            data_ = p;
+        }
+        data_[size_++] = v;
+    }
+
+    int size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    T &operator[](int i) const { return data_[i]; }
+    T *begin() const { return data_; }
+    T *end() const { return data_ + size_; }
+};
@@ -1,11 +1,16 @@
 #pragma once
+#include <cstdio>
 #include <iostream>
-#include <memory>
 #include <string>
 #include <vector>
+#include "../../middle-end/include/ir.hpp"
+#include "arena.hpp"
+#include "intern.hpp"
 
 using namespace std;
 
+class CompilerContext;
+
 // 框架类的声明
 class BaseAST;
 class CompUnitAST;
@@ -40,32 +45,39 @@ class ConstExpAST;
 class ConstInitValAST;
 class InitValAST;
 
+// AST 节点都分配在 Arena 中，随 Arena 整体释放，不会被析构
+// 因此节点中只能保存指针、ArenaVector 和标识符句柄等可平凡析构的成员
+// 生成 IR 时用到的符号表等状态都在 CompilerContext 中，由 Dump 逐层传递
+
+// 解析 in 中的 SysY 程序，标识符驻留到 interner，AST 分配在 arena 中，语法错误时返回 nullptr 并在 error 中说明原因
+// 每次调用使用独立的 scanner 和 parser 状态，不同线程可以同时解析不同的文件（定义在 sysy.l 中）
+BaseAST *Parse(FILE *in, Interner &interner, Arena &arena, string &error);
+// 同上，解析内存中的源程序
+BaseAST *Parse(string_view src, Interner &interner, Arena &arena, string &error);
+
 // 程序框架的基类
 class BaseAST {
   public:
-    virtual ~BaseAST() = default;
-
-    virtual void Dump() const = 0;
+    virtual void Dump(CompilerContext &ctx) const = 0;
 };
 
 class CompUnitAST : public BaseAST {
   public:
-  // 用智能指针管理对象
-    vector<unique_ptr<BaseAST>> func_defs;
-    vector<unique_ptr<DefAST>> decls;
+    ArenaVector<BaseAST *> func_defs;
+    ArenaVector<DefAST *> decls;
 
-    void Dump() const override;
+    void Dump(CompilerContext &ctx) const override;
 };
 
 // 函数定义都在全局作用域内
 class FuncDefAST : public BaseAST {
   public:
-    unique_ptr<BTypeAST> func_type; // 返回值类型
-    string ident;
-    vector<unique_ptr<FuncFParamAST>> func_f_params;
-    unique_ptr<BaseAST> block;
+    BTypeAST *func_type = nullptr; // 返回值类型
+    Ident ident;
+    ArenaVector<FuncFParamAST *> func_f_params;
+    BaseAST *block = nullptr;
 
-    void Dump() const override;
+    void Dump(CompilerContext &ctx) const override;
 };
 
 class FuncFParamAST: public BaseAST
@@ -77,14 +89,15 @@ class FuncFParamAST: public BaseAST
       ARRAY
     };
     TAG tag;
-    unique_ptr<BaseAST> btype;
-    string ident;
+    BaseAST *btype = nullptr;
+    Ident ident;
     // 需要注意参数为一维数组指针的特殊情况
     // 如 int a[]，此时虽然const_exps为空，但变量仍属于ARRAY
-    vector<unique_ptr<ExpAST>> const_exps; 
+    ArenaVector<ExpAST *> const_exps; 
 
-    void Dump() const override; 
-    void getIndex(vector<int> &len) const;
+    void Dump(CompilerContext &ctx) const override; 
+    void getIndex(CompilerContext &ctx, vector<int> &len) const;
+    IRType *getType(CompilerContext &ctx) const;  // 参数在 IR中的类型，如 i32, *[i32, 4]
 };
 
 class BTypeAST : public BaseAST
@@ -96,23 +109,23 @@ class BTypeAST : public BaseAST
       INT
     };
     TAG tag;
-    void Dump() const override;
+    void Dump(CompilerContext &ctx) const override;
 };
 
 class BlockAST : public BaseAST {
   public:
-    vector<unique_ptr<BaseAST>> block_items;
+    ArenaVector<BaseAST *> block_items;
 
-    void Dump() const override;
+    void Dump(CompilerContext &ctx) const override;
 };
 
 class BlockItemAST : public BaseAST
 {
   public:
-    unique_ptr<DefAST> decl;
-    unique_ptr<BaseAST> stmt;
+    DefAST *decl = nullptr;
+    BaseAST *stmt = nullptr;
 
-    void Dump() const override;
+    void Dump(CompilerContext &ctx) const override;
 };
 
 class StmtAST : public BaseAST
@@ -130,14 +143,14 @@ class StmtAST : public BaseAST
       CONTINUE
     };
     TAG tag;
-    unique_ptr<ExpAST> exp;
-    unique_ptr<LValAST> lval;
-    unique_ptr<BaseAST> block;
-    unique_ptr<BaseAST> stmt;
-    unique_ptr<BaseAST> if_stmt;
-    unique_ptr<BaseAST> else_stmt;
-
-    void Dump() const override;
+    ExpAST *exp = nullptr;
+    LValAST *lval = nullptr;
+    BaseAST *block = nullptr;
+    BaseAST *stmt = nullptr;
+    BaseAST *if_stmt = nullptr;
+    BaseAST *else_stmt = nullptr;
+
+    void Dump(CompilerContext &ctx) const override;
 };
 
 
@@ -145,195 +158,183 @@ class StmtAST : public BaseAST
 class DefAST
 {
   public:
-    virtual ~DefAST() = default;
-
-    virtual void Dump(bool is_global = false) const = 0;
+    virtual void Dump(CompilerContext &ctx, bool is_global = false) const = 0;
 };
 
 class DeclAST : public DefAST
 {
   public:
-    unique_ptr<DefAST> const_decl;
-    unique_ptr<DefAST> var_decl;
-    void Dump(bool is_global = false) const override;
+    DefAST *const_decl = nullptr;
+    DefAST *var_decl = nullptr;
+    void Dump(CompilerContext &ctx, bool is_global = false) const override;
 };
 
 class ConstDeclAST : public DefAST
 {
   public:
-    unique_ptr<BaseAST> btype;
-    vector<unique_ptr<DefAST>> const_defs;
-    void Dump(bool is_global = false) const override;
+    BaseAST *btype = nullptr;
+    ArenaVector<DefAST *> const_defs;
+    void Dump(CompilerContext &ctx, bool is_global = false) const override;
 };
 
 class VarDeclAST : public DefAST
 {
   public:
-    unique_ptr<BaseAST> btype;
-    vector<unique_ptr<DefAST>> var_defs;
-    void Dump(bool is_global = false) const override;
+    BaseAST *btype = nullptr;
+    ArenaVector<DefAST *> var_defs;
+    void Dump(CompilerContext &ctx, bool is_global = false) const override;
 };
 
 class ConstDefAST : public DefAST
 {
   public:
-    string ident;
-    vector<unique_ptr<ExpAST>> const_exps;  // 据此判断是否为数组
-    unique_ptr<ConstInitValAST> const_init_val; // 常量一定有初始值
-    void Dump(bool is_global = false) const override;
-    void DumpArray(bool is_global = false) const;
+    Ident ident;
+    ArenaVector<ExpAST *> const_exps;  // 据此判断是否为数组
+    ConstInitValAST *const_init_val = nullptr; // 常量一定有初始值
+    void Dump(CompilerContext &ctx, bool is_global = false) const override;
+    void DumpArray(CompilerContext &ctx, bool is_global = false) const;
 };
 
 class VarDefAST : public DefAST
 {
   public:
-    string ident;
-    vector<unique_ptr<ExpAST>> const_exps; // 据此判断是否为数组
-    unique_ptr<InitValAST> init_val;  // 变量不一定有初始值，可能为空
-    void Dump(bool is_global = false) const override;
-    void DumpArray(bool is_global = false) const;
+    Ident ident;
+    ArenaVector<ExpAST *> const_exps; // 据此判断是否为数组
+    InitValAST *init_val = nullptr;  // 变量不一定有初始值，可能为空
+    void Dump(CompilerContext &ctx, bool is_global = false) const override;
+    void DumpArray(CompilerContext &ctx, bool is_global = false) const;
 };
 
 class LValAST
 {
   public:
-    string ident;
+    Ident ident;
     // 需要注意参数为一维数组指针的特殊情况
     // 如传递给int a[] 的实参 a，此时虽然exps为空，但变量属于数组指针而非int
-    vector<unique_ptr<ExpAST>> exps;
-    string Dump(bool dump_ptr = false) const; // 赋值时store到 @x，计算时load到 %n
-    int getValue() const;
+    ArenaVector<ExpAST *> exps;
+    IRValue *Dump(CompilerContext &ctx, bool dump_ptr = false) const; // 赋值时store到 @x，计算时load到 %n
+    int getValue(CompilerContext &ctx) const;
 };
 
 
 // 所有表达式的基类
 class ExpAST {
   public:
-    virtual ~ExpAST() = default;
-
-    virtual string Dump() const = 0;    // 返回结果对应的符号
-    virtual int getValue() const = 0;   // 返回结果，用于条件判断等
+    virtual IRValue *Dump(CompilerContext &ctx) const = 0;  // 返回结果对应的 IR值
+    virtual int getValue(CompilerContext &ctx) const = 0;   // 返回结果，用于条件判断等
 };
 
 class PrimaryExpAST : public ExpAST {
   public:
-    int number;
-    unique_ptr<ExpAST> exp;
-    unique_ptr<LValAST> lval;
+    int number = 0;
+    LValAST *lval = nullptr;    // 为空时表示整数字面量
 
-    string Dump() const override;
-    int getValue() const override;
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class UnaryExpAST : public ExpAST {
   public:
-    string unary_op;
-    unique_ptr<ExpAST> primary_exp;
-    unique_ptr<ExpAST> unary_exp;
-    string ident;
-    vector<unique_ptr<ExpAST>> exps;
-
-    string Dump() const override;
-    int getValue() const override;
+    char unary_op = 0;              // '+', '-', '!'，为 0 时表示函数调用
+    ExpAST *unary_exp = nullptr;
+    Ident ident;
+    ArenaVector<ExpAST *> exps;
+
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class AddExpAST : public ExpAST
 {
   public:
-    string add_op;
-    unique_ptr<ExpAST> mul_exp;
-    unique_ptr<ExpAST> add_exp_1;
-    unique_ptr<ExpAST> mul_exp_2;
+    IRValue::OP op;  // ADD, SUB
+    ExpAST *add_exp_1 = nullptr;
+    ExpAST *mul_exp_2 = nullptr;
 
-    string Dump() const override;
-    int getValue() const override;
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class MulExpAST : public ExpAST
 {
   public:
-    string mul_op;
-    unique_ptr<ExpAST> unary_exp;
-    unique_ptr<ExpAST> mul_exp_1;
-    unique_ptr<ExpAST> unary_exp_2;
+    IRValue::OP op;  // MUL, DIV, MOD
+    ExpAST *mul_exp_1 = nullptr;
+    ExpAST *unary_exp_2 = nullptr;
 
-    string Dump() const override;
-    int getValue() const override;
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class RelExpAST : public ExpAST
 {
   public:
-    string rel_op;
-    unique_ptr<ExpAST> add_exp;
-    unique_ptr<ExpAST> rel_exp_1;
-    unique_ptr<ExpAST> add_exp_2;
+    IRValue::OP op;  // LT, LE, GT, GE
+    ExpAST *rel_exp_1 = nullptr;
+    ExpAST *add_exp_2 = nullptr;
 
-    string Dump() const override;
-    int getValue() const override;
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class EqExpAST : public ExpAST
 {
   public:
-    string eq_op;
-    unique_ptr<ExpAST> rel_exp;
-    unique_ptr<ExpAST> eq_exp_1;
-    unique_ptr<ExpAST> rel_exp_2;
+    IRValue::OP op;  // EQ, NOT_EQ
+    ExpAST *eq_exp_1 = nullptr;
+    ExpAST *rel_exp_2 = nullptr;
 
-    string Dump() const override;
-    int getValue() const override;
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class LAndExpAST : public ExpAST
 {
   public:
-    unique_ptr<ExpAST> eq_exp;
-    unique_ptr<ExpAST> l_and_exp_1;
-    unique_ptr<ExpAST> eq_exp_2;
+    ExpAST *l_and_exp_1 = nullptr;
+    ExpAST *eq_exp_2 = nullptr;
 
-    string Dump() const override;
-    int getValue() const override;
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class LOrExpAST : public ExpAST
 {
   public:
-    unique_ptr<ExpAST> l_and_exp;
-    unique_ptr<ExpAST> l_or_exp_1;
-    unique_ptr<ExpAST> l_and_exp_2;
+    ExpAST *l_or_exp_1 = nullptr;
+    ExpAST *l_and_exp_2 = nullptr;
 
-    string Dump() const override;
-    int getValue() const override;
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class ConstExpAST : public ExpAST
 {
   public:
-    unique_ptr<ExpAST> exp;
+    ExpAST *exp = nullptr;
 
-    string Dump() const override { return ""; }
-    int getValue() const override;
+    IRValue *Dump(CompilerContext &ctx) const override { return nullptr; }
+    int getValue(CompilerContext &ctx) const override;
 };
 
 class ConstInitValAST : public ExpAST
 {
   public:
-    unique_ptr<ExpAST> const_exp;   // 递归终点
-    vector<unique_ptr<ConstInitValAST>> inits;  // 递归定义
+    ExpAST *const_exp = nullptr;   // 递归终点
+    ArenaVector<ConstInitValAST *> inits;  // 递归定义
 
-    string Dump() const override { return ""; }
-    int getValue() const override;
-    void getInitVal(string *ptr, const vector<int> &len) const; // 得到初始化列表
+    IRValue *Dump(CompilerContext &ctx) const override { return nullptr; }
+    int getValue(CompilerContext &ctx) const override;
+    void getInitVal(CompilerContext &ctx, IRValue **ptr, const vector<int> &len) const; // 得到初始化列表
 };
 
 class InitValAST : public ExpAST
 {
   public:
-    unique_ptr<ExpAST> exp;   // 递归终点
-    vector<unique_ptr<InitValAST>> inits;   // 递归定义
+    ExpAST *exp = nullptr;   // 递归终点
+    ArenaVector<InitValAST *> inits;   // 递归定义
 
-    string Dump() const override;
-    int getValue() const override;
-    void getInitVal(string *ptr, const vector<int> &len, bool is_global = false) const;
+    IRValue *Dump(CompilerContext &ctx) const override;
+    int getValue(CompilerContext &ctx) const override;
+    void getInitVal(CompilerContext &ctx, IRValue **ptr, const vector<int> &len, bool is_global = false) const;
 };
@@ -0,0 +1,63 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using namespace std;
+
+// 标识符的句柄，即名字在 Interner 中的编号，从 0 开始连续分配
+// 同一个名字总是得到同一个句柄，之后的比较和哈希只涉及整数
+typedef int Ident;
+
+// 字符串驻留池：词法分析时每个标识符只哈希一次，符号表等都使用句柄
+// 每次编译使用自己的驻留池（见 CompilerContext），lexer 通过 scanner 的 extra 数据访问它
+class Interner
+{
+private:
+    deque<string> names;                    // deque 扩容时不移动已有元素，ids 的键可以直接引用它们
+    unordered_map<string_view, Ident> ids;
+
+public:
+    Ident intern(string_view s)
+    {
+        auto it = ids.find(s);
+        if (it != ids.end())
+            return it->second;
+        Ident id = names.size();
+        names.emplace_back(s);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    const string &name(Ident id) const
+    {
+        return names[id];
+    }
+
+    // 清空后之前的句柄都失效
+    void clear()
+    {
+        ids.clear();
+        names.clear();
+    }
+
+    // 占用的字节数（估计）：名字本身，以及哈希表的结点和桶
+    size_t memoryUsage() const
+    {
+        size_t n = names.size() * sizeof(string) + ids.bucket_count() * sizeof(void *) +
+                   ids.size() * (sizeof(pair<string_view, Ident>) + 2 * sizeof(void *));
+        for (auto &s : names)
+        {
+            if (s.capacity() > 15)  // 短字符串存放在 string 对象内部
+                n += s.capacity() + 1;
+        }
+        return n;
+    }
+
+    // 已分配的句柄数，可以用作按句柄索引的数组的大小
+    int size() const
+    {
+        return names.size();
+    }
+};
@@ -1,10 +1,14 @@
 #pragma once
+#include <algorithm>
 #include <unordered_map>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <queue>
 #include <memory>
+#include "../../middle-end/include/ir.hpp"
+#include "intern.hpp"
 
 using namespace std;
 
@@ -12,37 +16,53 @@ using namespace std;
 class KoopaNameManager
 {
 private:
+    Interner &interner;
     int cnt;
-    unordered_map<string, int> no;      // Sys中的变量名 -> Koopa变量名（后缀）
+    vector<int> var_no;                     // Sys中的变量名（句柄） -> Koopa变量名（后缀），-1 表示还未使用
+    vector<int> global_no;                  // 全局变量命名完成时的 var_no
+    unordered_map<string_view, int> label_no;   // 标号的种类（字面量）-> 后缀
 
 public:
-    KoopaNameManager() : cnt(0) {}
+    KoopaNameManager(Interner &_interner) : interner(_interner), cnt(0) {}
+    // 全局变量都已命名，之后每个函数的局部变量都从这里开始编号
+    void endGlobals() {
+        global_no = var_no;
+    }
+    // 进入新的函数：临时变量、标号和局部变量重新编号
+    // 因此一个函数的 IR 只取决于它自己和全局声明，与前面的函数无关，增量编译时才能复用未修改的函数
     void reset() {
         cnt = 0;
+        var_no = global_no;
+        label_no.clear();
     };
+    // 清空所有编号，开始编译新的程序
+    void clear() {
+        cnt = 0;
+        var_no.clear();
+        global_no.clear();
+        label_no.clear();
+    }
     // 返回临时变量名，如 %0,%1
     string getTmpName() {
         return "%" + to_string(cnt++);
     }
     // 返回Sysy具名变量在Koopa中的变量名，如 @x,@y,重名时后缀加一，@x_1,@y_1
-    string getVarName(const string &s){
+    string getVarName(Ident s){
+        if (s >= (int)var_no.size())
+            var_no.resize(interner.size(), -1);
         // 若是第一次生成就是@s
-        if (!no.count(s))
+        if (var_no[s] < 0)
         {
-            no[s] = 0;
-            return "@" + s;
+            var_no[s] = 0;
+            return "@" + interner.name(s);
         }
         // 后续后缀加一
-        return "@" + s + "_" + to_string(++no[s]);
+        return "@" + interner.name(s) + "_" + to_string(++var_no[s]);
     }
 
-    string getLabelName(const string &s){
-        if (!no.count(s))
-        {
-            no[s] = 1;
-            return "%" + s + "_1";
-        }
-        return "%" + s + "_" + to_string(++no[s]);
+    string getLabelName(string_view s){
+        int n = ++label_no[s];
+        return "%" + string(s) + "_" + to_string(n);
     }
 };
 
@@ -75,7 +95,7 @@ public:
         SysYType *p = this;
         while (p->next != nullptr && (p->ty == SYSY_ARRAY_CONST || p->ty == SYSY_ARRAY))
         {
-            len.push_back(value);
+            len.push_back(p->value);
             p = p->next;
         }
         return;
@@ -86,9 +106,10 @@ public:
 class Symbol
 {
 public:
-    string name;  // KoopaIR中的具名变量，诸如@x_1, @y_1
+    IRValue *ir;        // 变量在 IR中的地址，即 alloc/global alloc（或数组指针参数的副本）
+    IRFunction *func;   // 函数在 IR中的定义或声明
     SysYType *ty;
-    Symbol(const string &_name, SysYType *_t) : name(_name), ty(_t){}
+    Symbol(IRValue *_ir, IRFunction *_func, SysYType *_t) : ir(_ir), func(_func), ty(_t) {}
     ~Symbol()
     {
         if (ty)
@@ -96,40 +117,81 @@ public:
     }
 };
 
-// 符号表
-class SymbolTable
+// 作用域符号表
+// 每个名字（句柄）对应一个栈，栈顶是当前可见的定义，查找只需一次数组访问
+// 每个作用域记录其中定义的名字，退出作用域时将这些名字的栈顶弹出
+class SymbolTableStack
 {
+private:
+    Interner &interner;
+    vector<vector<Symbol *>> shadow;    // ident -> 由外到内的各层定义
+    vector<vector<Ident>> scopes;       // 各层作用域中定义的名字
+    KoopaNameManager nm;
+    size_t live_bytes = 0, peak_bytes = 0;  // 当前可见的符号占用的字节数及其峰值（--mem-report）
+
+    // 一个符号及其类型链、在 shadow 和 scopes 中的一项所占的字节数
+    static size_t symbolBytes(const Symbol *sym)
+    {
+        size_t n = sizeof(Symbol) + sizeof(Symbol *) + sizeof(Ident);
+        for (SysYType *t = sym->ty; t; t = t->next)
+            n += sizeof(SysYType);
+        return n;
+    }
+
+    void insert(Ident ident, Symbol *sym)
+    {
+        if (ident >= (int)shadow.size())
+            shadow.resize(interner.size());
+        shadow[ident].push_back(sym);
+        scopes.back().push_back(ident);
+        live_bytes += symbolBytes(sym);
+        peak_bytes = max(peak_bytes, live_bytes);
+    }
+
 public:
-    unordered_map<string, Symbol *> symbol_tb; // ident -> Symbol *
-    SymbolTable() = default;
-    ~SymbolTable(){
-        for (auto &p : symbol_tb)
+    SymbolTableStack(Interner &_interner) : interner(_interner), nm(_interner) {}
+    SymbolTableStack(const SymbolTableStack &) = delete;
+    SymbolTableStack &operator=(const SymbolTableStack &) = delete;
+    ~SymbolTableStack()
+    {
+        while (scopes.size())
+            quit();
+    }
+
+    void alloc()
+    {
+        scopes.emplace_back();
+    }
+
+    void quit()
+    {
+        for (Ident ident : scopes.back())
         {
-            delete p.second;
+            live_bytes -= symbolBytes(shadow[ident].back());
+            delete shadow[ident].back();
+            shadow[ident].pop_back();
         }
-    };
+        scopes.pop_back();
+    }
 
-    void insertINTCONST(const string &ident, const string &name, int value)
+    // 每次向最内层的作用域中插入，变量在 IR中的名字需事先由 getVarName 生成
+    void insertINT(Ident ident, IRValue *ir)
     {
-        SysYType *ty = new SysYType(SysYType::SYSY_INT_CONST, value);
-        Symbol *sym = new Symbol(name, ty);
-        symbol_tb.insert({ident,sym});
+        insert(ident, new Symbol(ir, nullptr, new SysYType(SysYType::SYSY_INT, 0)));
     }
 
-    void insertINT(const string &ident, const string &name)
+    void insertINTCONST(Ident ident, int value)
     {
-        SysYType *ty = new SysYType(SysYType::SYSY_INT, 0);
-        Symbol *sym = new Symbol(name, ty);
-        symbol_tb.insert({ident, sym});
+        insert(ident, new Symbol(nullptr, nullptr, new SysYType(SysYType::SYSY_INT_CONST, value)));
     }
 
-    void insertFUNC(const string &ident, const string &name, SysYType::TYPE _t){
-        SysYType *ty = new SysYType(_t);
-        Symbol *sym = new Symbol(name, ty);
-        symbol_tb.insert({ident, sym});
+    void insertFUNC(Ident ident, IRFunction *func, SysYType::TYPE _t)
+    {
+        insert(ident, new Symbol(nullptr, func, new SysYType(_t)));
     }
 
-    void insertArray(const string &ident, const string &name, const vector<int> &len, SysYType::TYPE _t){
+    void insertArray(Ident ident, IRValue *ir, const vector<int> &len, SysYType::TYPE _t)
+    {
         SysYType *ty = new SysYType(_t);
         SysYType *p = ty;
         for(int i:len){
@@ -139,116 +201,67 @@ public:
             p = p->next;
         }
         p->ty = (_t == SysYType::SYSY_ARRAY_CONST) ? SysYType::SYSY_INT_CONST : SysYType::SYSY_INT;
-        Symbol *sym = new Symbol(name, ty);
-        symbol_tb.insert({ident, sym});
+        insert(ident, new Symbol(ir, nullptr, ty));
     }
 
-    bool isExists(const string &ident){
-        return symbol_tb.find(ident) != symbol_tb.end();
-    }
-
-    int getValue(const string &ident){
-        return symbol_tb[ident]->ty->value;
-    }
-
-    SysYType* getType(const string &ident)
-    {
-        return symbol_tb[ident]->ty;
-    }
-
-    string getName(const string &ident){
-        return symbol_tb[ident]->name;
-    }
-};
-
-// 符号表栈（不同作用域中定义的符号在不同的栈中）
-class SymbolTableStack
-{
-private:
-    deque<unique_ptr<SymbolTable>> sym_tb_st;
-    KoopaNameManager nm;
-
-public:
-    void alloc()
+    // 当前可见的定义，不存在时返回 nullptr
+    Symbol *lookup(Ident ident)
     {
-        sym_tb_st.emplace_back(new SymbolTable());
+        if (ident >= (int)shadow.size() || shadow[ident].empty())
+            return nullptr;
+        return shadow[ident].back();
     }
 
-    void quit()
+    bool isExists(Ident ident)
     {
-        sym_tb_st.pop_back();
+        return lookup(ident) != nullptr;
     }
 
-    // 每次向栈底的符号表中插入
-    void insertINT(const string &ident)
+    int getValue(Ident ident)
     {
-        string name = nm.getVarName(ident);
-        sym_tb_st.back()->insertINT(ident, name);
+        return lookup(ident)->ty->value;
     }
 
-    void insertINTCONST(const string &ident, int value)
+    SysYType *getType(Ident ident)
     {
-        string name = nm.getVarName(ident);
-        sym_tb_st.back()->insertINTCONST(ident, name, value);
+        return lookup(ident)->ty;
     }
 
-    void insertFUNC(const string &ident, SysYType::TYPE _t)
+    IRValue *getIR(Ident ident)
     {
-        string name = "@" + ident;
-        sym_tb_st.back()->insertFUNC(ident, name, _t);
+        return lookup(ident)->ir;
     }
 
-    void insertArray(const string &ident, const vector<int> &len, SysYType::TYPE _t)
+    IRFunction *getFunc(Ident ident)
     {
-        string name = nm.getVarName(ident);
-        sym_tb_st.back()->insertArray(ident, name, len, _t);
+        return lookup(ident)->func;
     }
 
-    // 从栈底开始往上依次查找
-    bool isExists(const string &ident)
+    // 退出所有作用域并清空命名，开始编译新的程序
+    void clear()
     {
-        for (int i = (int)sym_tb_st.size() - 1; i >= 0; --i)
-        {
-            if (sym_tb_st[i]->isExists(ident))
-                return true;
-        }
-        return false;
+        while (scopes.size())
+            quit();
+        nm.clear();
     }
 
-    int getValue(const string &ident)
+    // 符号表当前和峰值占用的字节数（估计），包括按句柄索引的数组
+    size_t memoryUsage() const
     {
-        int i = (int)sym_tb_st.size() - 1;
-        for (; i >= 0; --i)
-        {
-            if (sym_tb_st[i]->isExists(ident))
-                break;
-        }
-        return sym_tb_st[i]->getValue(ident);
+        return live_bytes + shadow.capacity() * sizeof(vector<Symbol *>);
     }
 
-    SysYType *getType(const string &ident)
+    size_t peakMemoryUsage() const
     {
-        int i = (int)sym_tb_st.size() - 1;
-        for (; i >= 0; --i)
-        {
-            if (sym_tb_st[i]->isExists(ident))
-                break;
-        }
-        return sym_tb_st[i]->getType(ident);
+        return peak_bytes + shadow.capacity() * sizeof(vector<Symbol *>);
     }
 
-    string getName(const string &ident)
+    // 封装KoopaNameManager
+    void endGlobalNames()
     {
-        int i = (int)sym_tb_st.size() - 1;
-        for (; i >= 0; --i)
-        {
-            if (sym_tb_st[i]->isExists(ident))
-                break;
-        }
-        return sym_tb_st[i]->getName(ident);
+        nm.endGlobals();
     }
 
-    // 封装KoopaNameManager
     void resetNameManager()
     {
         nm.reset();
@@ -259,12 +272,12 @@ public:
         return nm.getTmpName();
     }
 
-    string getVarName(const string &ident)
+    string getVarName(Ident ident)
     {
         return nm.getVarName(ident);
     }
 
-    string getLabelName(const string &label_ident)
+    string getLabelName(string_view label_ident)
     {
         return nm.getLabelName(label_ident);
     }
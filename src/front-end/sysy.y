@@ -1,5 +1,4 @@
 %code requires {
-  #include <memory>
   #include <string>
   #include "include/ast.hpp"
 }
@@ -7,30 +6,32 @@
 %{
 
 #include <iostream>
-#include <memory>
 #include <string>
 #include <cstring>
 #include "include/ast.hpp"
 
 using namespace std;
 
-// 声明 lexer 函数和错误处理函数
-int yylex();
-void yyerror(unique_ptr<BaseAST> &ast, const char *s);
-
-
 %}
 
-// 定义 parser 函数和错误处理函数的附加参数
-%parse-param { unique_ptr<BaseAST> &ast }
+// 纯（可重入）parser，不使用全局的 yylval 等变量
+// scanner 为 flex 的 yyscan_t，传给 lexer；AST 节点都分配在 arena 中；语法错误的描述写入 error
+%define api.pure full
+%lex-param { void *scanner }
+%parse-param { void *scanner } { BaseAST *&ast } { Arena &arena } { string &error }
+
+%code {
+// 声明 lexer 函数和错误处理函数，%code 中的内容位于 YYSTYPE 的定义之后
+int yylex(YYSTYPE *yylval, void *scanner);
+void yyerror(void *scanner, BaseAST *&ast, Arena &arena, string &error, const char *s);
+}
 
 // yylval 的定义, 我们把它定义成了一个联合体 (union)
-// 因为 token 的值有的是字符串指针, 有的是整数
-// 之前我们在 lexer 中用到的 str_val 和 int_val 就是在这里被定义的
-// 至于为什么要用字符串指针而不直接用 string 或者 unique_ptr<string>?
-// 请自行 STFW 在 union 里写一个带析构函数的类会出现什么情况
+// 因为 token 的值有的是标识符句柄, 有的是整数
+// 之前我们在 lexer 中用到的 ident_val 和 int_val 就是在这里被定义的
+// 标识符由 lexer 驻留到本次编译的 interner 中，之后只传递句柄
 %union {
-  string *str_val;
+  Ident ident_val;
   int int_val;
   BaseAST *ast_val;
   ExpAST *exp_val;
@@ -55,9 +56,9 @@ void yyerror(unique_ptr<BaseAST> &ast, const char *s);
 %nonassoc ELSE
 
 // lexer 返回的所有 token 种类的声明
-// 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 str_val 和 int_val
+// 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 ident_val 和 int_val
 %token INT VOID RETURN LESS_EQ GREAT_EQ EQUAL NOT_EQUAL AND OR CONST IF WHILE BREAK CONTINUE
-%token <str_val> IDENT
+%token <ident_val> IDENT
 %token <int_val> INT_CONST
 
 // 非终结符的类型定义
@@ -76,8 +77,7 @@ void yyerror(unique_ptr<BaseAST> &ast, const char *s);
 %type <unary_exps> FuncRParams
 %type <func_type> BType
 %type <func_f_param> FuncFParam FuncFParamExpList
-%type <int_val> Number
-%type <str_val>  UnaryOp
+%type <int_val> Number UnaryOp
 %type <lval> LVal ExpList
 
 %%
@@ -85,46 +85,46 @@ void yyerror(unique_ptr<BaseAST> &ast, const char *s);
 // 开始符, CompUnit ::= FuncDef, 大括号后声明了解析完成后 parser 要做的事情
 CompUnit
   : DeclOrFuncDefList {
-    ast = unique_ptr<CompUnitAST>($1);
+    ast = $1;
   }
   ;
 
 DeclOrFuncDefList
   : DeclOrFuncDefList FuncDef{
     auto ast = $1;
-    ast->func_defs.emplace_back(unique_ptr<BaseAST>($2));
+    ast->func_defs.push_back(arena, $2);
     $$ = ast;
   }
   | DeclOrFuncDefList Decl{
     auto ast = $1;
-    ast->decls.emplace_back(unique_ptr<DefAST>($2));
+    ast->decls.push_back(arena, $2);
     $$ = ast;
   }
   | FuncDef {
-    auto ast = new CompUnitAST();
-    ast->func_defs.emplace_back(unique_ptr<BaseAST>($1));
+    auto ast = arena.make<CompUnitAST>();
+    ast->func_defs.push_back(arena, $1);
     $$ = ast;
   }
   | Decl {
-    auto ast = new CompUnitAST();
-    ast->decls.emplace_back(unique_ptr<DefAST>($1));
+    auto ast = arena.make<CompUnitAST>();
+    ast->decls.push_back(arena, $1);
     $$ = ast;
   }
   ;
 
 FuncDef
   : BType IDENT '(' ')' Block {
-    auto ast = new FuncDefAST();
-    ast->func_type = unique_ptr<BTypeAST>($1);
-    ast->ident = *unique_ptr<string>($2);
-    ast->block = unique_ptr<BaseAST>($5);
+    auto ast = arena.make<FuncDefAST>();
+    ast->func_type = $1;
+    ast->ident = $2;
+    ast->block = $5;
     $$ = ast;
   }
   | BType IDENT '(' FuncFParams ')' Block {
     auto ast = $4;
-    ast->func_type = unique_ptr<BTypeAST>($1);
-    ast->ident = *unique_ptr<string>($2);
-    ast->block = unique_ptr<BaseAST>($6);
+    ast->func_type = $1;
+    ast->ident = $2;
+    ast->block = $6;
     $$ = ast;
   }
   ;
@@ -132,29 +132,29 @@ FuncDef
 FuncFParams
   : FuncFParams ',' FuncFParam {
     auto ast = $1;
-    ast->func_f_params.emplace_back(unique_ptr<FuncFParamAST>($3));
+    ast->func_f_params.push_back(arena, $3);
     $$ = ast;
   }
   | FuncFParam {
-    auto ast = new FuncDefAST();
-    ast->func_f_params.emplace_back(unique_ptr<FuncFParamAST>($1));
+    auto ast = arena.make<FuncDefAST>();
+    ast->func_f_params.push_back(arena, $1);
     $$ = ast;
   }
   ;
 
 FuncFParam
   : BType IDENT {
-    auto ast = new FuncFParamAST();
+    auto ast = arena.make<FuncFParamAST>();
     ast->tag = FuncFParamAST::VARIABLE;
-    ast->btype = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->btype = $1;
+    ast->ident = $2;
     $$ = ast;
     } 
     | BType IDENT '[' ']' FuncFParamExpList{
     auto ast = $5;
     ast->tag = FuncFParamAST::ARRAY;
-    ast->btype = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->btype = $1;
+    ast->ident = $2;
     $$ = ast;
   } 
   ;
@@ -162,23 +162,23 @@ FuncFParam
 FuncFParamExpList
   : FuncFParamExpList '[' ConstExp ']' {
     auto ast = $1;
-    ast->const_exps.emplace_back(unique_ptr<ExpAST>($3));
+    ast->const_exps.push_back(arena, $3);
     $$ = ast;
   }
   | {
-    auto ast = new FuncFParamAST();
+    auto ast = arena.make<FuncFParamAST>();
     $$ = ast;
   }
   ;
 
 BType
   : INT {
-    auto ast = new BTypeAST();
+    auto ast = arena.make<BTypeAST>();
     ast->tag = BTypeAST::INT;
     $$ = ast;
   }
   | VOID {
-    auto ast = new BTypeAST();
+    auto ast = arena.make<BTypeAST>();
     ast->tag = BTypeAST::VOID;
     $$ = ast;
   }
@@ -193,41 +193,41 @@ Block
 BlockItemList
   : BlockItemList BlockItem {
     auto ast = $1;
-    ast->block_items.emplace_back(unique_ptr<BaseAST>($2));
+    ast->block_items.push_back(arena, $2);
     $$ = ast;
   }
   | {
-    auto ast = new BlockAST();
+    auto ast = arena.make<BlockAST>();
     $$ = ast;
   }
   ;
 
 BlockItem
   : Decl {
-    auto ast = new BlockItemAST();
-    ast->decl = unique_ptr<DefAST>($1);
+    auto ast = arena.make<BlockItemAST>();
+    ast->decl = $1;
     ast->stmt = nullptr;
     $$ = ast;
   }
   | Stmt {
-    auto ast = new BlockItemAST();
+    auto ast = arena.make<BlockItemAST>();
     ast->decl = nullptr;
-    ast->stmt = unique_ptr<BaseAST>($1);
+    ast->stmt = $1;
     $$ = ast;
   }
   ;
 
 Decl
   : ConstDecl {
-    auto ast = new DeclAST();
-    ast->const_decl = unique_ptr<DefAST>($1);
+    auto ast = arena.make<DeclAST>();
+    ast->const_decl = $1;
     ast->var_decl = nullptr;
     $$ = ast;
   }
   | VarDecl {
-    auto ast = new DeclAST();
+    auto ast = arena.make<DeclAST>();
     ast->const_decl = nullptr;
-    ast->var_decl = unique_ptr<DefAST>($1);
+    ast->var_decl = $1;
     $$ = ast;
   }
   ;
@@ -235,7 +235,7 @@ Decl
 ConstDecl
   : CONST BType ConstDefList ';' {
     auto ast = $3;
-    ast->btype = unique_ptr<BaseAST>($2);
+    ast->btype = $2;
     $$ = ast;
   }
   ;
@@ -243,12 +243,12 @@ ConstDecl
 ConstDefList
   : ConstDefList ',' ConstDef {
     auto ast = $1;
-    ast->const_defs.emplace_back(unique_ptr<DefAST>($3));
+    ast->const_defs.push_back(arena, $3);
     $$ = ast;
   }
   | ConstDef {
-    auto ast = new ConstDeclAST();
-    ast->const_defs.emplace_back(unique_ptr<DefAST>($1));
+    auto ast = arena.make<ConstDeclAST>();
+    ast->const_defs.push_back(arena, $1);
     $$ = ast;
   }
   ;
@@ -256,8 +256,8 @@ ConstDefList
 ConstDef
   : IDENT ConstDefExpList '=' ConstInitVal {
     auto ast = $2;
-    ast->ident = *unique_ptr<string>($1);
-    ast->const_init_val = unique_ptr<ConstInitValAST>($4);
+    ast->ident = $1;
+    ast->const_init_val = $4;
     $$ = ast;
   }
   ;
@@ -265,11 +265,11 @@ ConstDef
 ConstDefExpList
   : ConstDefExpList '[' ConstExp ']' {
     auto ast = $1;
-    ast->const_exps.emplace_back(unique_ptr<ExpAST>($3));
+    ast->const_exps.push_back(arena, $3);
     $$ = ast;
   }
   | {
-    auto ast = new ConstDefAST();
+    auto ast = arena.make<ConstDefAST>();
     $$ = ast;
   }
   ;
@@ -277,7 +277,7 @@ ConstDefExpList
 VarDecl
   : BType VarDefList ';' {
     auto ast = $2;
-    ast->btype = unique_ptr<BaseAST>($1);
+    ast->btype = $1;
     $$ = ast;
   }
   ;
@@ -285,12 +285,12 @@ VarDecl
 VarDefList
   : VarDefList ',' VarDef {
     auto ast = $1;
-    ast->var_defs.emplace_back(unique_ptr<DefAST>($3));
+    ast->var_defs.push_back(arena, $3);
     $$ = ast;
   }
   | VarDef {
-    auto ast = new VarDeclAST();
-    ast->var_defs.emplace_back(unique_ptr<DefAST>($1));
+    auto ast = arena.make<VarDeclAST>();
+    ast->var_defs.push_back(arena, $1);
     $$ = ast;
   }
   ;
@@ -298,14 +298,14 @@ VarDefList
 VarDef
   : IDENT VarDefExpList {
     auto ast = $2;
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     ast->init_val = nullptr;
     $$ = ast;
   }
   | IDENT VarDefExpList '=' InitVal {
     auto ast = $2;
-    ast->ident = *unique_ptr<string>($1);
-    ast->init_val = unique_ptr<InitValAST>($4);
+    ast->ident = $1;
+    ast->init_val = $4;
     $$ = ast;
   }
   ;
@@ -313,85 +313,85 @@ VarDef
 VarDefExpList
   : VarDefExpList '[' ConstExp ']' {
     auto ast = $1;
-    ast->const_exps.emplace_back(unique_ptr<ExpAST>($3));
+    ast->const_exps.push_back(arena, $3);
     $$ = ast;
   }
   | {
-    auto ast = new VarDefAST();
+    auto ast = arena.make<VarDefAST>();
     $$ = ast;
   }
   ;
 
 Stmt
   : IF '(' Exp ')' Stmt %prec LOWER_THEN_ELSE {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::IF;
-    ast->exp = unique_ptr<ExpAST>($3);
-    ast->if_stmt = unique_ptr<BaseAST>($5);
+    ast->exp = $3;
+    ast->if_stmt = $5;
     ast->else_stmt = nullptr;
     $$ = ast;
   }
   | IF '(' Exp ')' Stmt ELSE Stmt {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::IF;
-    ast->exp = unique_ptr<ExpAST>($3);
-    ast->if_stmt = unique_ptr<BaseAST>($5);
-    ast->else_stmt = unique_ptr<BaseAST>($7);
+    ast->exp = $3;
+    ast->if_stmt = $5;
+    ast->else_stmt = $7;
     $$ = ast;
   }
   | LVal '=' Exp ';' {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::ASSIGN;
-    ast->lval = unique_ptr<LValAST>($1);
-    ast->exp = unique_ptr<ExpAST>($3);
+    ast->lval = $1;
+    ast->exp = $3;
     $$ = ast;
   }
   | Exp ';' {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::EXP;
-    ast->exp = unique_ptr<ExpAST>($1);
+    ast->exp = $1;
     $$ = ast;
   }
   | ';' {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::EXP;
     ast->exp = nullptr;
     $$ = ast;
   }
   | Block {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::BLOCK;
-    ast->block = unique_ptr<BaseAST>($1);
+    ast->block = $1;
     $$ = ast;
   }
   | RETURN Exp ';' {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::RETURN;
     ast->lval = nullptr;
-    ast->exp = unique_ptr<ExpAST>($2);
+    ast->exp = $2;
     $$ = ast;
   }
   | RETURN ';' {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::RETURN;
     ast->lval = nullptr;
     ast->exp = nullptr;
     $$ = ast;
   }
   | WHILE '(' Exp ')' Stmt {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::WHILE;
-    ast->exp = unique_ptr<ExpAST>($3);
-    ast->stmt = unique_ptr<BaseAST>($5);
+    ast->exp = $3;
+    ast->stmt = $5;
     $$ = ast;
   }
   | BREAK ';' {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::BREAK;
     $$ = ast;
   }
   | CONTINUE ';' {
-    auto ast = new StmtAST();
+    auto ast = arena.make<StmtAST>();
     ast->tag = StmtAST::CONTINUE;
     $$ = ast;
   }
@@ -400,7 +400,7 @@ Stmt
 LVal
   : IDENT ExpList{
     auto ast = $2;
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     $$ = ast;
   }
   ;
@@ -408,11 +408,11 @@ LVal
 ExpList
   : ExpList '[' Exp ']' {
     auto ast = $1;
-    ast->exps.emplace_back(unique_ptr<ExpAST>($3));
+    ast->exps.push_back(arena, $3);
     $$ = ast;
   }
   | {
-    auto ast = new LValAST();
+    auto ast = arena.make<LValAST>();
     $$ = ast;
   }
   ;
@@ -425,22 +425,16 @@ Exp
 
 PrimaryExp
   : '(' Exp ')'{
-    auto ast = new PrimaryExpAST();
-    ast->exp = unique_ptr<ExpAST>($2); //表示该PrimaryExp为 (Exp)
-    ast->lval = nullptr;
-    $$ = ast;
+    $$ = $2;
   }
   | LVal {
-    auto ast = new PrimaryExpAST();
-    ast->exp = nullptr;
-    ast->lval = unique_ptr<LValAST>($1); //表示该PrimaryExp为 LVal
+    auto ast = arena.make<PrimaryExpAST>();
+    ast->lval = $1; //表示该PrimaryExp为 LVal
     $$ = ast;
   }
   | Number { 
-    auto ast = new PrimaryExpAST();
-    ast->number = $1;
-    ast->exp = nullptr;                //表示该PrimaryExp为Number
-    ast->lval = nullptr;
+    auto ast = arena.make<PrimaryExpAST>();
+    ast->number = $1;                  //表示该PrimaryExp为Number
     $$ = ast;
   }
   ;
@@ -451,32 +445,25 @@ Number
   }
   ;
 
+// 只有一个子节点的产生式直接返回子节点，不再为每一层优先级单独建立节点
 UnaryExp
   : PrimaryExp{ 
-      auto ast = new UnaryExpAST();
-      ast->primary_exp = unique_ptr<ExpAST>($1);
-      ast->unary_exp = nullptr;          //表示该 UnaryExp为 PrimaryExp
-      $$ = ast;
+      $$ = $1;
   }
   | UnaryOp UnaryExp{
-      auto ast = new UnaryExpAST();
-      ast->unary_op = *unique_ptr<string>($1);
-      ast->unary_exp = unique_ptr<ExpAST>($2); //表示该UnaryExp为 OP+Exp
-      ast->primary_exp = nullptr;  
+      auto ast = arena.make<UnaryExpAST>();
+      ast->unary_op = $1;
+      ast->unary_exp = $2; //表示该UnaryExp为 OP+Exp
       $$ = ast;
   }
   | IDENT '(' ')' {
-      auto ast = new UnaryExpAST();
-      ast->ident = *unique_ptr<string>($1);
-      ast->unary_exp = nullptr; 
-      ast->primary_exp = nullptr;  
+      auto ast = arena.make<UnaryExpAST>();
+      ast->ident = $1;
       $$ = ast;
   }
   | IDENT '(' FuncRParams ')' {
       auto ast = $3;
-      ast->ident = *unique_ptr<string>($1);
-      ast->unary_exp = nullptr; 
-      ast->primary_exp = nullptr; 
+      ast->ident = $1;
       $$ = ast;
   }
   ;
@@ -484,180 +471,155 @@ UnaryExp
 FuncRParams
   : FuncRParams ',' Exp {
     auto ast = $1;
-    ast->exps.emplace_back(unique_ptr<ExpAST>($3));
+    ast->exps.push_back(arena, $3);
     $$ = ast;
   }
   | Exp {
-    auto ast = new UnaryExpAST();
-    ast->exps.emplace_back(unique_ptr<ExpAST>($1));
+    auto ast = arena.make<UnaryExpAST>();
+    ast->exps.push_back(arena, $1);
     $$ = ast;
   }
   ;
 
 UnaryOp
-  : '+'{ $$ = new string("+"); }
-  | '-'{ $$ = new string("-"); }
-  | '!'{ $$ = new string("!"); }
+  : '+'{ $$ = '+'; }
+  | '-'{ $$ = '-'; }
+  | '!'{ $$ = '!'; }
   ;
 
 MulExp
-  : UnaryExp{
-    auto ast = new MulExpAST();
-    ast->unary_exp = unique_ptr<ExpAST>($1);
-    $$ = ast;
+  : UnaryExp {
+    $$ = $1;
   }
-  | MulExp '*' UnaryExp{
-    auto ast = new MulExpAST();
-    ast->unary_exp = nullptr;
-    ast->mul_exp_1 = unique_ptr<ExpAST>($1);
-    ast->unary_exp_2 = unique_ptr<ExpAST>($3);
-    ast->mul_op = "*";
+  | MulExp '*' UnaryExp {
+    auto ast = arena.make<MulExpAST>();
+    ast->mul_exp_1 = $1;
+    ast->unary_exp_2 = $3;
+    ast->op = IRValue::MUL;
     $$ = ast;
   }
-  | MulExp '/' UnaryExp{
-    auto ast = new MulExpAST();
-    ast->unary_exp = nullptr;
-    ast->mul_exp_1 = unique_ptr<ExpAST>($1);
-    ast->unary_exp_2 = unique_ptr<ExpAST>($3);
-    ast->mul_op = "/";
+  | MulExp '/' UnaryExp {
+    auto ast = arena.make<MulExpAST>();
+    ast->mul_exp_1 = $1;
+    ast->unary_exp_2 = $3;
+    ast->op = IRValue::DIV;
     $$ = ast;
   }
-  | MulExp '%' UnaryExp{
-    auto ast = new MulExpAST();
-    ast->unary_exp = nullptr;
-    ast->mul_exp_1 = unique_ptr<ExpAST>($1);
-    ast->unary_exp_2 = unique_ptr<ExpAST>($3);
-    ast->mul_op = "%";
+  | MulExp '%' UnaryExp {
+    auto ast = arena.make<MulExpAST>();
+    ast->mul_exp_1 = $1;
+    ast->unary_exp_2 = $3;
+    ast->op = IRValue::MOD;
     $$ = ast;
   }
   ;
 
-AddExp 
+AddExp
   : MulExp {
-    auto ast = new AddExpAST();
-    ast->mul_exp = unique_ptr<ExpAST>($1);
-    $$ = ast;
+    $$ = $1;
   }
   | AddExp '+' MulExp {
-    auto ast = new AddExpAST();
-    ast->mul_exp = nullptr;
-    ast->add_exp_1 = unique_ptr<ExpAST>($1);
-    ast->mul_exp_2 = unique_ptr<ExpAST>($3);
-    ast->add_op = "+";
+    auto ast = arena.make<AddExpAST>();
+    ast->add_exp_1 = $1;
+    ast->mul_exp_2 = $3;
+    ast->op = IRValue::ADD;
     $$ = ast;
   }
   | AddExp '-' MulExp {
-    auto ast = new AddExpAST();
-    ast->mul_exp = nullptr;
-    ast->add_exp_1 = unique_ptr<ExpAST>($1);
-    ast->mul_exp_2 = unique_ptr<ExpAST>($3);
-    ast->add_op = "-";
+    auto ast = arena.make<AddExpAST>();
+    ast->add_exp_1 = $1;
+    ast->mul_exp_2 = $3;
+    ast->op = IRValue::SUB;
     $$ = ast;
   }
   ;
 
 RelExp
-  : AddExp{
-    auto ast = new RelExpAST();
-    ast->add_exp = unique_ptr<ExpAST>($1);
-    $$ = ast;
+  : AddExp {
+    $$ = $1;
   }
-  | RelExp '<' AddExp{
-    auto ast = new RelExpAST();
-    ast->add_exp = nullptr;
-    ast->rel_exp_1 = unique_ptr<ExpAST>($1);
-    ast->add_exp_2 = unique_ptr<ExpAST>($3);
-    ast->rel_op = "<";
+  | RelExp '<' AddExp {
+    auto ast = arena.make<RelExpAST>();
+    ast->rel_exp_1 = $1;
+    ast->add_exp_2 = $3;
+    ast->op = IRValue::LT;
     $$ = ast;
   }
-  | RelExp '>' AddExp{
-    auto ast = new RelExpAST();
-    ast->add_exp = nullptr;
-    ast->rel_exp_1 = unique_ptr<ExpAST>($1);
-    ast->add_exp_2 = unique_ptr<ExpAST>($3);
-    ast->rel_op = ">";
+  | RelExp '>' AddExp {
+    auto ast = arena.make<RelExpAST>();
+    ast->rel_exp_1 = $1;
+    ast->add_exp_2 = $3;
+    ast->op = IRValue::GT;
     $$ = ast;
   }
-  | RelExp LESS_EQ AddExp{
-    auto ast = new RelExpAST();
-    ast->add_exp = nullptr;
-    ast->rel_exp_1 = unique_ptr<ExpAST>($1);
-    ast->add_exp_2 = unique_ptr<ExpAST>($3);
-    ast->rel_op = "<=";
+  | RelExp LESS_EQ AddExp {
+    auto ast = arena.make<RelExpAST>();
+    ast->rel_exp_1 = $1;
+    ast->add_exp_2 = $3;
+    ast->op = IRValue::LE;
     $$ = ast;
   }
-  | RelExp GREAT_EQ AddExp{
-    auto ast = new RelExpAST();
-    ast->add_exp = nullptr;
-    ast->rel_exp_1 = unique_ptr<ExpAST>($1);
-    ast->add_exp_2 = unique_ptr<ExpAST>($3);
-    ast->rel_op = ">=";
+  | RelExp GREAT_EQ AddExp {
+    auto ast = arena.make<RelExpAST>();
+    ast->rel_exp_1 = $1;
+    ast->add_exp_2 = $3;
+    ast->op = IRValue::GE;
     $$ = ast;
   }
   ;
 
-EqExp 
+EqExp
   : RelExp {
-    auto ast = new EqExpAST();
-    ast->rel_exp = unique_ptr<ExpAST>($1);
-    $$ = ast;
+    $$ = $1;
   }
   | EqExp EQUAL RelExp {
-    auto ast = new EqExpAST();
-    ast->rel_exp = nullptr;
-    ast->eq_exp_1 = unique_ptr<ExpAST>($1);
-    ast->rel_exp_2 = unique_ptr<ExpAST>($3);
-    ast->eq_op = "==";
+    auto ast = arena.make<EqExpAST>();
+    ast->eq_exp_1 = $1;
+    ast->rel_exp_2 = $3;
+    ast->op = IRValue::EQ;
     $$ = ast;
   }
   | EqExp NOT_EQUAL RelExp {
-    auto ast = new EqExpAST();
-    ast->rel_exp = nullptr;
-    ast->eq_exp_1 = unique_ptr<ExpAST>($1);
-    ast->rel_exp_2 = unique_ptr<ExpAST>($3);
-    ast->eq_op = "!=";
+    auto ast = arena.make<EqExpAST>();
+    ast->eq_exp_1 = $1;
+    ast->rel_exp_2 = $3;
+    ast->op = IRValue::NOT_EQ;
     $$ = ast;
   }
   ;
 
-LAndExp 
+LAndExp
   : EqExp {
-    auto ast = new LAndExpAST();
-    ast->eq_exp = unique_ptr<ExpAST>($1);
-    $$ = ast;
+    $$ = $1;
   }
   | LAndExp AND EqExp {
-    auto ast = new LAndExpAST();
-    ast->eq_exp = nullptr;
-    ast->l_and_exp_1 = unique_ptr<ExpAST>($1);
-    ast->eq_exp_2 = unique_ptr<ExpAST>($3);
+    auto ast = arena.make<LAndExpAST>();
+    ast->l_and_exp_1 = $1;
+    ast->eq_exp_2 = $3;
     $$ = ast;
   }
   ;
 
-LOrExp 
+LOrExp
   : LAndExp {
-    auto ast = new LOrExpAST();
-    ast->l_and_exp = unique_ptr<ExpAST>($1);
-    $$ = ast;
+    $$ = $1;
   }
   | LOrExp OR LAndExp {
-    auto ast = new LOrExpAST();
-    ast->l_and_exp = nullptr;
-    ast->l_or_exp_1 = unique_ptr<ExpAST>($1);
-    ast->l_and_exp_2 = unique_ptr<ExpAST>($3);
+    auto ast = arena.make<LOrExpAST>();
+    ast->l_or_exp_1 = $1;
+    ast->l_and_exp_2 = $3;
     $$ = ast;
   }
   ;
 
 InitVal
   : Exp {
-    auto ast = new InitValAST();
-    ast->exp = unique_ptr<ExpAST>($1);
+    auto ast = arena.make<InitValAST>();
+    ast->exp = $1;
     $$ = ast;
   }
   | '{' '}' {
-    auto ast = new InitValAST();
+    auto ast = arena.make<InitValAST>();
     ast->exp = nullptr;
     $$ = ast;
   } 
@@ -669,24 +631,24 @@ InitVal
 InitValList
   : InitValList ',' InitVal {
     auto ast = $1;
-    ast->inits.emplace_back(unique_ptr<InitValAST>($3));
+    ast->inits.push_back(arena, $3);
     $$ = ast;
   }
   | InitVal {
-    auto ast = new InitValAST();
-    ast->inits.emplace_back(unique_ptr<InitValAST>($1));
+    auto ast = arena.make<InitValAST>();
+    ast->inits.push_back(arena, $1);
     $$ = ast;
   }
   ;
 
 ConstInitVal
   : ConstExp {
-    auto ast = new ConstInitValAST();
-    ast->const_exp = unique_ptr<ExpAST>($1);
+    auto ast = arena.make<ConstInitValAST>();
+    ast->const_exp = $1;
     $$ = ast;
   }
   | '{' '}' {
-    auto ast = new ConstInitValAST();
+    auto ast = arena.make<ConstInitValAST>();
     ast->const_exp = nullptr;
     $$ = ast;
   } 
@@ -697,8 +659,8 @@ ConstInitVal
 
 ConstExp
   : Exp {
-    auto ast = new ConstExpAST();
-    ast->exp = unique_ptr<ExpAST>($1);
+    auto ast = arena.make<ConstExpAST>();
+    ast->exp = $1;
     $$ = ast;
   }
   ;
@@ -706,22 +668,23 @@ ConstExp
 ConstInitValList
   : ConstInitValList ',' ConstInitVal {
     auto ast = $1;
-    ast->inits.emplace_back(unique_ptr<ConstInitValAST>($3));
+    ast->inits.push_back(arena, $3);
     $$ = ast;
   }
   | ConstInitVal {
-    auto ast = new ConstInitValAST();
-    ast->inits.emplace_back(unique_ptr<ConstInitValAST>($1));
+    auto ast = arena.make<ConstInitValAST>();
+    ast->inits.push_back(arena, $1);
     $$ = ast;
   }
   ;
 
 %%
 
-// 定义错误处理函数, 其中第二个参数是错误信息
+// 定义错误处理函数, 其中最后一个参数是错误信息
 // parser 如果发生错误 (例如输入的程序出现了语法错误), 就会调用这个函数
-void yyerror(unique_ptr<BaseAST> &ast, const char *s) {
-    extern int yylineno;    // defined and maintained in lex
-    extern char *yytext;    // defined and maintained in lex
-    fprintf(stderr, "ERROR: %s at symbol '%s' on line %d\n", s, yytext, yylineno);
+// 错误不直接打印，而是记录在 error 中，由调用者决定如何报告
+void yyerror(void *scanner, BaseAST *&ast, Arena &arena, string &error, const char *s) {
+    extern int yyget_lineno(void *scanner);   // defined and maintained in lex
+    extern char *yyget_text(void *scanner);   // defined and maintained in lex
+    error = string(s) + " at symbol '" + yyget_text(scanner) + "' on line " + to_string(yyget_lineno(scanner));
 }
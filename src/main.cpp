@@ -1,92 +1,104 @@
 #include <cassert>
-#include <cstdio>
-#include <iostream>
-#include <fstream>
+#include <cstdlib>
 #include <memory>
 #include <string>
-#include "koopa.h"
-#include "front-end/include/ast.hpp"
-#include "util.hpp"
+#include "cache.hpp"
+#include "context.hpp"
+#include "memreport.hpp"
+#include "driver.hpp"
+#include "threadpool.hpp"
+#include "timer.hpp"
 
 using namespace std;
 
-extern FILE *yyin;
-extern KoopaString ks;          // 封装了一个生成 KoopaIR的类
-extern RiscvString rvs;         // 封装了一个生成 riscvStr的类
-extern int yyparse(unique_ptr<BaseAST> &ast);
-extern void yyset_lineno(int _line_number);
-extern int yylex_destroy();
-
-extern void Visit(const koopa_raw_program_t &program);
-
-// 向文件中写数据
-void write_file(string file_name, string file_content)
-{
-  ofstream os;                  // 创建一个文件输出流对象
-  os.open(file_name, ios::out); // 将对象与文件关联
-  os << file_content;           // 将输入的内容放入txt文件中
-  os.close();
-  return;
-}
-
 int main(int argc, const char *argv[])
 {
+  // 批量编译多个文件，见 driver.hpp
+  if (argc >= 2 && string(argv[1]) == "-batch")
+    return RunBatch(argc, argv);
+  // 常驻的编译服务器，见 driver.hpp
+  if (argc >= 2 && string(argv[1]) == "--server")
+    return RunServer(argc, argv);
+
   // 解析命令行参数. 测试脚本/评测平台要求你的编译器能接收如下参数:
-  // compiler 模式 输入文件 -o 输出文件
-  assert(argc == 5);
+  // compiler 模式 输入文件 -o 输出文件 [-O优化等级] [-echo] [-j线程数] [-cache 缓存目录] [-cache-max 容量MB]
+  //          [-ftime-report[=json]] [--mem-report[=json]]
+  assert(argc >= 5);
   auto mode = argv[1];
   auto input = argv[2];
   auto output = argv[4];
-
-  // 打开输入文件, 并且指定 lexer 在解析的时候读取这个文件
-  yyin = fopen(input, "r");
-  assert(yyin);
-
-  // parse input file
-  yyset_lineno(1);
-  unique_ptr<BaseAST> ast;
-  auto parse_ret = yyparse(ast);
-  yylex_destroy();
-  assert(!parse_ret);
-
-  // 遍历 AST的同时生成字符串形式的 KoopaIR
-  ast->Dump();
-  string ir_str = ks.getKoopaIR();
-
-  // 将字符串形式的IR转化为内存中存储的IR,即下面的 raw
-  const char *str = ir_str.c_str();
-  // 解析字符串 str, 得到 Koopa IR 程序
-  koopa_program_t program;
-  koopa_error_code_t convert_ret = koopa_parse_from_string(str, &program);
-  assert(convert_ret == KOOPA_EC_SUCCESS); // 确保解析时没有出错
-  // 创建一个 raw program builder, 用来构建 raw program
-  koopa_raw_program_builder_t builder = koopa_new_raw_program_builder();
-  // 将 Koopa IR 程序转换为 raw program
-  koopa_raw_program_t raw = koopa_build_raw_program(builder, program);
-  // 释放 Koopa IR 程序占用的内存
-  koopa_delete_program(program);
-
-  // TODO: 处理 raw program,开优化
-
-  if (string(mode) == "-koopa")
+  // 本次编译的全部状态
+  CompilerContext ctx;
+  bool echo = false;            // 是否同时把输出打印到标准输出，便于调试
+  int n_threads = 1;            // 大于 1 时各函数并行优化和生成代码
+  string cache_dir;             // 非空时使用该目录中的编译缓存
+  long cache_max = CompileCache::DEFAULT_MAX_BYTES;
+  string time_report;           // 非空时在标准错误输出各阶段的耗时，"table" 或 "json"
+  string mem_report;            // 非空时在标准错误输出各类数据占用的内存，"table" 或 "json"
+  for (int i = 5; i < argc; i++)
   {
-    // 将 Koopa IR 程序输出到stdout中
-    koopa_generate_raw_to_koopa(&raw, &program);
-    koopa_dump_to_stdout(program);
-    koopa_delete_program(program);
-    write_file(output, ir_str);
+    if (string(argv[i]).substr(0, 2) == "-O")
+      ctx.opt_level = atoi(argv[i] + 2);
+    else if (string(argv[i]) == "-echo")
+      echo = true;
+    else if (string(argv[i]).substr(0, 2) == "-j")
+      n_threads = atoi(argv[i] + 2);
+    else if (string(argv[i]) == "-cache" && i + 1 < argc)
+      cache_dir = argv[++i];
+    else if (string(argv[i]) == "-cache-max" && i + 1 < argc)
+      cache_max = atol(argv[++i]) * 1024 * 1024;
+    else if (string(argv[i]) == "-ftime-report")
+      time_report = "table";
+    else if (string(argv[i]) == "-ftime-report=json")
+      time_report = "json";
+    else if (string(argv[i]) == "--mem-report")
+      mem_report = "table";
+    else if (string(argv[i]) == "--mem-report=json")
+      mem_report = "json";
   }
-  else if(string(mode) == "-riscv"){
-    Visit(raw);
-    string riscvstr = rvs.getRiscvStr();
-    cout << riscvstr << endl;
-    write_file(output, riscvstr);
+  unique_ptr<ThreadPool> pool;
+  if (n_threads > 1)
+  {
+    pool.reset(new ThreadPool(n_threads - 1));
+    ctx.pool = pool.get();
+  }
+  unique_ptr<CompileCache> cache;
+  if (!cache_dir.empty())
+  {
+    cache.reset(new CompileCache(cache_dir, cache_max));
+    ctx.cache = cache.get();
   }
 
-  // 处理完成, 释放 raw program builder 占用的内存
-  // 注意, raw program 中所有的指针指向的内存均为 raw program builder 的内存
-  // 所以不要在 raw program 处理完毕之前释放 builder
-  koopa_delete_raw_program_builder(builder);
+  unique_ptr<TimeReport> timer;
+  if (!time_report.empty())
+  {
+    timer.reset(new TimeReport);
+    ctx.timer = timer.get();
+  }
+  unique_ptr<MemReport> mem;
+  if (!mem_report.empty())
+  {
+    mem.reset(new MemReport);
+    ctx.mem = mem.get();
+  }
 
-  return 0;
+  // -interp 解释执行 IR，-sim 在模拟器上运行汇编，输出文件为剖析报告，退出码与运行编译出的程序时一样是 main 的返回值
+  int status;
+  if (string(mode) == "-interp" || string(mode) == "-sim")
+  {
+    int ret = 0;
+    bool ok = string(mode) == "-interp" ? InterpretFile(ctx, input, output, ret) : SimulateFile(ctx, input, output, ret);
+    status = ok ? ret & 0xff : 1;
+  }
+  else
+    status = CompileFile(ctx, mode, input, output, echo) ? 0 : 1;
+  if (time_report == "table")
+    timer->print(stderr);
+  else if (time_report == "json")
+    timer->printJSON(stderr);
+  if (mem_report == "table")
+    mem->print(stderr);
+  else if (mem_report == "json")
+    mem->printJSON(stderr);
+  return status;
 }
@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "compiler.hpp"
+
+using namespace std;
+
+// 各类数据的内存统计（--mem-report），类别为 ast、symbols、ir、backend、output
+// 数值是按数据结构的大小和容量估计的字节数，不替换全局的 operator new，嵌入到其他程序中也不影响它们的内存分配
+// 各阶段结束时用 set 记录当前的大小；后端各函数可能并行生成，用 add/sub 记录同时占用的总量
+class MemReport
+{
+private:
+    mutable mutex m;
+    vector<MemUsage> entries;   // 按第一次记录的顺序
+
+    MemUsage &get(const string &category)
+    {
+        for (auto &e : entries)
+        {
+            if (e.category == category)
+                return e;
+        }
+        entries.emplace_back();
+        entries.back().category = category;
+        return entries.back();
+    }
+
+    // 进程的常驻内存（字节），当前值读取 /proc/self/statm，峰值来自 getrusage
+    static void processRss(size_t &current, size_t &peak)
+    {
+        current = peak = 0;
+        FILE *f = fopen("/proc/self/statm", "r");
+        if (f)
+        {
+            long size, resident;
+            if (fscanf(f, "%ld %ld", &size, &resident) == 2)
+                current = resident * sysconf(_SC_PAGESIZE);
+            fclose(f);
+        }
+        rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru) == 0)
+            peak = ru.ru_maxrss * 1024L;
+        peak = max(peak, current);  // 两者的统计时机不同
+    }
+
+public:
+    // 记录某类数据当前占用的字节数，peak 为该阶段中已知的峰值（不知道时为 0）
+    void set(const string &category, size_t current, size_t peak = 0)
+    {
+        lock_guard<mutex> lk(m);
+        MemUsage &e = get(category);
+        e.current = current;
+        e.peak = max(e.peak, max(current, peak));
+    }
+
+    void add(const string &category, size_t bytes)
+    {
+        lock_guard<mutex> lk(m);
+        MemUsage &e = get(category);
+        e.current += bytes;
+        e.peak = max(e.peak, e.current);
+    }
+
+    void sub(const string &category, size_t bytes)
+    {
+        lock_guard<mutex> lk(m);
+        MemUsage &e = get(category);
+        e.current -= min(e.current, bytes);
+    }
+
+    vector<MemUsage> usage() const
+    {
+        lock_guard<mutex> lk(m);
+        return entries;
+    }
+
+    void print(FILE *f) const
+    {
+        lock_guard<mutex> lk(m);
+        fprintf(f, "===== memory report =====\n");
+        fprintf(f, "%-20s %14s %14s\n", "category", "current (KB)", "peak (KB)");
+        for (auto &e : entries)
+            fprintf(f, "%-20s %14.1f %14.1f\n", e.category.c_str(), e.current / 1024.0, e.peak / 1024.0);
+        size_t rss, peak_rss;
+        processRss(rss, peak_rss);
+        fprintf(f, "%-20s %14.1f %14.1f\n", "process rss", rss / 1024.0, peak_rss / 1024.0);
+    }
+
+    void printJSON(FILE *f) const
+    {
+        lock_guard<mutex> lk(m);
+        fprintf(f, "{\"categories\": [");
+        for (int i = 0; i < (int)entries.size(); i++)
+        {
+            fprintf(f, "%s\n  {\"category\": \"%s\", \"current\": %zu, \"peak\": %zu}", i ? "," : "",
+                    entries[i].category.c_str(), entries[i].current, entries[i].peak);
+        }
+        size_t rss, peak_rss;
+        processRss(rss, peak_rss);
+        fprintf(f, "],\n \"process_rss\": {\"current\": %zu, \"peak\": %zu}}\n", rss, peak_rss);
+    }
+};
@@ -0,0 +1,45 @@
+#include <unordered_set>
+#include "include/pass.hpp"
+
+using namespace std;
+
+class DCE : public FunctionPass
+{
+public:
+    const char *name() const override { return "dce"; }
+
+    bool run(IRFunction *func) override
+    {
+        // 工作表算法：删除一条指令后，它的操作数可能也变为无用
+        vector<IRValue *> worklist;
+        for (auto bb : func->bbs)
+        {
+            for (auto v : bb->insts)
+                worklist.push_back(v);
+        }
+        unordered_set<IRValue *> removed;
+        while (worklist.size())
+        {
+            IRValue *v = worklist.back();
+            worklist.pop_back();
+            if (removed.count(v) || v->hasSideEffect() || v->users.size())
+                continue;
+            for (auto op : v->ops)
+            {
+                if (op->bb)
+                    worklist.push_back(op);
+            }
+            v->dropOps();
+            removed.insert(v);
+        }
+        if (removed.empty())
+            return false;
+        func->eraseInsts(removed);
+        return true;
+    }
+};
+
+FunctionPass *createDCEPass()
+{
+    return new DCE();
+}
@@ -0,0 +1,125 @@
+#include "include/dominance.hpp"
+
+using namespace std;
+
+DominatorTree::DominatorTree(IRFunction *func)
+{
+    // 非递归的 DFS 求后序，函数很大时递归可能爆栈
+    vector<IRBasicBlock *> post;
+    vector<pair<IRBasicBlock *, int>> stack = {{func->entry(), 0}};
+    unordered_map<IRBasicBlock *, bool> visited = {{func->entry(), true}};
+    while (stack.size())
+    {
+        auto &top = stack.back();
+        IRBasicBlock *bb = top.first;
+        if (top.second < (int)bb->succs.size())
+        {
+            IRBasicBlock *succ = bb->succs[top.second++];
+            if (!visited[succ])
+            {
+                visited[succ] = true;
+                stack.push_back({succ, 0});
+            }
+        }
+        else
+        {
+            post.push_back(bb);
+            stack.pop_back();
+        }
+    }
+    rpo.assign(post.rbegin(), post.rend());
+    int n = rpo.size();
+    for (int i = 0; i < n; i++)
+        index[rpo[i]] = i;
+
+    idom.assign(n, -1);
+    idom[0] = 0;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int b = 1; b < n; b++)
+        {
+            int new_idom = -1;
+            for (auto pred : rpo[b]->preds)
+            {
+                auto it = index.find(pred);
+                if (it == index.end() || idom[it->second] == -1)
+                    continue;
+                new_idom = new_idom == -1 ? it->second : intersect(it->second, new_idom);
+            }
+            if (new_idom != idom[b])
+            {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    children.assign(n, {});
+    for (int b = 1; b < n; b++)
+        children[idom[b]].push_back(b);
+
+    // 汇合点的每个前驱沿支配树向上走到汇合点的直接支配者为止，途经的块的支配边界都包含汇合点
+    frontier.assign(n, {});
+    for (int b = 0; b < n; b++)
+    {
+        if (rpo[b]->preds.size() < 2)
+            continue;
+        for (auto pred : rpo[b]->preds)
+        {
+            auto it = index.find(pred);
+            if (it == index.end())
+                continue;
+            for (int runner = it->second; runner != idom[b]; runner = idom[runner])
+            {
+                if (frontier[runner].empty() || frontier[runner].back() != b)
+                    frontier[runner].push_back(b);
+            }
+        }
+    }
+}
+
+vector<int> DominatorTree::loopDepth() const
+{
+    int n = rpo.size();
+    vector<int> depth(n);
+    for (int h = 0; h < n; h++)
+    {
+        // 同一个循环头的所有回边合并为一个循环
+        vector<bool> in_loop(n);
+        vector<int> worklist;
+        for (auto pred : rpo[h]->preds)
+        {
+            auto it = index.find(pred);
+            if (it != index.end() && dominates(h, it->second) && !in_loop[it->second])
+            {
+                in_loop[it->second] = true;
+                worklist.push_back(it->second);
+            }
+        }
+        if (worklist.empty())
+            continue;
+        in_loop[h] = true;
+        // 从回边的起点逆着控制流找到循环体
+        while (worklist.size())
+        {
+            int b = worklist.back();
+            worklist.pop_back();
+            if (b == h)
+                continue;
+            for (auto pred : rpo[b]->preds)
+            {
+                auto it = index.find(pred);
+                if (it != index.end() && !in_loop[it->second])
+                {
+                    in_loop[it->second] = true;
+                    worklist.push_back(it->second);
+                }
+            }
+        }
+        for (int b = 0; b < n; b++)
+            depth[b] += in_loop[b];
+    }
+    return depth;
+}
@@ -0,0 +1,210 @@
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include "include/dominance.hpp"
+#include "include/pass.hpp"
+
+using namespace std;
+
+// 基于支配树的全局值编号
+// 按支配树先序遍历，一个纯运算（binary、getptr、getelemptr）若在支配它的位置上已经算过，就用之前的结果替换
+// load 的编号：记录每个地址当前已知的值（来自之前的 load 或 store），期间没有可能写入该地址的指令时直接复用
+// 进入一个基本块时，已知的值从直接支配者的出口继承，再去掉从直接支配者到该块的所有路径上（含回边）可能被写入的地址，
+// 相当于只在 memory SSA 的 phi 退化为直接支配者出口的内存状态时沿用之前的 load
+class GVN : public FunctionPass
+{
+private:
+    // 运算的编号：(tag, op, 左操作数, 右操作数)，操作数已经替换为各自的代表元
+    typedef tuple<int, int, IRValue *, IRValue *> Key;
+
+    // 地址所指的对象：局部的 alloc、全局变量，或者来自参数的未知数组
+    static IRValue *root(IRValue *ptr)
+    {
+        while (ptr->tag == IRValue::GET_ELEM_PTR || ptr->tag == IRValue::GET_PTR)
+            ptr = ptr->ops[0];
+        return ptr;
+    }
+
+    static bool isObject(IRValue *v)
+    {
+        return v->tag == IRValue::ALLOC || v->tag == IRValue::GLOBAL_ALLOC;
+    }
+
+    // 两个对象的内容是否可能重叠；数组参数可能指向全局变量或调用者的数组，但不会指向本函数的 alloc
+    static bool mayAlias(IRValue *a, IRValue *b)
+    {
+        if (a == b)
+            return true;
+        if (isObject(a) && isObject(b))
+            return false;
+        return a->tag != IRValue::ALLOC && b->tag != IRValue::ALLOC;
+    }
+
+    static bool isCommutative(IRValue::OP op)
+    {
+        return op == IRValue::ADD || op == IRValue::MUL || op == IRValue::AND || op == IRValue::OR ||
+               op == IRValue::XOR || op == IRValue::EQ || op == IRValue::NOT_EQ;
+    }
+
+    // 一个基本块中可能写入的对象，call 可能写入任何对象
+    struct Clobber
+    {
+        bool all = false;
+        vector<IRValue *> roots;
+    };
+
+    // 删除 avail 中可能被 clobber 写入的地址
+    static void kill(unordered_map<IRValue *, IRValue *> &avail, const Clobber &clobber)
+    {
+        if (clobber.all)
+        {
+            avail.clear();
+            return;
+        }
+        for (auto r : clobber.roots)
+        {
+            for (auto it = avail.begin(); it != avail.end();)
+            {
+                if (mayAlias(root(it->first), r))
+                    it = avail.erase(it);
+                else
+                    ++it;
+            }
+        }
+    }
+
+public:
+    const char *name() const override { return "gvn"; }
+
+    bool run(IRFunction *func) override
+    {
+        func->buildCFG();
+        DominatorTree dt(func);
+        int n = dt.rpo.size();
+
+        vector<Clobber> clobbers(n);
+        for (int b = 0; b < n; b++)
+        {
+            for (auto v : dt.rpo[b]->insts)
+            {
+                if (v->tag == IRValue::CALL)
+                    clobbers[b].all = true;
+                else if (v->tag == IRValue::STORE)
+                    clobbers[b].roots.push_back(root(v->ops[1]));
+            }
+        }
+
+        map<Key, IRValue *> table;
+        vector<Key> inserted;   // 依次加入 table 的键，退出基本块时据此删除
+        vector<unordered_map<IRValue *, IRValue *>> avail_out(n);   // 各基本块出口处地址的已知值
+        unordered_set<IRValue *> dead;
+        // 非递归的支配树先序遍历，second 为退出该块时 inserted 应恢复的大小，-1 表示进入
+        vector<pair<int, int>> walk = {{0, -1}};
+        while (walk.size())
+        {
+            auto [b, mark] = walk.back();
+            walk.pop_back();
+            if (mark != -1)
+            {
+                while ((int)inserted.size() > mark)
+                {
+                    table.erase(inserted.back());
+                    inserted.pop_back();
+                }
+                continue;
+            }
+            walk.push_back({b, (int)inserted.size()});
+
+            // 从直接支配者继承已知的值，反向搜索两者之间的基本块，去掉其中可能写入的地址
+            unordered_map<IRValue *, IRValue *> avail;
+            if (b != 0 && avail_out[dt.idom[b]].size())
+            {
+                int d = dt.idom[b];
+                avail = avail_out[d];
+                vector<bool> visited(n);
+                vector<int> worklist;
+                for (auto pred : dt.rpo[b]->preds)
+                {
+                    auto it = dt.index.find(pred);
+                    if (it != dt.index.end() && it->second != d && !visited[it->second])
+                    {
+                        visited[it->second] = true;
+                        worklist.push_back(it->second);
+                    }
+                }
+                while (worklist.size() && avail.size())
+                {
+                    int p = worklist.back();
+                    worklist.pop_back();
+                    kill(avail, clobbers[p]);
+                    for (auto pred : dt.rpo[p]->preds)
+                    {
+                        auto it = dt.index.find(pred);
+                        if (it != dt.index.end() && it->second != d && !visited[it->second])
+                        {
+                            visited[it->second] = true;
+                            worklist.push_back(it->second);
+                        }
+                    }
+                }
+            }
+
+            for (auto v : dt.rpo[b]->insts)
+            {
+                if (v->tag == IRValue::BINARY || v->tag == IRValue::GET_PTR || v->tag == IRValue::GET_ELEM_PTR)
+                {
+                    IRValue *lhs = v->ops[0], *rhs = v->ops[1];
+                    if (v->tag == IRValue::BINARY && isCommutative(v->op) && less<IRValue *>()(rhs, lhs))
+                        swap(lhs, rhs);
+                    Key key(v->tag, v->tag == IRValue::BINARY ? v->op : 0, lhs, rhs);
+                    auto it = table.find(key);
+                    if (it != table.end())
+                    {
+                        v->replaceAllUsesWith(it->second);
+                        dead.insert(v);
+                    }
+                    else
+                    {
+                        table[key] = v;
+                        inserted.push_back(key);
+                    }
+                }
+                else if (v->tag == IRValue::LOAD)
+                {
+                    auto it = avail.find(v->ops[0]);
+                    if (it != avail.end())
+                    {
+                        v->replaceAllUsesWith(it->second);
+                        dead.insert(v);
+                    }
+                    else
+                        avail[v->ops[0]] = v;
+                }
+                else if (v->tag == IRValue::STORE)
+                {
+                    Clobber clobber;
+                    clobber.roots.push_back(root(v->ops[1]));
+                    kill(avail, clobber);
+                    avail[v->ops[1]] = v->ops[0];
+                }
+                else if (v->tag == IRValue::CALL)
+                    avail.clear();
+            }
+            avail_out[b] = move(avail);
+
+            for (int child : dt.children[b])
+                walk.push_back({child, -1});
+        }
+
+        if (dead.empty())
+            return false;
+        func->eraseInsts(dead);
+        return true;
+    }
+};
+
+FunctionPass *createGVNPass()
+{
+    return new GVN();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "ir.hpp"
+
+using namespace std;
+
+// 支配树与支配边界，使用 Cooper-Harvey-Kennedy 的迭代算法计算
+// 基本块用其在逆后序中的位置表示，入口为 0；只包含从入口可达的基本块
+class DominatorTree
+{
+public:
+    vector<IRBasicBlock *> rpo;                // 可达基本块的逆后序
+    unordered_map<const IRBasicBlock *, int> index;    // 基本块在 rpo 中的位置
+    vector<int> idom;                          // 直接支配者，入口的直接支配者为自身
+    vector<vector<int>> children;              // 支配树中的子节点
+    vector<vector<int>> frontier;              // 支配边界
+
+    // 需要先调用 func->buildCFG()
+    DominatorTree(IRFunction *func);
+
+    // 各基本块所在循环的嵌套深度；终点支配起点的边为回边，每条回边确定一个自然循环
+    vector<int> loopDepth() const;
+
+    // a 是否支配 b
+    bool dominates(int a, int b) const
+    {
+        while (b > a)
+            b = idom[b];
+        return a == b;
+    }
+
+private:
+    int intersect(int a, int b) const
+    {
+        // 在逆后序中，支配者的位置总是更靠前
+        while (a != b)
+        {
+            while (a > b)
+                a = idom[a];
+            while (b > a)
+                b = idom[b];
+        }
+        return a;
+    }
+};
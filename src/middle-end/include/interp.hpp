@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include "ir.hpp"
+
+using namespace std;
+
+// 解释执行时收集的动态剖析数据
+// 只记录各函数的调用次数和各基本块的执行次数，执行的指令数和访存、调用次数由基本块中的指令静态算出
+class InterpProfile
+{
+public:
+    unordered_map<const IRFunction *, long> calls;     // 函数被调用的次数
+    unordered_map<const IRBasicBlock *, long> execs;   // 基本块被执行的次数
+    int ret = 0;                                       // main 的返回值
+
+    // 按函数输出调用次数、指令数、load/store 数和调用其他函数的次数，以及每个基本块的执行次数和指令数
+    // phi 不计入指令数：它们在进入基本块时作为并行复制完成，生成的代码中通常不对应指令
+    void print(const IRProgram &program, Writer &out) const;
+};
+
+// 直接解释执行内存中的 IR（-interp），不经过后端；用于比较各个 pass 前后程序的动态行为
+// 库函数 getint/getch/getarray 从 in 读入，putint/putch/putarray 输出到 out，starttime/stoptime 什么也不做
+// 正常结束时返回 true；除零、越界访问或栈溢出时在 error 中给出原因并返回 false，此时 profile 中是已执行部分的数据
+bool Interpret(const IRProgram &program, FILE *in, FILE *out, InterpProfile &profile, string &error);
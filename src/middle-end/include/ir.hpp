@@ -0,0 +1,690 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// 内存中的 Koopa IR，前端直接构建，不再经过文本的 格式化->解析 往返
+// 与 libkoopa 的 raw program 不同，它是可修改的：维护了 use-def 链和控制流图，供中端的优化 pass 使用
+class IRType;
+class IRValue;
+class IRBasicBlock;
+class IRFunction;
+class IRProgram;
+class Writer;
+
+// Koopa IR 的类型
+class IRType
+{
+public:
+    enum TAG
+    {
+        INT32,
+        UNIT,
+        ARRAY,
+        POINTER,
+        FUNCTION
+    };
+
+    TAG tag;
+    int len;                 // 数组长度
+    IRType *base;            // 数组的元素类型 / 指针指向的类型 / 函数的返回值类型
+    vector<IRType *> params; // 函数的参数类型
+
+    IRType(TAG _t, IRType *_base = nullptr, int _len = 0) : tag(_t), len(_len), base(_base) {}
+
+    // 该类型所占的字节数
+    int size() const
+    {
+        if (tag == ARRAY)
+            return len * base->size();
+        if (tag == UNIT || tag == FUNCTION)
+            return 0;
+        return 4;
+    }
+
+    string toString() const;
+};
+
+// 一切皆 value：常量、全局变量、函数参数和指令
+class IRValue
+{
+public:
+    enum TAG
+    {
+        INTEGER,
+        ZERO_INIT,
+        UNDEF,
+        AGGREGATE,
+        FUNC_ARG,
+        PHI,
+        ALLOC,
+        GLOBAL_ALLOC,
+        LOAD,
+        STORE,
+        GET_PTR,
+        GET_ELEM_PTR,
+        BINARY,
+        BRANCH,
+        JUMP,
+        CALL,
+        RETURN
+    };
+
+    // 与 libkoopa 的 koopa_raw_binary_op 顺序一致
+    enum OP
+    {
+        NOT_EQ,
+        EQ,
+        GT,
+        LT,
+        GE,
+        LE,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        MOD,
+        AND,
+        OR,
+        XOR,
+        SHL,
+        SHR,
+        SAR
+    };
+
+    TAG tag;
+    IRType *ty;
+    string name;                    // 具名变量如 @x_1；临时变量为空，输出时再编号
+    int value;                      // INTEGER 的值，FUNC_ARG 的下标
+    OP op;                          // BINARY 的运算符
+    // 操作数：LOAD [src]，STORE [value, dest]，GET_PTR/GET_ELEM_PTR [src, index]
+    // BINARY [lhs, rhs]，BRANCH [cond]，CALL 实参，RETURN [value] 或空
+    // GLOBAL_ALLOC [init]，AGGREGATE 各元素，PHI 各前驱传入的值
+    // 修改操作数请使用 addOp/setOp/dropOps，以维护 users
+    vector<IRValue *> ops;
+    // BRANCH [true_bb, false_bb]，JUMP [target]，PHI 与 ops 一一对应的前驱基本块
+    vector<IRBasicBlock *> targets;
+    IRFunction *callee;             // CALL 调用的函数
+    IRBasicBlock *bb;               // 所在的基本块，常量、全局变量和参数为空
+    // 使用了该值的指令，每使用一次记录一次；常量和全局变量被各函数共享，不记录
+    vector<IRValue *> users;
+
+    IRValue(TAG _t, IRType *_ty) : tag(_t), ty(_ty), value(0), op(ADD), callee(nullptr), bb(nullptr) {}
+
+    bool isConst() const
+    {
+        return tag == INTEGER || tag == ZERO_INIT || tag == UNDEF || tag == AGGREGATE;
+    }
+
+    // 函数内部的值（指令、参数、phi）才维护 users
+    bool isLocal() const
+    {
+        return !isConst() && tag != GLOBAL_ALLOC;
+    }
+
+    bool isTerminator() const
+    {
+        return tag == BRANCH || tag == JUMP || tag == RETURN;
+    }
+
+    // 删除该指令不会改变程序行为的前提是它没有副作用且结果无人使用
+    bool hasSideEffect() const
+    {
+        return tag == STORE || tag == CALL || isTerminator();
+    }
+
+    void addOp(IRValue *v)
+    {
+        ops.push_back(v);
+        if (v->isLocal())
+            v->users.push_back(this);
+    }
+
+    void setOp(int i, IRValue *v)
+    {
+        if (ops[i]->isLocal())
+            ops[i]->removeUser(this);
+        ops[i] = v;
+        if (v->isLocal())
+            v->users.push_back(this);
+    }
+
+    // 清空操作数，删除指令前必须调用；phi 的前驱与操作数一一对应，一并清空
+    void dropOps()
+    {
+        for (auto v : ops)
+        {
+            if (v->isLocal())
+                v->removeUser(this);
+        }
+        ops.clear();
+        if (tag == PHI)
+            targets.clear();
+    }
+
+    void removeUser(IRValue *user)
+    {
+        for (auto &u : users)
+        {
+            if (u == user)
+            {
+                u = users.back();
+                users.pop_back();
+                return;
+            }
+        }
+    }
+
+    // phi 增加一个从 pred 传入的值
+    void addIncoming(IRValue *v, IRBasicBlock *pred)
+    {
+        addOp(v);
+        targets.push_back(pred);
+    }
+
+    // phi 中从 pred 传入的值，没有则返回 nullptr
+    IRValue *getIncoming(const IRBasicBlock *pred) const
+    {
+        for (int i = 0; i < (int)targets.size(); i++)
+        {
+            if (targets[i] == pred)
+                return ops[i];
+        }
+        return nullptr;
+    }
+
+    // 删除 phi 中从 pred 传入的值
+    void removeIncoming(const IRBasicBlock *pred);
+
+    // 将所有对该值的使用替换为 v
+    void replaceAllUsesWith(IRValue *v);
+
+    // 该指令是否会产生结果（需要一个临时变量名）
+    bool hasResult() const
+    {
+        return ty->tag != IRType::UNIT;
+    }
+};
+
+class IRBasicBlock
+{
+public:
+    string name;            // 如 %entry, %then_1
+    vector<IRValue *> insts; // 开头是该块的 phi，最后是 terminator
+    IRFunction *func;
+    // 控制流图，由 IRFunction::buildCFG 计算，修改 terminator 后需重新计算
+    vector<IRBasicBlock *> preds, succs;
+
+    IRBasicBlock(const string &_name, IRFunction *_func) : name(_name), func(_func) {}
+
+    // 该块开头 phi 的个数，非 phi 指令从这里开始
+    int phiCount() const
+    {
+        int n = 0;
+        while (n < (int)insts.size() && insts[n]->tag == IRValue::PHI)
+            n++;
+        return n;
+    }
+
+    void insert(int pos, IRValue *v)
+    {
+        v->bb = this;
+        insts.insert(insts.begin() + pos, v);
+    }
+
+    // 插入到 terminator 之前
+    void insertBeforeTerminator(IRValue *v)
+    {
+        insert(terminator() ? (int)insts.size() - 1 : (int)insts.size(), v);
+    }
+
+    // 删除一条指令，其结果必须已经无人使用
+    void erase(IRValue *v)
+    {
+        v->dropOps();
+        for (int i = 0; i < (int)insts.size(); i++)
+        {
+            if (insts[i] == v)
+            {
+                insts.erase(insts.begin() + i);
+                break;
+            }
+        }
+        v->bb = nullptr;
+    }
+
+    // 基本块的最后一条指令必须是 br, jump 或 ret
+    IRValue *terminator() const
+    {
+        if (insts.empty())
+            return nullptr;
+        IRValue *last = insts.back();
+        if (last->isTerminator())
+            return last;
+        return nullptr;
+    }
+};
+
+class IRFunction
+{
+public:
+    string name;                // 如 @main
+    IRType *ty;                 // 函数类型
+    IRProgram *prog;            // 所在的程序，用于获取常量和类型
+    vector<IRValue *> params;
+    vector<IRBasicBlock *> bbs; // 为空表示这是一个函数声明
+
+    // 函数内的指令、参数和基本块都归函数所有
+    vector<unique_ptr<IRValue>> value_pool;
+    vector<unique_ptr<IRBasicBlock>> bb_pool;
+
+    // 增量编译（见 driver.cpp）：reused 为真时直接输出缓存中的 output，不再运行 pass 和生成代码；
+    // record 为真时输出该函数的同时把文本保存到 output 中，之后存入缓存
+    bool reused = false, record = false;
+    string output;
+
+    IRFunction(const string &_name, IRType *_ty, IRProgram *_prog) : name(_name), ty(_ty), prog(_prog) {}
+
+    bool isDecl() const
+    {
+        return bbs.empty();
+    }
+
+    IRType *retType() const
+    {
+        return ty->base;
+    }
+
+    IRValue *newValue(IRValue::TAG tag, IRType *ty)
+    {
+        value_pool.emplace_back(new IRValue(tag, ty));
+        return value_pool.back().get();
+    }
+
+    IRBasicBlock *newBlock(const string &name)
+    {
+        bb_pool.emplace_back(new IRBasicBlock(name, this));
+        return bb_pool.back().get();
+    }
+
+    IRBasicBlock *entry() const
+    {
+        return bbs[0];
+    }
+
+    // 根据各基本块的 terminator 重新计算前驱和后继
+    void buildCFG();
+
+    // 从函数中删除一个基本块，后继中来自它的 phi 参数一并删除
+    void removeBlock(IRBasicBlock *bb);
+
+    // 批量删除指令，它们的结果必须已经无人使用（或者同在 dead 中）
+    void eraseInsts(const unordered_set<IRValue *> &dead);
+};
+
+// 常量、类型和全局变量归整个程序所有
+// 各函数的 pass 和代码生成可以并行执行，它们都可能创建常量，因此创建新对象时需要加锁
+class IRProgram
+{
+private:
+    vector<unique_ptr<IRType>> type_pool;
+    vector<unique_ptr<IRValue>> value_pool;
+    vector<unique_ptr<IRFunction>> func_pool;
+    IRType *i32_ty, *unit_ty;
+    map<pair<IRType *, int>, IRType *> array_tys;
+    unordered_map<IRType *, IRType *> pointer_tys;
+    unordered_map<int, IRValue *> ints;
+    IRValue *zero_init_v = nullptr;
+    mutex pool_mutex;   // 保护以上各个池和表
+
+    IRType *newType(IRType *ty)
+    {
+        type_pool.emplace_back(ty);
+        return ty;
+    }
+
+    IRValue *create(IRValue::TAG tag, IRType *ty)
+    {
+        value_pool.emplace_back(new IRValue(tag, ty));
+        return value_pool.back().get();
+    }
+
+public:
+    vector<IRValue *> globals;  // 全局变量（GLOBAL_ALLOC）
+    vector<IRFunction *> funcs; // 函数声明与定义，按源码顺序
+
+    IRProgram()
+    {
+        i32_ty = newType(new IRType(IRType::INT32));
+        unit_ty = newType(new IRType(IRType::UNIT));
+    }
+
+    // 类型都是唯一的，可以直接比较指针
+    IRType *getInt()
+    {
+        return i32_ty;
+    }
+
+    IRType *getUnit()
+    {
+        return unit_ty;
+    }
+
+    IRType *getArray(IRType *base, int len)
+    {
+        lock_guard<mutex> lk(pool_mutex);
+        auto &ty = array_tys[{base, len}];
+        if (!ty)
+            ty = newType(new IRType(IRType::ARRAY, base, len));
+        return ty;
+    }
+
+    IRType *getPointer(IRType *base)
+    {
+        lock_guard<mutex> lk(pool_mutex);
+        auto &ty = pointer_tys[base];
+        if (!ty)
+            ty = newType(new IRType(IRType::POINTER, base));
+        return ty;
+    }
+
+    IRType *getFunction(const vector<IRType *> &params, IRType *ret)
+    {
+        lock_guard<mutex> lk(pool_mutex);
+        IRType *ty = newType(new IRType(IRType::FUNCTION, ret));
+        ty->params = params;
+        return ty;
+    }
+
+    IRValue *newValue(IRValue::TAG tag, IRType *ty)
+    {
+        lock_guard<mutex> lk(pool_mutex);
+        return create(tag, ty);
+    }
+
+    // 整数常量是唯一的
+    IRValue *getInteger(int v)
+    {
+        lock_guard<mutex> lk(pool_mutex);
+        auto &val = ints[v];
+        if (!val)
+        {
+            val = create(IRValue::INTEGER, i32_ty);
+            val->value = v;
+        }
+        return val;
+    }
+
+    IRValue *getZeroInit(IRType *ty)
+    {
+        lock_guard<mutex> lk(pool_mutex);
+        if (ty == i32_ty)
+        {
+            if (!zero_init_v)
+                zero_init_v = create(IRValue::ZERO_INIT, i32_ty);
+            return zero_init_v;
+        }
+        return create(IRValue::ZERO_INIT, ty);
+    }
+
+    IRValue *getUndef(IRType *ty)
+    {
+        return newValue(IRValue::UNDEF, ty);
+    }
+
+    IRValue *getAggregate(IRType *ty, const vector<IRValue *> &elems)
+    {
+        IRValue *val = newValue(IRValue::AGGREGATE, ty);
+        val->ops = elems;
+        return val;
+    }
+
+    // 所有类型、值、基本块和函数占用的字节数（估计），用于 --mem-report；只在两个阶段之间调用
+    size_t memoryUsage() const;
+
+    // 删除所有函数、全局变量、值和类型，回到刚构造时的状态，池本身的容量保留下来
+    // 只在两次编译之间调用，之前得到的指针全部失效
+    void clear()
+    {
+        lock_guard<mutex> lk(pool_mutex);
+        globals.clear();
+        funcs.clear();
+        func_pool.clear();
+        value_pool.clear();
+        type_pool.resize(2);    // 只留下 i32 和 unit
+        array_tys.clear();
+        pointer_tys.clear();
+        ints.clear();
+        zero_init_v = nullptr;
+    }
+
+    // 只在构建 IR 时调用，此时还没有并行的 pass
+    IRFunction *newFunction(const string &name, IRType *ty)
+    {
+        func_pool.emplace_back(new IRFunction(name, ty, this));
+        funcs.push_back(func_pool.back().get());
+        return funcs.back();
+    }
+};
+
+// 构建 IR 的辅助类，接口与原来生成文本的 KoopaString 一一对应
+class IRBuilder
+{
+private:
+    IRFunction *func = nullptr;    // 当前函数
+    IRBasicBlock *cur = nullptr;   // 当前插入的基本块
+
+    IRValue *insert(IRValue::TAG tag, IRType *ty)
+    {
+        IRValue *val = func->newValue(tag, ty);
+        val->bb = cur;
+        cur->insts.push_back(val);
+        return val;
+    }
+
+public:
+    IRProgram program;
+
+    // 清空 program，开始构建新的程序
+    void reset()
+    {
+        func = nullptr;
+        cur = nullptr;
+        program.clear();
+    }
+
+    IRType *i32()
+    {
+        return program.getInt();
+    }
+
+    IRValue *integer(int v)
+    {
+        return program.getInteger(v);
+    }
+
+    IRValue *binary(IRValue::OP op, IRValue *lhs, IRValue *rhs)
+    {
+        IRValue *val = insert(IRValue::BINARY, i32());
+        val->op = op;
+        val->addOp(lhs);
+        val->addOp(rhs);
+        return val;
+    }
+
+    void ret(IRValue *v)
+    {
+        IRValue *val = insert(IRValue::RETURN, program.getUnit());
+        if (v)
+            val->addOp(v);
+    }
+
+    IRValue *alloc(const string &name, IRType *ty)
+    {
+        IRValue *val = insert(IRValue::ALLOC, program.getPointer(ty));
+        val->name = name;
+        return val;
+    }
+
+    IRValue *globalAlloc(const string &name, IRType *ty, IRValue *init = nullptr)
+    {
+        IRValue *val = program.newValue(IRValue::GLOBAL_ALLOC, program.getPointer(ty));
+        val->name = name;
+        val->addOp(init ? init : program.getZeroInit(ty));
+        program.globals.push_back(val);
+        return val;
+    }
+
+    IRValue *load(IRValue *src)
+    {
+        IRValue *val = insert(IRValue::LOAD, src->ty->base);
+        val->addOp(src);
+        return val;
+    }
+
+    void store(IRValue *v, IRValue *dest)
+    {
+        IRValue *val = insert(IRValue::STORE, program.getUnit());
+        val->addOp(v);
+        val->addOp(dest);
+    }
+
+    // 新建一个基本块，但先不放入函数中
+    IRBasicBlock *newBlock(const string &name)
+    {
+        return func->newBlock(name);
+    }
+
+    // 将基本块接到函数末尾，之后的指令都插入到该块中
+    void label(IRBasicBlock *bb)
+    {
+        func->bbs.push_back(bb);
+        cur = bb;
+    }
+
+    void br(IRValue *cond, IRBasicBlock *then_bb, IRBasicBlock *else_bb)
+    {
+        IRValue *val = insert(IRValue::BRANCH, program.getUnit());
+        val->addOp(cond);
+        val->targets = {then_bb, else_bb};
+    }
+
+    // 在基本块开头新建一个 phi，即 Koopa 中的基本块参数
+    IRValue *phi(IRBasicBlock *bb, IRType *ty)
+    {
+        IRValue *val = bb->func->newValue(IRValue::PHI, ty);
+        bb->insert(bb->phiCount(), val);
+        return val;
+    }
+
+    void jump(IRBasicBlock *target)
+    {
+        IRValue *val = insert(IRValue::JUMP, program.getUnit());
+        val->targets = {target};
+    }
+
+    // 无返回值的函数返回 nullptr
+    IRValue *call(IRFunction *callee, const vector<IRValue *> &args)
+    {
+        IRValue *val = insert(IRValue::CALL, callee->retType());
+        val->callee = callee;
+        for (auto arg : args)
+            val->addOp(arg);
+        return val->hasResult() ? val : nullptr;
+    }
+
+    IRValue *getelemptr(IRValue *src, IRValue *index)
+    {
+        IRValue *val = insert(IRValue::GET_ELEM_PTR, program.getPointer(src->ty->base->base));
+        val->addOp(src);
+        val->addOp(index);
+        return val;
+    }
+
+    IRValue *getptr(IRValue *src, IRValue *index)
+    {
+        IRValue *val = insert(IRValue::GET_PTR, src->ty);
+        val->addOp(src);
+        val->addOp(index);
+        return val;
+    }
+
+    // 声明一个函数，params 为参数类型，ret 为 nullptr 表示无返回值
+    IRFunction *declFunc(const string &name, const vector<IRType *> &params, IRType *ret)
+    {
+        return program.newFunction(name, program.getFunction(params, ret ? ret : program.getUnit()));
+    }
+
+    // 开始定义一个已声明的函数，param_names 为形参在 Koopa 中的名字
+    IRFunction *beginFunc(IRFunction *decl, const vector<string> &param_names)
+    {
+        func = decl;
+        const vector<IRType *> &params = func->ty->params;
+        for (int i = 0; i < (int)params.size(); i++)
+        {
+            IRValue *arg = func->newValue(IRValue::FUNC_ARG, params[i]);
+            arg->name = param_names[i];
+            arg->value = i;
+            func->params.push_back(arg);
+        }
+        return func;
+    }
+
+    // 结束函数定义，并把所有 alloc 集中到入口块的开头
+    void endFunc()
+    {
+        vector<IRValue *> allocs;
+        for (auto bb : func->bbs)
+        {
+            int n = 0;
+            for (auto v : bb->insts)
+            {
+                if (v->tag == IRValue::ALLOC)
+                {
+                    v->bb = func->bbs[0];
+                    allocs.push_back(v);
+                }
+                else
+                    bb->insts[n++] = v;
+            }
+            bb->insts.resize(n);
+        }
+        auto &entry = func->bbs[0]->insts;
+        entry.insert(entry.begin(), allocs.begin(), allocs.end());
+        func = nullptr;
+        cur = nullptr;
+    }
+
+    void declLibFunc(vector<IRFunction *> &decls)
+    {
+        IRType *ptr = program.getPointer(i32());
+        decls.push_back(declFunc("@getint", {}, i32()));
+        decls.push_back(declFunc("@getch", {}, i32()));
+        decls.push_back(declFunc("@getarray", {ptr}, i32()));
+        decls.push_back(declFunc("@putint", {i32()}, nullptr));
+        decls.push_back(declFunc("@putch", {i32()}, nullptr));
+        decls.push_back(declFunc("@putarray", {i32(), ptr}, nullptr));
+        decls.push_back(declFunc("@starttime", {}, nullptr));
+        decls.push_back(declFunc("@stoptime", {}, nullptr));
+    }
+};
+
+// 计算 i32 的二元运算，按补码回绕，移位量取低 5 位；除数为 0 时返回 false
+// 解释器和常量折叠共用，保证编译时折叠的结果与运行时相同
+bool FoldBinary(IRValue::OP op, int lhs, int rhs, int &result);
+
+// 将内存中的 IR 输出为文本形式的 Koopa IR，只在 -koopa 模式下使用
+void DumpKoopa(const IRProgram &program, Writer &out);
+
+// 函数的指纹：未优化的 IR 的文本，加上它用到的全局变量和所调用函数的声明
+// 指纹相同的函数经过同样的 pass 和代码生成后输出也相同
+string FunctionFingerprint(const IRFunction *f);
+
+// 读取文本形式的 Koopa IR 文件，借助 libkoopa 解析后转换到 program 中；失败时在 error 中给出原因并返回 false
+bool ImportKoopa(const char *path, IRProgram &program, string &error);
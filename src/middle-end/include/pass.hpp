@@ -0,0 +1,79 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "ir.hpp"
+#include "../../threadpool.hpp"
+#include "../../timer.hpp"
+
+using namespace std;
+
+// 以函数为单位的优化 pass
+// 同一个 pass 对象可能同时在多个线程中处理不同的函数，运行时的状态应放在 run 的局部变量中
+// pass 的结果只能取决于所处理的函数本身，增量编译据此复用指纹未变的函数（见 FunctionFingerprint）
+class FunctionPass
+{
+public:
+    virtual ~FunctionPass() = default;
+
+    virtual const char *name() const = 0;
+    // 对一个函数定义运行该 pass，返回是否修改了函数
+    virtual bool run(IRFunction *func) = 0;
+};
+
+// 按顺序对每个函数运行加入的 pass
+class PassManager
+{
+private:
+    vector<unique_ptr<FunctionPass>> passes;
+
+public:
+    void add(FunctionPass *pass)
+    {
+        passes.emplace_back(pass);
+    }
+
+    // timer 非空时分别记录每个 pass 在该函数上的耗时
+    bool run(IRFunction *func, TimeReport *timer = nullptr)
+    {
+        bool changed = false;
+        for (auto &pass : passes)
+        {
+            ScopedTimer t(timer, pass->name(), &func->name);
+            changed |= pass->run(func);
+        }
+        return changed;
+    }
+
+    // pool 非空时各函数的 pass 并行执行，函数之间只共享 IRProgram 中的常量和类型
+    // 增量编译时复用缓存输出的函数不再优化
+    void run(IRProgram &program, ThreadPool *pool = nullptr, TimeReport *timer = nullptr)
+    {
+        vector<IRFunction *> defs;
+        for (auto func : program.funcs)
+        {
+            if (!func->isDecl() && !func->reused)
+                defs.push_back(func);
+        }
+        if (pool && defs.size() > 1)
+            pool->parallelFor(defs.size(), [&](int i) { run(defs[i], timer); });
+        else
+        {
+            for (auto func : defs)
+                run(func, timer);
+        }
+    }
+};
+
+// 删除不可达的基本块
+FunctionPass *createSimplifyCFGPass();
+// 将局部变量提升为 SSA 值
+FunctionPass *createMem2RegPass();
+// 稀疏条件常量传播：折叠常量，删除不可能走到的分支和基本块
+FunctionPass *createSCCPPass();
+// 基于支配树的全局值编号，删除重复的运算、地址计算和 load
+FunctionPass *createGVNPass();
+// 删除没有副作用且结果无人使用的指令
+FunctionPass *createDCEPass();
+
+// 根据优化等级向 pm 中加入 pass，-O0 不做任何优化
+void BuildPipeline(PassManager &pm, int opt_level);
@@ -0,0 +1,561 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "interp.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+// 内存以 32 位字为单位，指针是字的下标；全局变量在最前面，之后是各函数的栈帧
+static const long MAX_MEMORY_WORDS = 1L << 28;
+static const int MAX_CALL_DEPTH = 1 << 20;
+
+// 译码后的操作数：常量（全局变量的地址也是常量）、寄存器，或 store 的数组初始值
+struct Operand
+{
+    enum KIND
+    {
+        CONST,
+        REG,
+        INIT
+    };
+    KIND kind = CONST;
+    long v = 0;                     // 常量的值或寄存器编号
+    const IRValue *init = nullptr;  // INIT 的 ZERO_INIT / AGGREGATE
+};
+
+enum Builtin
+{
+    NOT_BUILTIN,
+    GETINT,
+    GETCH,
+    GETARRAY,
+    PUTINT,
+    PUTCH,
+    PUTARRAY,
+    STARTTIME,
+    STOPTIME,
+    UNKNOWN
+};
+
+// 译码后的指令，phi 不单独出现，而是变成控制流边上的并行复制
+struct Inst
+{
+    IRValue::TAG tag;
+    IRValue::OP op = IRValue::ADD;
+    int dst = -1;           // 结果所在的寄存器
+    Operand a, b;
+    long size = 0;          // GET_PTR/GET_ELEM_PTR 的步长（字），ALLOC 在栈帧中的偏移（字）
+    int edge[2] = {-1, -1}; // BRANCH/JUMP 的出边
+    int args = 0, nargs = 0; // CALL 的实参在 Code::args 中的位置
+    const IRFunction *callee = nullptr;
+    Builtin builtin = NOT_BUILTIN;
+};
+
+struct Edge
+{
+    int target;
+    vector<pair<int, Operand>> copies;  // 目标块的 phi 的寄存器 <- 从这条边传入的值
+};
+
+// 一个函数译码后的形式，同一个函数只译码一次
+struct Code
+{
+    const IRFunction *func;
+    vector<Inst> insts;
+    vector<int> block_start;    // 各基本块第一条非 phi 指令在 insts 中的位置
+    vector<Edge> edges;
+    vector<Operand> args;
+    int nregs = 0;
+    long frame = 0;             // 栈帧中 alloc 占用的字数
+    long calls = 0;
+    vector<long> execs;         // 各基本块的执行次数
+};
+
+static Builtin builtinOf(const string &name)
+{
+    static const pair<const char *, Builtin> table[] = {
+        {"@getint", GETINT}, {"@getch", GETCH}, {"@getarray", GETARRAY}, {"@putint", PUTINT},
+        {"@putch", PUTCH}, {"@putarray", PUTARRAY}, {"@starttime", STARTTIME}, {"@stoptime", STOPTIME}};
+    for (auto &p : table)
+    {
+        if (name == p.first)
+            return p.second;
+    }
+    return UNKNOWN;
+}
+
+class Interpreter
+{
+private:
+    const IRProgram &program;
+    FILE *in, *out;
+    vector<int32_t> mem;
+    long sp = 0;                // 栈顶，[0, sp) 是可以访问的内存
+    vector<long> regs;          // 各活动函数的寄存器依次排列
+    unordered_map<const IRValue *, long> global_addr;
+    unordered_map<const IRFunction *, unique_ptr<Code>> codes;
+
+    // 把常量初始值展开写入 addr 开始的内存
+    void initialize(const IRValue *init, long addr)
+    {
+        if (init->tag == IRValue::INTEGER)
+            mem[addr] = init->value;
+        else if (init->tag == IRValue::AGGREGATE)
+        {
+            long step = init->ty->base->size() / 4;
+            for (int i = 0; i < (int)init->ops.size(); i++)
+                initialize(init->ops[i], addr + i * step);
+        }
+        else
+            fill(mem.begin() + addr, mem.begin() + addr + init->ty->size() / 4, 0);
+    }
+
+    Code *code(const IRFunction *f)
+    {
+        auto &c = codes[f];
+        if (!c)
+            c.reset(decode(f));
+        return c.get();
+    }
+
+    Code *decode(const IRFunction *f)
+    {
+        Code *c = new Code;
+        c->func = f;
+        unordered_map<const IRValue *, int> slot;
+        unordered_map<const IRBasicBlock *, int> block;
+        for (auto p : f->params)
+            slot[p] = c->nregs++;
+        for (int i = 0; i < (int)f->bbs.size(); i++)
+        {
+            block[f->bbs[i]] = i;
+            for (auto v : f->bbs[i]->insts)
+            {
+                if (v->hasResult())
+                    slot[v] = c->nregs++;
+            }
+        }
+        auto operand = [&](const IRValue *v) {
+            Operand o;
+            if (v->tag == IRValue::INTEGER)
+                o.v = v->value;
+            else if (v->tag == IRValue::GLOBAL_ALLOC)
+                o.v = global_addr.at(v);
+            else if (v->tag == IRValue::ZERO_INIT || v->tag == IRValue::AGGREGATE)
+            {
+                o.kind = Operand::INIT;
+                o.init = v;
+            }
+            else if (v->tag != IRValue::UNDEF)
+            {
+                o.kind = Operand::REG;
+                o.v = slot.at(v);
+            }
+            return o;
+        };
+        // 从 from 到 to 的边，带上 to 中各 phi 的复制
+        auto edge = [&](const IRBasicBlock *from, const IRBasicBlock *to) {
+            Edge e;
+            e.target = block.at(to);
+            for (int i = 0; i < to->phiCount(); i++)
+            {
+                IRValue *in = to->insts[i]->getIncoming(from);
+                e.copies.emplace_back(slot.at(to->insts[i]), in ? operand(in) : Operand());
+            }
+            c->edges.push_back(e);
+            return (int)c->edges.size() - 1;
+        };
+
+        for (auto bb : f->bbs)
+        {
+            c->block_start.push_back(c->insts.size());
+            for (int i = bb->phiCount(); i < (int)bb->insts.size(); i++)
+            {
+                IRValue *v = bb->insts[i];
+                Inst inst;
+                inst.tag = v->tag;
+                inst.op = v->op;
+                if (v->hasResult())
+                    inst.dst = slot[v];
+                switch (v->tag)
+                {
+                case IRValue::ALLOC:
+                    inst.size = c->frame;
+                    c->frame += v->ty->base->size() / 4;
+                    break;
+                case IRValue::GET_PTR:
+                    inst.size = v->ops[0]->ty->base->size() / 4;
+                    break;
+                case IRValue::GET_ELEM_PTR:
+                    inst.size = v->ops[0]->ty->base->base->size() / 4;
+                    break;
+                case IRValue::BRANCH:
+                    inst.edge[0] = edge(bb, v->targets[0]);
+                    inst.edge[1] = edge(bb, v->targets[1]);
+                    break;
+                case IRValue::JUMP:
+                    inst.edge[0] = edge(bb, v->targets[0]);
+                    break;
+                case IRValue::CALL:
+                    inst.callee = v->callee;
+                    if (v->callee->isDecl())
+                        inst.builtin = builtinOf(v->callee->name);
+                    inst.args = c->args.size();
+                    inst.nargs = v->ops.size();
+                    for (auto arg : v->ops)
+                        c->args.push_back(operand(arg));
+                    break;
+                default:
+                    break;
+                }
+                if (v->tag != IRValue::CALL)
+                {
+                    if (v->ops.size() > 0)
+                        inst.a = operand(v->ops[0]);
+                    if (v->ops.size() > 1)
+                        inst.b = operand(v->ops[1]);
+                }
+                c->insts.push_back(inst);
+            }
+        }
+        c->execs.assign(f->bbs.size(), 0);
+        return c;
+    }
+
+public:
+    string error;
+
+    Interpreter(const IRProgram &_program, FILE *_in, FILE *_out) : program(_program), in(_in), out(_out)
+    {
+        for (auto g : program.globals)
+        {
+            global_addr[g] = sp;
+            sp += g->ty->base->size() / 4;
+        }
+        mem.assign(sp, 0);
+        for (auto g : program.globals)
+            initialize(g->ops[0], global_addr[g]);
+    }
+
+    // 执行 f，成功时 ret 为它的返回值
+    bool run(const IRFunction *f, int &ret)
+    {
+        // 调用者的状态，callee 返回时恢复
+        struct Frame
+        {
+            Code *c;
+            int pc;
+            long base, fp;
+            int dst;
+        };
+        vector<Frame> frames;
+        Code *c = nullptr;
+        int pc = 0;
+        long base = 0, fp = 0;
+        vector<long> argv, tmp;
+
+        auto val = [&](const Operand &o) { return o.kind == Operand::REG ? regs[base + o.v] : o.v; };
+        auto valid = [&](long addr, long words) {
+            if (addr >= 0 && addr + words <= sp)
+                return true;
+            error = "out-of-bounds memory access in " + c->func->name;
+            return false;
+        };
+        // 进入 callee：分配寄存器和清零的栈帧，实参放入参数的寄存器
+        auto enter = [&](const IRFunction *callee) {
+            Code *nc = code(callee);
+            if ((int)frames.size() >= MAX_CALL_DEPTH || sp + nc->frame > MAX_MEMORY_WORDS)
+            {
+                error = "stack overflow in " + callee->name;
+                return false;
+            }
+            c = nc;
+            c->calls++;
+            base = regs.size();
+            regs.resize(base + c->nregs);
+            copy(argv.begin(), argv.end(), regs.begin() + base);
+            fp = sp;
+            sp += c->frame;
+            if ((long)mem.size() < sp)
+                mem.resize(max(sp, (long)mem.size() * 2));
+            fill(mem.begin() + fp, mem.begin() + sp, 0);
+            pc = c->block_start[0];
+            c->execs[0]++;
+            return true;
+        };
+        // 沿边跳转，phi 的复制是并行的：先读出所有传入的值再写入
+        auto jump = [&](int e) {
+            const Edge &edge = c->edges[e];
+            if (edge.copies.size() == 1)
+                regs[base + edge.copies[0].first] = val(edge.copies[0].second);
+            else if (!edge.copies.empty())
+            {
+                tmp.clear();
+                for (auto &copy : edge.copies)
+                    tmp.push_back(val(copy.second));
+                for (int i = 0; i < (int)tmp.size(); i++)
+                    regs[base + edge.copies[i].first] = tmp[i];
+            }
+            pc = c->block_start[edge.target];
+            c->execs[edge.target]++;
+        };
+
+        if (!enter(f))
+            return false;
+        while (true)
+        {
+            const Inst &inst = c->insts[pc++];
+            switch (inst.tag)
+            {
+            case IRValue::ALLOC:
+                regs[base + inst.dst] = fp + inst.size;
+                break;
+            case IRValue::LOAD:
+            {
+                long addr = val(inst.a);
+                if (!valid(addr, 1))
+                    return false;
+                regs[base + inst.dst] = mem[addr];
+                break;
+            }
+            case IRValue::STORE:
+            {
+                long addr = val(inst.b);
+                if (inst.a.kind == Operand::INIT)
+                {
+                    if (!valid(addr, inst.a.init->ty->size() / 4))
+                        return false;
+                    initialize(inst.a.init, addr);
+                    break;
+                }
+                if (!valid(addr, 1))
+                    return false;
+                mem[addr] = val(inst.a);
+                break;
+            }
+            case IRValue::GET_PTR:
+            case IRValue::GET_ELEM_PTR:
+                regs[base + inst.dst] = val(inst.a) + (int32_t)val(inst.b) * inst.size;
+                break;
+            case IRValue::BINARY:
+            {
+                int res = 0;
+                if (!FoldBinary(inst.op, val(inst.a), val(inst.b), res))
+                {
+                    error = "division by zero in " + c->func->name;
+                    return false;
+                }
+                regs[base + inst.dst] = res;
+                break;
+            }
+            case IRValue::BRANCH:
+                jump(inst.edge[val(inst.a) ? 0 : 1]);
+                break;
+            case IRValue::JUMP:
+                jump(inst.edge[0]);
+                break;
+            case IRValue::CALL:
+            {
+                argv.clear();
+                for (int i = 0; i < inst.nargs; i++)
+                    argv.push_back(val(c->args[inst.args + i]));
+                if (inst.builtin == NOT_BUILTIN)
+                {
+                    frames.push_back({c, pc, base, fp, inst.dst});
+                    if (!enter(inst.callee))
+                        return false;
+                    break;
+                }
+                long res = 0;
+                if (!callBuiltin(inst, argv, res))
+                    return false;
+                if (inst.dst >= 0)
+                    regs[base + inst.dst] = res;
+                break;
+            }
+            case IRValue::RETURN:
+            {
+                long res = val(inst.a);
+                regs.resize(base);
+                sp = fp;
+                if (frames.empty())
+                {
+                    ret = res;
+                    return true;
+                }
+                Frame &caller = frames.back();
+                c = caller.c;
+                pc = caller.pc;
+                base = caller.base;
+                fp = caller.fp;
+                if (caller.dst >= 0)
+                    regs[base + caller.dst] = res;
+                frames.pop_back();
+                break;
+            }
+            default:
+                error = "unexpected instruction in " + c->func->name;
+                return false;
+            }
+        }
+    }
+
+    // 与 sylib 的行为一致；读到文件末尾时 getint 返回 0，getch 返回 -1
+    bool callBuiltin(const Inst &inst, const vector<long> &argv, long &res)
+    {
+        switch (inst.builtin)
+        {
+        case GETINT:
+        {
+            int x = 0;
+            if (fscanf(in, "%d", &x) != 1)
+                x = 0;
+            res = x;
+            return true;
+        }
+        case GETCH:
+            res = fgetc(in);
+            return true;
+        case GETARRAY:
+        {
+            int n = 0;
+            if (fscanf(in, "%d", &n) != 1)
+                n = 0;
+            if (n > 0 && (argv[0] < 0 || argv[0] + n > sp))
+                break;
+            for (int i = 0; i < n; i++)
+            {
+                int x = 0;
+                if (fscanf(in, "%d", &x) != 1)
+                    x = 0;
+                mem[argv[0] + i] = x;
+            }
+            res = n;
+            return true;
+        }
+        case PUTINT:
+            fprintf(out, "%d", (int)argv[0]);
+            return true;
+        case PUTCH:
+            fputc((int)argv[0], out);
+            return true;
+        case PUTARRAY:
+        {
+            int n = argv[0];
+            if (n > 0 && (argv[1] < 0 || argv[1] + n > sp))
+                break;
+            fprintf(out, "%d:", n);
+            for (int i = 0; i < n; i++)
+                fprintf(out, " %d", mem[argv[1] + i]);
+            fputc('\n', out);
+            return true;
+        }
+        case STARTTIME:
+        case STOPTIME:
+            return true;
+        default:
+            error = "call to undefined function " + inst.callee->name;
+            return false;
+        }
+        error = "out-of-bounds memory access in " + inst.callee->name;
+        return false;
+    }
+
+    void collect(InterpProfile &profile) const
+    {
+        for (auto &p : codes)
+        {
+            const Code &c = *p.second;
+            profile.calls[c.func] = c.calls;
+            for (int i = 0; i < (int)c.execs.size(); i++)
+                profile.execs[c.func->bbs[i]] = c.execs[i];
+        }
+    }
+};
+
+bool Interpret(const IRProgram &program, FILE *in, FILE *out, InterpProfile &profile, string &error)
+{
+    const IRFunction *main_func = nullptr;
+    for (auto f : program.funcs)
+    {
+        if (f->name == "@main" && !f->isDecl())
+            main_func = f;
+    }
+    if (!main_func)
+    {
+        error = "no main function";
+        return false;
+    }
+    Interpreter interp(program, in, out);
+    bool ok = interp.run(main_func, profile.ret);
+    fflush(out);
+    interp.collect(profile);
+    error = interp.error;
+    return ok;
+}
+
+void InterpProfile::print(const IRProgram &program, Writer &out) const
+{
+    struct Count
+    {
+        long execs = 0, insts = 0, loads = 0, stores = 0, calls = 0;
+    };
+    auto line = [&](const string &name, const Count &n, bool show_execs) {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%-28s %12s %14ld %12ld %12ld %12ld\n", name.c_str(),
+                 show_execs ? to_string(n.execs).c_str() : "-", n.insts, n.loads, n.stores, n.calls);
+        out << buf;
+    };
+    auto find = [](auto &table, auto key) {
+        auto it = table.find(key);
+        return it == table.end() ? 0L : it->second;
+    };
+
+    out << "===== interpreter profile =====\n";
+    out << "main returned " << ret << '\n';
+    char head[256];
+    snprintf(head, sizeof(head), "%-28s %12s %14s %12s %12s %12s\n", "function / block", "execs", "insts", "loads",
+             "stores", "calls");
+    out << head;
+    Count total;
+    for (auto f : program.funcs)
+    {
+        if (f->isDecl())
+            continue;
+        // 基本块的动态计数 = 执行次数 x 块中的静态计数
+        Count func;
+        func.execs = find(calls, f);
+        vector<Count> blocks;
+        for (auto bb : f->bbs)
+        {
+            Count b;
+            b.execs = find(execs, bb);
+            for (int i = bb->phiCount(); i < (int)bb->insts.size(); i++)
+            {
+                IRValue::TAG tag = bb->insts[i]->tag;
+                b.insts += b.execs;
+                b.loads += tag == IRValue::LOAD ? b.execs : 0;
+                b.stores += tag == IRValue::STORE ? b.execs : 0;
+                b.calls += tag == IRValue::CALL ? b.execs : 0;
+            }
+            func.insts += b.insts;
+            func.loads += b.loads;
+            func.stores += b.stores;
+            func.calls += b.calls;
+            blocks.push_back(b);
+        }
+        line(f->name, func, true);
+        for (int i = 0; i < (int)f->bbs.size(); i++)
+            line("  " + f->bbs[i]->name, blocks[i], true);
+        total.insts += func.insts;
+        total.loads += func.loads;
+        total.stores += func.stores;
+        total.calls += func.calls;
+    }
+    line("total", total, false);
+}
@@ -0,0 +1,474 @@
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "include/ir.hpp"
+#include "../util.hpp"
+
+using namespace std;
+
+const char *op2koopa[] = {
+    "ne", "eq", "gt", "lt", "ge", "le",
+    "add", "sub", "mul", "div",
+    "mod", "and", "or", "xor",
+    "shl", "shr", "sar"};
+
+string IRType::toString() const
+{
+    switch (tag)
+    {
+    case INT32:
+        return "i32";
+    case UNIT:
+        return "";
+    case ARRAY:
+        return "[" + base->toString() + ", " + to_string(len) + "]";
+    case POINTER:
+        return "*" + base->toString();
+    default:
+    {
+        string ans = "(";
+        for (int i = 0; i < (int)params.size(); i++)
+        {
+            if (i)
+                ans += ", ";
+            ans += params[i]->toString();
+        }
+        ans += ")";
+        if (base->tag != UNIT)
+            ans += ": " + base->toString();
+        return ans;
+    }
+    }
+}
+
+bool FoldBinary(IRValue::OP op, int l, int r, int &res)
+{
+    uint32_t ul = l, ur = r;
+    switch (op)
+    {
+    case IRValue::NOT_EQ: res = l != r; break;
+    case IRValue::EQ: res = l == r; break;
+    case IRValue::GT: res = l > r; break;
+    case IRValue::LT: res = l < r; break;
+    case IRValue::GE: res = l >= r; break;
+    case IRValue::LE: res = l <= r; break;
+    case IRValue::ADD: res = ul + ur; break;
+    case IRValue::SUB: res = ul - ur; break;
+    case IRValue::MUL: res = ul * ur; break;
+    // INT_MIN / -1 与 RISC-V 的 div/rem 一致，不产生异常
+    case IRValue::DIV:
+        if (r == 0)
+            return false;
+        res = l == INT_MIN && r == -1 ? INT_MIN : l / r;
+        break;
+    case IRValue::MOD:
+        if (r == 0)
+            return false;
+        res = l == INT_MIN && r == -1 ? 0 : l % r;
+        break;
+    case IRValue::AND: res = l & r; break;
+    case IRValue::OR: res = l | r; break;
+    case IRValue::XOR: res = l ^ r; break;
+    case IRValue::SHL: res = ul << (r & 31); break;
+    case IRValue::SHR: res = ul >> (r & 31); break;
+    case IRValue::SAR: res = l >> (r & 31); break;
+    }
+    return true;
+}
+
+void IRValue::removeIncoming(const IRBasicBlock *pred)
+{
+    for (int i = 0; i < (int)targets.size(); i++)
+    {
+        if (targets[i] == pred)
+        {
+            if (ops[i]->isLocal())
+                ops[i]->removeUser(this);
+            ops.erase(ops.begin() + i);
+            targets.erase(targets.begin() + i);
+            return;
+        }
+    }
+}
+
+void IRValue::replaceAllUsesWith(IRValue *v)
+{
+    vector<IRValue *> old_users;
+    old_users.swap(users);
+    for (auto user : old_users)
+    {
+        for (auto &op : user->ops)
+        {
+            if (op == this)
+            {
+                op = v;
+                if (v->isLocal())
+                    v->users.push_back(user);
+            }
+        }
+    }
+}
+
+void IRFunction::buildCFG()
+{
+    for (auto bb : bbs)
+    {
+        bb->preds.clear();
+        bb->succs.clear();
+    }
+    for (auto bb : bbs)
+    {
+        IRValue *term = bb->terminator();
+        if (!term)
+            continue;
+        for (auto target : term->targets)
+        {
+            // br %c, %a, %a 只算一条边
+            if (bb->succs.size() && bb->succs.back() == target)
+                continue;
+            bb->succs.push_back(target);
+            target->preds.push_back(bb);
+        }
+    }
+}
+
+void IRFunction::removeBlock(IRBasicBlock *bb)
+{
+    if (IRValue *term = bb->terminator())
+    {
+        for (auto succ : term->targets)
+        {
+            for (int i = 0; i < succ->phiCount(); i++)
+                succ->insts[i]->removeIncoming(bb);
+        }
+    }
+    for (auto v : bb->insts)
+    {
+        v->dropOps();
+        v->bb = nullptr;
+    }
+    bb->insts.clear();
+    for (int i = 0; i < (int)bbs.size(); i++)
+    {
+        if (bbs[i] == bb)
+        {
+            bbs.erase(bbs.begin() + i);
+            break;
+        }
+    }
+}
+
+void IRFunction::eraseInsts(const unordered_set<IRValue *> &dead)
+{
+    for (auto v : dead)
+        v->dropOps();
+    for (auto bb : bbs)
+    {
+        int n = 0;
+        for (auto v : bb->insts)
+        {
+            if (dead.count(v))
+                v->bb = nullptr;
+            else
+                bb->insts[n++] = v;
+        }
+        bb->insts.resize(n);
+    }
+}
+
+// 输出一个函数时的上下文，负责给临时变量编号，所有内容直接写入 Writer
+class KoopaPrinter
+{
+private:
+    Writer &out;
+    unordered_map<const IRValue *, int> tmp_names;
+    int cnt = 0;
+
+public:
+    KoopaPrinter(Writer &_out) : out(_out) {}
+
+    // 输出操作数在 Koopa 中的写法
+    void operand(const IRValue *v)
+    {
+        switch (v->tag)
+        {
+        case IRValue::INTEGER:
+            out << v->value;
+            break;
+        case IRValue::ZERO_INIT:
+            out << "zeroinit";
+            break;
+        case IRValue::UNDEF:
+            out << "undef";
+            break;
+        case IRValue::AGGREGATE:
+            out << '{';
+            for (int i = 0; i < (int)v->ops.size(); i++)
+            {
+                if (i)
+                    out << ", ";
+                operand(v->ops[i]);
+            }
+            out << '}';
+            break;
+        default:
+            if (v->name.length())
+            {
+                out << v->name;
+                break;
+            }
+            auto it = tmp_names.find(v);
+            out << '%' << (it != tmp_names.end() ? it->second : (tmp_names[v] = cnt++));
+        }
+    }
+
+    // 跳转目标，phi 以基本块参数的形式传递，如 %end(%1, 2)
+    void target(const IRBasicBlock *from, const IRBasicBlock *to)
+    {
+        out << to->name;
+        int n = to->phiCount();
+        if (n == 0)
+            return;
+        out << '(';
+        for (int i = 0; i < n; i++)
+        {
+            if (i)
+                out << ", ";
+            const IRValue *v = to->insts[i]->getIncoming(from);
+            if (v)
+                operand(v);
+            else
+                out << "undef";
+        }
+        out << ')';
+    }
+
+    // 两个操作数的指令，如 store a, b
+    void twoOps(const char *op, const IRValue *v)
+    {
+        out << op << ' ';
+        operand(v->ops[0]);
+        out << ", ";
+        operand(v->ops[1]);
+    }
+
+    void inst(const IRValue *v)
+    {
+        // phi 已经作为基本块参数输出
+        if (v->tag == IRValue::PHI)
+            return;
+        out << "  ";
+        if (v->hasResult() && v->tag != IRValue::ALLOC)
+        {
+            operand(v);
+            out << " = ";
+        }
+        switch (v->tag)
+        {
+        case IRValue::ALLOC:
+            out << v->name << " = alloc " << v->ty->base->toString();
+            break;
+        case IRValue::LOAD:
+            out << "load ";
+            operand(v->ops[0]);
+            break;
+        case IRValue::STORE:
+            twoOps("store", v);
+            break;
+        case IRValue::GET_PTR:
+            twoOps("getptr", v);
+            break;
+        case IRValue::GET_ELEM_PTR:
+            twoOps("getelemptr", v);
+            break;
+        case IRValue::BINARY:
+            twoOps(op2koopa[v->op], v);
+            break;
+        case IRValue::BRANCH:
+            out << "br ";
+            operand(v->ops[0]);
+            out << ", ";
+            target(v->bb, v->targets[0]);
+            out << ", ";
+            target(v->bb, v->targets[1]);
+            break;
+        case IRValue::JUMP:
+            out << "jump ";
+            target(v->bb, v->targets[0]);
+            break;
+        case IRValue::CALL:
+            out << "call " << v->callee->name << '(';
+            for (int i = 0; i < (int)v->ops.size(); i++)
+            {
+                if (i)
+                    out << ", ";
+                operand(v->ops[i]);
+            }
+            out << ')';
+            break;
+        case IRValue::RETURN:
+            out << "ret";
+            if (v->ops.size())
+            {
+                out << ' ';
+                operand(v->ops[0]);
+            }
+            break;
+        default:
+            break;
+        }
+        out << '\n';
+    }
+
+    void global(const IRValue *g)
+    {
+        out << "global " << g->name << " = alloc " << g->ty->base->toString() << ", ";
+        operand(g->ops[0]);
+        out << '\n';
+    }
+
+    void func(const IRFunction *f)
+    {
+        const IRType *ty = f->ty;
+        if (f->isDecl())
+        {
+            out << "decl " << f->name << ty->toString() << '\n';
+            return;
+        }
+        out << "fun " << f->name << '(';
+        for (int i = 0; i < (int)f->params.size(); i++)
+        {
+            if (i)
+                out << ", ";
+            operand(f->params[i]);
+            out << ": " << f->params[i]->ty->toString();
+        }
+        out << ')';
+        if (ty->base->tag != IRType::UNIT)
+            out << ": " << ty->base->toString();
+        out << " {\n";
+        for (auto bb : f->bbs)
+        {
+            out << bb->name;
+            int n = bb->phiCount();
+            if (n)
+            {
+                out << '(';
+                for (int i = 0; i < n; i++)
+                {
+                    if (i)
+                        out << ", ";
+                    operand(bb->insts[i]);
+                    out << ": " << bb->insts[i]->ty->toString();
+                }
+                out << ')';
+            }
+            out << ":\n";
+            for (auto v : bb->insts)
+                inst(v);
+        }
+        out << "}\n\n";
+    }
+};
+
+void DumpKoopa(const IRProgram &program, Writer &out)
+{
+    // 库函数声明
+    bool has_decl = false;
+    for (auto f : program.funcs)
+    {
+        if (f->isDecl())
+        {
+            KoopaPrinter(out).func(f);
+            has_decl = true;
+        }
+    }
+    if (has_decl)
+        out << '\n';
+
+    // 全局变量
+    KoopaPrinter global_printer(out);
+    for (auto g : program.globals)
+        global_printer.global(g);
+    if (program.globals.size())
+        out << '\n';
+
+    // 函数定义
+    for (auto f : program.funcs)
+    {
+        if (f->isDecl())
+            continue;
+        if (f->record)
+        {
+            Writer func_out(&f->output);
+            KoopaPrinter(func_out).func(f);
+        }
+        if (f->reused || f->record)
+            out << f->output;
+        else
+            KoopaPrinter(out).func(f);
+    }
+}
+
+// 超出短字符串优化的部分单独分配
+static size_t stringBytes(const string &s)
+{
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+static size_t valueBytes(const IRValue *v)
+{
+    return sizeof(IRValue) + sizeof(void *) + stringBytes(v->name) +
+           (v->ops.capacity() + v->targets.capacity() + v->users.capacity()) * sizeof(void *);
+}
+
+size_t IRProgram::memoryUsage() const
+{
+    // 哈希表和平衡树的每个结点大约多出两个指针
+    const size_t node = 2 * sizeof(void *);
+    size_t n = sizeof(IRProgram) + (globals.capacity() + funcs.capacity()) * sizeof(void *);
+    for (auto &ty : type_pool)
+        n += sizeof(IRType) + sizeof(void *) + ty->params.capacity() * sizeof(void *);
+    for (auto &v : value_pool)
+        n += valueBytes(v.get());
+    n += array_tys.size() * (sizeof(pair<pair<IRType *, int>, IRType *>) + node + sizeof(void *));
+    n += pointer_tys.size() * (sizeof(pair<IRType *, IRType *>) + node) + pointer_tys.bucket_count() * sizeof(void *);
+    n += ints.size() * (sizeof(pair<int, IRValue *>) + node) + ints.bucket_count() * sizeof(void *);
+    for (auto &f : func_pool)
+    {
+        n += sizeof(IRFunction) + sizeof(void *) + stringBytes(f->name) +
+             (f->params.capacity() + f->bbs.capacity() + f->value_pool.capacity() + f->bb_pool.capacity()) * sizeof(void *);
+        for (auto &v : f->value_pool)
+            n += valueBytes(v.get());
+        for (auto &bb : f->bb_pool)
+            n += sizeof(IRBasicBlock) + stringBytes(bb->name) +
+                 (bb->insts.capacity() + bb->preds.capacity() + bb->succs.capacity()) * sizeof(void *);
+    }
+    return n;
+}
+
+string FunctionFingerprint(const IRFunction *f)
+{
+    string text;
+    Writer out(&text);
+    KoopaPrinter printer(out);
+    unordered_set<const void *> seen;
+    for (auto bb : f->bbs)
+    {
+        for (auto v : bb->insts)
+        {
+            if (v->tag == IRValue::CALL && seen.insert(v->callee).second)
+                out << "decl " << v->callee->name << v->callee->ty->toString() << '\n';
+            for (auto op : v->ops)
+            {
+                if (op->tag == IRValue::GLOBAL_ALLOC && seen.insert(op).second)
+                    printer.global(op);
+            }
+        }
+    }
+    KoopaPrinter(out).func(f);
+    out.flush();
+    return text;
+}
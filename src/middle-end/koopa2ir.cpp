@@ -0,0 +1,279 @@
+#include <cassert>
+#include <string>
+#include <unordered_map>
+#include "../koopa.h"
+#include "include/ir.hpp"
+
+using namespace std;
+
+// 将 libkoopa 的 raw program 转换为可修改的 IR
+// 先为每个函数创建所有基本块和指令，再填写操作数，这样前向引用（如循环中的 phi）也能找到对应的值
+class KoopaImporter
+{
+private:
+    IRProgram &prog;
+    unordered_map<koopa_raw_value_t, IRValue *> values;
+    unordered_map<koopa_raw_function_t, IRFunction *> funcs;
+    unordered_map<koopa_raw_basic_block_t, IRBasicBlock *> bbs;
+
+    static const void *item(const koopa_raw_slice_t &slice, int i)
+    {
+        return slice.buffer[i];
+    }
+
+    IRType *type(koopa_raw_type_t ty)
+    {
+        switch (ty->tag)
+        {
+        case KOOPA_RTT_INT32:
+            return prog.getInt();
+        case KOOPA_RTT_UNIT:
+            return prog.getUnit();
+        case KOOPA_RTT_ARRAY:
+            return prog.getArray(type(ty->data.array.base), ty->data.array.len);
+        case KOOPA_RTT_POINTER:
+            return prog.getPointer(type(ty->data.pointer.base));
+        default:
+        {
+            vector<IRType *> params;
+            const koopa_raw_slice_t &slice = ty->data.function.params;
+            for (int i = 0; i < (int)slice.len; i++)
+                params.push_back(type((koopa_raw_type_t)item(slice, i)));
+            return prog.getFunction(params, type(ty->data.function.ret));
+        }
+        }
+    }
+
+    // 只保留 @ 开头的名字，% 开头的临时变量在输出时重新编号
+    static string name(koopa_raw_value_t raw)
+    {
+        if (raw->name && raw->name[0] == '@')
+            return raw->name;
+        return "";
+    }
+
+    // 查找操作数，常量按需创建
+    IRValue *value(koopa_raw_value_t raw)
+    {
+        auto it = values.find(raw);
+        if (it != values.end())
+            return it->second;
+        const auto &kind = raw->kind;
+        IRValue *val;
+        switch (kind.tag)
+        {
+        case KOOPA_RVT_INTEGER:
+            return prog.getInteger(kind.data.integer.value);
+        case KOOPA_RVT_ZERO_INIT:
+            val = prog.getZeroInit(type(raw->ty));
+            break;
+        case KOOPA_RVT_UNDEF:
+            val = prog.getUndef(type(raw->ty));
+            break;
+        case KOOPA_RVT_AGGREGATE:
+        {
+            vector<IRValue *> elems;
+            const koopa_raw_slice_t &slice = kind.data.aggregate.elems;
+            for (int i = 0; i < (int)slice.len; i++)
+                elems.push_back(value((koopa_raw_value_t)item(slice, i)));
+            val = prog.getAggregate(type(raw->ty), elems);
+            break;
+        }
+        default:
+            // 指令和参数都应该已经创建
+            assert(false);
+            return nullptr;
+        }
+        values[raw] = val;
+        return val;
+    }
+
+    // 为跳转参数添加 phi 的传入值
+    void addIncoming(IRBasicBlock *from, koopa_raw_basic_block_t to, const koopa_raw_slice_t &args)
+    {
+        IRBasicBlock *target = bbs[to];
+        for (int i = 0; i < (int)args.len; i++)
+            target->insts[i]->addIncoming(value((koopa_raw_value_t)item(args, i)), from);
+    }
+
+    void fillOps(IRValue *val, koopa_raw_value_t raw)
+    {
+        const auto &data = raw->kind.data;
+        switch (raw->kind.tag)
+        {
+        case KOOPA_RVT_LOAD:
+            val->addOp(value(data.load.src));
+            break;
+        case KOOPA_RVT_STORE:
+            val->addOp(value(data.store.value));
+            val->addOp(value(data.store.dest));
+            break;
+        case KOOPA_RVT_GET_PTR:
+            val->addOp(value(data.get_ptr.src));
+            val->addOp(value(data.get_ptr.index));
+            break;
+        case KOOPA_RVT_GET_ELEM_PTR:
+            val->addOp(value(data.get_elem_ptr.src));
+            val->addOp(value(data.get_elem_ptr.index));
+            break;
+        case KOOPA_RVT_BINARY:
+            val->op = (IRValue::OP)data.binary.op;
+            val->addOp(value(data.binary.lhs));
+            val->addOp(value(data.binary.rhs));
+            break;
+        case KOOPA_RVT_BRANCH:
+            val->addOp(value(data.branch.cond));
+            val->targets = {bbs[data.branch.true_bb], bbs[data.branch.false_bb]};
+            addIncoming(val->bb, data.branch.true_bb, data.branch.true_args);
+            addIncoming(val->bb, data.branch.false_bb, data.branch.false_args);
+            break;
+        case KOOPA_RVT_JUMP:
+            val->targets = {bbs[data.jump.target]};
+            addIncoming(val->bb, data.jump.target, data.jump.args);
+            break;
+        case KOOPA_RVT_CALL:
+            val->callee = funcs[data.call.callee];
+            for (int i = 0; i < (int)data.call.args.len; i++)
+                val->addOp(value((koopa_raw_value_t)item(data.call.args, i)));
+            break;
+        case KOOPA_RVT_RETURN:
+            if (data.ret.value)
+                val->addOp(value(data.ret.value));
+            break;
+        default:
+            break;
+        }
+    }
+
+    // 与 IRValue::TAG 一一对应，FUNC_ARG_REF/BLOCK_ARG_REF 单独处理
+    static IRValue::TAG tag(koopa_raw_value_tag_t t)
+    {
+        switch (t)
+        {
+        case KOOPA_RVT_ALLOC:
+            return IRValue::ALLOC;
+        case KOOPA_RVT_LOAD:
+            return IRValue::LOAD;
+        case KOOPA_RVT_STORE:
+            return IRValue::STORE;
+        case KOOPA_RVT_GET_PTR:
+            return IRValue::GET_PTR;
+        case KOOPA_RVT_GET_ELEM_PTR:
+            return IRValue::GET_ELEM_PTR;
+        case KOOPA_RVT_BINARY:
+            return IRValue::BINARY;
+        case KOOPA_RVT_BRANCH:
+            return IRValue::BRANCH;
+        case KOOPA_RVT_JUMP:
+            return IRValue::JUMP;
+        case KOOPA_RVT_CALL:
+            return IRValue::CALL;
+        default:
+            return IRValue::RETURN;
+        }
+    }
+
+    void function(koopa_raw_function_t raw)
+    {
+        IRFunction *func = funcs[raw];
+        for (int i = 0; i < (int)raw->params.len; i++)
+        {
+            auto param = (koopa_raw_value_t)item(raw->params, i);
+            IRValue *arg = func->newValue(IRValue::FUNC_ARG, type(param->ty));
+            arg->name = name(param);
+            arg->value = i;
+            func->params.push_back(arg);
+            values[param] = arg;
+        }
+
+        // 第一遍：创建基本块、phi 和指令
+        for (int i = 0; i < (int)raw->bbs.len; i++)
+        {
+            auto raw_bb = (koopa_raw_basic_block_t)item(raw->bbs, i);
+            IRBasicBlock *bb = func->newBlock(raw_bb->name ? raw_bb->name : "%bb" + to_string(i));
+            func->bbs.push_back(bb);
+            bbs[raw_bb] = bb;
+            for (int j = 0; j < (int)raw_bb->params.len; j++)
+            {
+                auto param = (koopa_raw_value_t)item(raw_bb->params, j);
+                IRValue *phi = func->newValue(IRValue::PHI, type(param->ty));
+                bb->insert(j, phi);
+                values[param] = phi;
+            }
+            for (int j = 0; j < (int)raw_bb->insts.len; j++)
+            {
+                auto inst = (koopa_raw_value_t)item(raw_bb->insts, j);
+                IRValue *val = func->newValue(tag(inst->kind.tag), type(inst->ty));
+                val->name = name(inst);
+                bb->insert(bb->insts.size(), val);
+                values[inst] = val;
+            }
+        }
+
+        // 第二遍：填写操作数和跳转目标
+        for (int i = 0; i < (int)raw->bbs.len; i++)
+        {
+            auto raw_bb = (koopa_raw_basic_block_t)item(raw->bbs, i);
+            IRBasicBlock *bb = bbs[raw_bb];
+            int n = raw_bb->params.len;
+            for (int j = 0; j < (int)raw_bb->insts.len; j++)
+            {
+                auto inst = (koopa_raw_value_t)item(raw_bb->insts, j);
+                fillOps(bb->insts[n + j], inst);
+            }
+        }
+        func->buildCFG();
+    }
+
+public:
+    KoopaImporter(IRProgram &_prog) : prog(_prog) {}
+
+    void import(const koopa_raw_program_t &raw)
+    {
+        for (int i = 0; i < (int)raw.values.len; i++)
+        {
+            auto g = (koopa_raw_value_t)item(raw.values, i);
+            IRValue *val = prog.newValue(IRValue::GLOBAL_ALLOC, type(g->ty));
+            val->name = g->name;
+            val->addOp(value(g->kind.data.global_alloc.init));
+            prog.globals.push_back(val);
+            values[g] = val;
+        }
+        // 先创建所有函数，函数之间可以互相调用
+        for (int i = 0; i < (int)raw.funcs.len; i++)
+        {
+            auto f = (koopa_raw_function_t)item(raw.funcs, i);
+            funcs[f] = prog.newFunction(f->name, type(f->ty));
+        }
+        for (int i = 0; i < (int)raw.funcs.len; i++)
+        {
+            auto f = (koopa_raw_function_t)item(raw.funcs, i);
+            if (f->bbs.len)
+                function(f);
+        }
+    }
+};
+
+// 读取文本形式的 Koopa IR 文件，构建到 program 中；文件无法读取或不是合法的 Koopa IR 时在 error 中给出原因并返回 false
+bool ImportKoopa(const char *path, IRProgram &program, string &error)
+{
+    koopa_program_t koopa;
+    koopa_error_code_t ret = koopa_parse_from_file(path, &koopa);
+    if (ret != KOOPA_EC_SUCCESS)
+    {
+        if (ret == KOOPA_EC_INVALID_FILE || ret == KOOPA_EC_IO_ERROR)
+            error = "cannot read the file";
+        else if (ret == KOOPA_EC_INVALID_KOOPA_PROGRAM)
+            error = "invalid Koopa IR program";
+        else
+            error = "libkoopa error " + to_string(ret);
+        return false;
+    }
+    koopa_raw_program_builder_t builder = koopa_new_raw_program_builder();
+    koopa_raw_program_t raw = koopa_build_raw_program(builder, koopa);
+    koopa_delete_program(koopa);
+    KoopaImporter(program).import(raw);
+    // IR 中不再引用 raw program 的内存，可以立即释放
+    koopa_delete_raw_program_builder(builder);
+    return true;
+}
@@ -0,0 +1,253 @@
+#include <unordered_map>
+#include <unordered_set>
+#include "include/pass.hpp"
+#include "include/dominance.hpp"
+
+using namespace std;
+
+// 将只被直接 load/store 的局部变量提升为 SSA 值
+// 1. 在每个 store 所在块的迭代支配边界处插入 phi
+// 2. 沿支配树先序遍历，用每个变量当前的值替换 load，并填写后继中 phi 的传入值
+// 3. 删除无用和平凡的 phi
+// 依赖 simplifycfg 先删除不可达的基本块
+class Mem2Reg : public FunctionPass
+{
+private:
+    // 变量的地址没有逃逸：只作为 load 的地址或 store 的目的地址使用
+    static bool promotable(IRValue *alloc)
+    {
+        if (alloc->ty->base->tag == IRType::ARRAY)
+            return false;
+        for (auto user : alloc->users)
+        {
+            if (user->tag == IRValue::LOAD)
+                continue;
+            if (user->tag == IRValue::STORE && user->ops[1] == alloc && user->ops[0] != alloc)
+                continue;
+            return false;
+        }
+        return true;
+    }
+
+    // 所有传入值都相同（不计自身）的 phi 可以直接用该值替换
+    static IRValue *trivialValue(IRValue *phi)
+    {
+        IRValue *same = nullptr;
+        for (auto v : phi->ops)
+        {
+            if (v == phi || v == same)
+                continue;
+            if (same)
+                return nullptr;
+            same = v;
+        }
+        return same;
+    }
+
+    static void removePhis(IRFunction *func, const vector<IRValue *> &phis)
+    {
+        unordered_set<IRValue *> removed;
+
+        // 平凡的 phi 替换后，使用它的 phi 可能也变为平凡的
+        vector<IRValue *> worklist = phis;
+        while (worklist.size())
+        {
+            IRValue *phi = worklist.back();
+            worklist.pop_back();
+            if (removed.count(phi))
+                continue;
+            IRValue *same = trivialValue(phi);
+            if (!same)
+                continue;
+            vector<IRValue *> users = phi->users;
+            phi->replaceAllUsesWith(same);
+            phi->dropOps();
+            removed.insert(phi);
+            for (auto user : users)
+            {
+                if (user->tag == IRValue::PHI && user != phi)
+                    worklist.push_back(user);
+            }
+        }
+
+        // 只被 phi 使用的 phi（如循环中没有读过的变量）也是无用的
+        unordered_set<IRValue *> live;
+        for (auto phi : phis)
+        {
+            if (removed.count(phi))
+                continue;
+            for (auto user : phi->users)
+            {
+                if (user->tag != IRValue::PHI)
+                {
+                    worklist.push_back(phi);
+                    live.insert(phi);
+                    break;
+                }
+            }
+        }
+        while (worklist.size())
+        {
+            IRValue *phi = worklist.back();
+            worklist.pop_back();
+            for (auto v : phi->ops)
+            {
+                if (v->tag == IRValue::PHI && live.insert(v).second)
+                    worklist.push_back(v);
+            }
+        }
+        for (auto phi : phis)
+        {
+            if (!live.count(phi))
+                removed.insert(phi);
+        }
+        func->eraseInsts(removed);
+    }
+
+public:
+    const char *name() const override { return "mem2reg"; }
+
+    bool run(IRFunction *func) override
+    {
+        // 前端把所有 alloc 都放在了入口块
+        vector<IRValue *> allocs;
+        unordered_map<IRValue *, int> alloc_id;
+        for (auto v : func->entry()->insts)
+        {
+            if (v->tag == IRValue::ALLOC && promotable(v))
+            {
+                alloc_id[v] = allocs.size();
+                allocs.push_back(v);
+            }
+        }
+        if (allocs.empty())
+            return false;
+
+        func->buildCFG();
+        DominatorTree dt(func);
+        int n = dt.rpo.size();
+
+        // 插入 phi
+        unordered_map<IRValue *, int> phi_id;
+        vector<IRValue *> phis;
+        for (int i = 0; i < (int)allocs.size(); i++)
+        {
+            vector<bool> has_phi(n), visited(n);
+            vector<int> worklist;
+            for (auto user : allocs[i]->users)
+            {
+                int b = dt.index[user->bb];
+                if (user->tag == IRValue::STORE && !visited[b])
+                {
+                    visited[b] = true;
+                    worklist.push_back(b);
+                }
+            }
+            while (worklist.size())
+            {
+                int b = worklist.back();
+                worklist.pop_back();
+                for (int d : dt.frontier[b])
+                {
+                    if (has_phi[d])
+                        continue;
+                    has_phi[d] = true;
+                    IRBasicBlock *bb = dt.rpo[d];
+                    IRValue *phi = func->newValue(IRValue::PHI, allocs[i]->ty->base);
+                    bb->insert(bb->phiCount(), phi);
+                    phi_id[phi] = i;
+                    phis.push_back(phi);
+                    if (!visited[d])
+                    {
+                        visited[d] = true;
+                        worklist.push_back(d);
+                    }
+                }
+            }
+        }
+
+        // 变量重命名，stacks[i] 的栈顶为变量 i 的当前值
+        // 未初始化的变量读出 0，比 undef 更便于后续的 pass 和后端处理
+        vector<vector<IRValue *>> stacks(allocs.size());
+        for (int i = 0; i < (int)allocs.size(); i++)
+        {
+            IRType *ty = allocs[i]->ty->base;
+            stacks[i].push_back(ty->tag == IRType::INT32 ? func->prog->getInteger(0) : func->prog->getUndef(ty));
+        }
+        vector<int> pushed;     // 依次入栈的变量，退出基本块时据此出栈
+        unordered_set<IRValue *> dead;
+        // 非递归的支配树先序遍历，second 为退出该块时 pushed 应恢复的大小，-1 表示进入
+        vector<pair<int, int>> walk = {{0, -1}};
+        while (walk.size())
+        {
+            auto [b, mark] = walk.back();
+            walk.pop_back();
+            if (mark != -1)
+            {
+                while ((int)pushed.size() > mark)
+                {
+                    stacks[pushed.back()].pop_back();
+                    pushed.pop_back();
+                }
+                continue;
+            }
+            walk.push_back({b, (int)pushed.size()});
+
+            IRBasicBlock *bb = dt.rpo[b];
+            for (auto v : bb->insts)
+            {
+                if (v->tag == IRValue::PHI)
+                {
+                    auto it = phi_id.find(v);
+                    if (it != phi_id.end())
+                    {
+                        stacks[it->second].push_back(v);
+                        pushed.push_back(it->second);
+                    }
+                }
+                else if (v->tag == IRValue::LOAD)
+                {
+                    auto it = alloc_id.find(v->ops[0]);
+                    if (it != alloc_id.end())
+                    {
+                        v->replaceAllUsesWith(stacks[it->second].back());
+                        dead.insert(v);
+                    }
+                }
+                else if (v->tag == IRValue::STORE)
+                {
+                    auto it = alloc_id.find(v->ops[1]);
+                    if (it != alloc_id.end())
+                    {
+                        stacks[it->second].push_back(v->ops[0]);
+                        pushed.push_back(it->second);
+                        dead.insert(v);
+                    }
+                }
+            }
+            for (auto succ : bb->succs)
+            {
+                int cnt = succ->phiCount();
+                for (int i = 0; i < cnt; i++)
+                {
+                    auto it = phi_id.find(succ->insts[i]);
+                    if (it != phi_id.end())
+                        succ->insts[i]->addIncoming(stacks[it->second].back(), bb);
+                }
+            }
+            for (int child : dt.children[b])
+                walk.push_back({child, -1});
+        }
+
+        for (auto alloc : allocs)
+            dead.insert(alloc);
+        func->eraseInsts(dead);
+        removePhis(func, phis);
+        return true;
+    }
+};
+
+FunctionPass *createMem2RegPass()
+{
+    return new Mem2Reg();
+}
@@ -0,0 +1,14 @@
+#include "include/pass.hpp"
+
+using namespace std;
+
+void BuildPipeline(PassManager &pm, int opt_level)
+{
+    if (opt_level <= 0)
+        return;
+    pm.add(createSimplifyCFGPass());
+    pm.add(createMem2RegPass());
+    pm.add(createSCCPPass());
+    pm.add(createGVNPass());
+    pm.add(createDCEPass());
+}
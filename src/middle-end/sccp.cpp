@@ -0,0 +1,276 @@
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include "include/pass.hpp"
+
+using namespace std;
+
+// 稀疏条件常量传播（Wegman-Zadeck）
+// 同时在控制流边和 SSA 的 use-def 链上传播：只有可执行的边传入的值参与 phi 的合并，条件为常量的分支只有一条出边可执行
+// 结束后把值为常量的指令替换为常量，条件为常量的分支改为 jump，删除不可执行的基本块
+// 依赖 mem2reg 先把局部变量提升为 SSA 值
+class SCCP : public FunctionPass
+{
+private:
+    // 格：UNKNOWN（还没有确定的值，或来自 undef）< CONSTANT < OVERDEFINED（不是常量）
+    struct Lattice
+    {
+        enum STATE
+        {
+            UNKNOWN,
+            CONSTANT,
+            OVERDEFINED
+        };
+        STATE state = UNKNOWN;
+        int value = 0;
+
+        bool operator!=(const Lattice &o) const
+        {
+            return state != o.state || (state == CONSTANT && value != o.value);
+        }
+    };
+
+    // 一次运行的状态，pass 对象可能同时处理多个函数
+    struct Solver
+    {
+        unordered_map<IRValue *, Lattice> values;
+        unordered_set<IRBasicBlock *> executable;
+        set<pair<IRBasicBlock *, IRBasicBlock *>> edges;      // 可执行的边
+        unordered_set<IRValue *> forced;                      // 条件一直未确定、强制两条出边都可执行的分支
+        vector<IRValue *> ssa_work;
+        vector<pair<IRBasicBlock *, IRBasicBlock *>> flow_work;
+
+        Lattice get(IRValue *v)
+        {
+            Lattice l;
+            if (v->tag == IRValue::INTEGER)
+            {
+                l.state = Lattice::CONSTANT;
+                l.value = v->value;
+            }
+            else if (v->tag == IRValue::UNDEF)
+                l.state = Lattice::UNKNOWN;
+            else if (!v->isLocal() || v->tag == IRValue::FUNC_ARG)
+                l.state = Lattice::OVERDEFINED;
+            else
+                l = values[v];
+            return l;
+        }
+
+        void update(IRValue *v, Lattice l)
+        {
+            Lattice &old = values[v];
+            if (old != l)
+            {
+                old = l;
+                ssa_work.push_back(v);
+            }
+        }
+
+        void markEdge(IRBasicBlock *from, IRBasicBlock *to)
+        {
+            if (edges.insert({from, to}).second)
+                flow_work.push_back({from, to});
+        }
+
+        // 合并两个格值
+        static Lattice meet(Lattice a, Lattice b)
+        {
+            if (a.state == Lattice::UNKNOWN)
+                return b;
+            if (b.state == Lattice::UNKNOWN)
+                return a;
+            if (a.state == Lattice::CONSTANT && b.state == Lattice::CONSTANT && a.value == b.value)
+                return a;
+            Lattice over;
+            over.state = Lattice::OVERDEFINED;
+            return over;
+        }
+
+        void visit(IRValue *v)
+        {
+            IRBasicBlock *bb = v->bb;
+            if (!bb || !executable.count(bb))
+                return;
+            switch (v->tag)
+            {
+            case IRValue::PHI:
+            {
+                Lattice l;
+                for (int i = 0; i < (int)v->ops.size(); i++)
+                {
+                    if (edges.count({v->targets[i], bb}))
+                        l = meet(l, get(v->ops[i]));
+                }
+                update(v, l);
+                break;
+            }
+            case IRValue::BINARY:
+            {
+                Lattice lhs = get(v->ops[0]), rhs = get(v->ops[1]), l;
+                if (lhs.state == Lattice::CONSTANT && rhs.state == Lattice::CONSTANT)
+                {
+                    // 除以常量 0 留到运行时，不在编译时折叠
+                    l.state = FoldBinary(v->op, lhs.value, rhs.value, l.value) ? Lattice::CONSTANT
+                                                                              : Lattice::OVERDEFINED;
+                }
+                else if (lhs.state == Lattice::OVERDEFINED || rhs.state == Lattice::OVERDEFINED)
+                    l.state = Lattice::OVERDEFINED;
+                update(v, l);
+                break;
+            }
+            case IRValue::BRANCH:
+            {
+                Lattice cond = get(v->ops[0]);
+                if (cond.state == Lattice::OVERDEFINED || forced.count(v))
+                {
+                    markEdge(bb, v->targets[0]);
+                    markEdge(bb, v->targets[1]);
+                }
+                else if (cond.state == Lattice::CONSTANT)
+                    markEdge(bb, v->targets[cond.value ? 0 : 1]);
+                break;
+            }
+            case IRValue::JUMP:
+                markEdge(bb, v->targets[0]);
+                break;
+            default:
+                if (v->hasResult())
+                {
+                    Lattice over;
+                    over.state = Lattice::OVERDEFINED;
+                    update(v, over);
+                }
+                break;
+            }
+        }
+
+        void solve(IRFunction *func)
+        {
+            executable.insert(func->entry());
+            for (auto v : func->entry()->insts)
+                visit(v);
+            while (true)
+            {
+                while (flow_work.size() || ssa_work.size())
+                {
+                    while (flow_work.size())
+                    {
+                        auto edge = flow_work.back();
+                        flow_work.pop_back();
+                        IRBasicBlock *to = edge.second;
+                        if (executable.insert(to).second)
+                        {
+                            for (auto v : to->insts)
+                                visit(v);
+                        }
+                        else
+                        {
+                            // 新的可执行边只影响目标块的 phi
+                            for (int i = 0; i < to->phiCount(); i++)
+                                visit(to->insts[i]);
+                        }
+                    }
+                    while (ssa_work.size())
+                    {
+                        IRValue *v = ssa_work.back();
+                        ssa_work.pop_back();
+                        for (auto user : v->users)
+                            visit(user);
+                    }
+                }
+                // 条件来自 undef 的分支到最后也没有可执行的出边，把两条边都标记为可执行后继续传播
+                bool resolved = false;
+                for (auto bb : func->bbs)
+                {
+                    IRValue *term = bb->terminator();
+                    if (executable.count(bb) && term && term->tag == IRValue::BRANCH &&
+                        get(term->ops[0]).state == Lattice::UNKNOWN && forced.insert(term).second)
+                    {
+                        visit(term);
+                        resolved = true;
+                    }
+                }
+                if (!resolved)
+                    break;
+            }
+        }
+    };
+
+public:
+    const char *name() const override { return "sccp"; }
+
+    bool run(IRFunction *func) override
+    {
+        Solver solver;
+        solver.solve(func);
+        IRProgram *program = func->prog;
+        bool changed = false;
+
+        // 值为常量的指令替换为常量后删除
+        unordered_set<IRValue *> folded;
+        for (auto bb : func->bbs)
+        {
+            if (!solver.executable.count(bb))
+                continue;
+            for (auto v : bb->insts)
+            {
+                if (v->tag != IRValue::PHI && v->tag != IRValue::BINARY)
+                    continue;
+                Lattice l = solver.get(v);
+                if (l.state != Lattice::CONSTANT)
+                    continue;
+                v->replaceAllUsesWith(program->getInteger(l.value));
+                folded.insert(v);
+            }
+        }
+
+        // 条件为常量的分支改为 jump，另一个后继中的 phi 不再有来自这里的值
+        for (auto bb : func->bbs)
+        {
+            IRValue *term = bb->terminator();
+            if (!solver.executable.count(bb) || !term || term->tag != IRValue::BRANCH || solver.forced.count(term))
+                continue;
+            Lattice cond = solver.get(term->ops[0]);
+            if (cond.state != Lattice::CONSTANT)
+                continue;
+            IRBasicBlock *taken = term->targets[cond.value ? 0 : 1];
+            IRBasicBlock *other = term->targets[cond.value ? 1 : 0];
+            if (other != taken)
+            {
+                for (int i = 0; i < other->phiCount(); i++)
+                    other->insts[i]->removeIncoming(bb);
+            }
+            term->dropOps();
+            term->tag = IRValue::JUMP;
+            term->targets = {taken};
+            changed = true;
+        }
+
+        // 删除不可执行的基本块，它们之间可能互相使用结果，先断开所有操作数
+        vector<IRBasicBlock *> dead;
+        for (auto bb : func->bbs)
+        {
+            if (!solver.executable.count(bb))
+                dead.push_back(bb);
+        }
+        for (auto bb : dead)
+        {
+            for (auto v : bb->insts)
+                v->dropOps();
+        }
+        for (auto bb : dead)
+            func->removeBlock(bb);
+
+        if (folded.size())
+            func->eraseInsts(folded);
+        if (changed || dead.size())
+            func->buildCFG();
+        return changed || dead.size() || folded.size();
+    }
+};
+
+FunctionPass *createSCCPPass()
+{
+    return new SCCP();
+}
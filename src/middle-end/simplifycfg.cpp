@@ -0,0 +1,53 @@
+#include <unordered_set>
+#include "include/pass.hpp"
+
+using namespace std;
+
+class SimplifyCFG : public FunctionPass
+{
+public:
+    const char *name() const override { return "simplifycfg"; }
+
+    bool run(IRFunction *func) override
+    {
+        func->buildCFG();
+        // 从入口开始标记所有可达的基本块
+        unordered_set<IRBasicBlock *> reachable;
+        vector<IRBasicBlock *> worklist = {func->entry()};
+        reachable.insert(func->entry());
+        while (worklist.size())
+        {
+            IRBasicBlock *bb = worklist.back();
+            worklist.pop_back();
+            for (auto succ : bb->succs)
+            {
+                if (reachable.insert(succ).second)
+                    worklist.push_back(succ);
+            }
+        }
+        if (reachable.size() == func->bbs.size())
+            return false;
+
+        vector<IRBasicBlock *> dead;
+        for (auto bb : func->bbs)
+        {
+            if (!reachable.count(bb))
+                dead.push_back(bb);
+        }
+        // 不可达的块之间可能互相使用结果，先断开所有操作数再删除
+        for (auto bb : dead)
+        {
+            for (auto v : bb->insts)
+                v->dropOps();
+        }
+        for (auto bb : dead)
+            func->removeBlock(bb);
+        func->buildCFG();
+        return true;
+    }
+};
+
+FunctionPass *createSimplifyCFGPass()
+{
+    return new SimplifyCFG();
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "compiler.hpp"
+#include "driver.hpp"
+#include "threadpool.hpp"
+
+using namespace std;
+
+static const long MAX_SOURCE = 64L * 1024 * 1024;  // 单个请求的源程序上限
+static const int IDLE_TIMEOUT = 10;                 // 连接空闲超过这么多秒后关闭，让出工作线程
+
+// 每个工作线程一个常驻的 context，请求之间只 reset，保留内存和驻留的标识符
+static thread_local unique_ptr<CompilerContext> warm_ctx;
+
+// 一个连接的读缓冲区，请求头按行读取，源程序按字节数读取
+struct Connection
+{
+    int fd;
+    char buf[4096];
+    size_t pos = 0, len = 0;
+
+    Connection(int _fd) : fd(_fd) {}
+
+    bool fill()
+    {
+        while (true)
+        {
+            ssize_t r = read(fd, buf, sizeof(buf));
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0)
+                return false;
+            pos = 0;
+            len = r;
+            return true;
+        }
+    }
+
+    bool readLine(string &line)
+    {
+        line.clear();
+        while (true)
+        {
+            if (pos == len && !fill())
+                return false;
+            char c = buf[pos++];
+            if (c == '\n')
+                return true;
+            if (line.size() >= 256)
+                return false;
+            line += c;
+        }
+    }
+
+    bool readBytes(char *p, size_t n)
+    {
+        while (n)
+        {
+            if (pos == len && !fill())
+                return false;
+            size_t k = min(n, len - pos);
+            memcpy(p, buf + pos, k);
+            pos += k;
+            p += k;
+            n -= k;
+        }
+        return true;
+    }
+
+    bool writeAll(const string &s)
+    {
+        const char *p = s.data();
+        size_t n = s.size();
+        while (n)
+        {
+            // 客户端提前断开时不产生 SIGPIPE
+            ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0)
+                return false;
+            p += r;
+            n -= r;
+        }
+        return true;
+    }
+
+    bool reply(bool ok, const string &body)
+    {
+        return writeAll((ok ? "ok " : "error ") + to_string(body.size()) + "\n") && writeAll(body);
+    }
+};
+
+// 依次处理一个连接上的请求，直到客户端关闭连接、请求格式错误或空闲超时
+static void serve(int fd)
+{
+    timeval tv = {IDLE_TIMEOUT, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    Connection conn(fd);
+    string line, src;
+    while (conn.readLine(line))
+    {
+        char mode_str[16];
+        int opt_level;
+        long n;
+        CompileMode mode;
+        if (sscanf(line.c_str(), "%15s %d %ld", mode_str, &opt_level, &n) != 3 || n < 0 || n > MAX_SOURCE)
+        {
+            conn.reply(false, "bad request: " + line);
+            break;
+        }
+        if (string(mode_str) == "-koopa")
+            mode = MODE_KOOPA;
+        else if (string(mode_str) == "-riscv")
+            mode = MODE_RISCV;
+        else
+        {
+            conn.reply(false, string("unknown mode ") + mode_str);
+            break;
+        }
+        src.resize(n);
+        if (!conn.readBytes(&src[0], n))
+            break;
+
+        if (!warm_ctx)
+            warm_ctx.reset(new CompilerContext);
+        CompilerContext &ctx = *warm_ctx;
+        ctx.opt_level = opt_level;
+        CompileResult result = Compile(ctx, src, mode);
+        // 立即清空，较大的程序占用的内存不会留到下一个请求
+        ctx.reset();
+        if (!conn.reply(result.ok, result.ok ? result.output : result.error))
+            break;
+    }
+    close(fd);
+}
+
+int RunServer(int argc, const char *argv[])
+{
+    string path = "/tmp/compiler.sock";
+    int n_threads = thread::hardware_concurrency();
+    for (int i = 2; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.substr(0, 2) == "-j")
+            n_threads = atoi(argv[i] + 2);
+        else
+            path = arg;
+    }
+    if (n_threads < 1)
+        n_threads = 1;
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "server: socket path too long: %s\n", path.c_str());
+        return 1;
+    }
+    strcpy(addr.sun_path, path.c_str());
+
+    // 已有服务器在监听时不抢占它的套接字，否则删除上次遗留的套接字文件
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(probe, (sockaddr *)&addr, sizeof(addr)) == 0)
+    {
+        fprintf(stderr, "server: %s is already in use\n", path.c_str());
+        close(probe);
+        return 1;
+    }
+    close(probe);
+    unlink(path.c_str());
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0)
+    {
+        perror(path.c_str());
+        return 1;
+    }
+    fprintf(stderr, "server: listening on %s with %d threads\n", path.c_str(), n_threads);
+
+    // 每个连接交给线程池中的一个线程处理；各请求的程序都很小，函数之间不再并行
+    ThreadPool pool(n_threads);
+    while (true)
+    {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept");
+            break;
+        }
+        pool.submit([fd] { serve(fd); });
+    }
+    close(listen_fd);
+    unlink(path.c_str());
+    return 1;
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 工作窃取线程池
+// 每个工作线程有自己的任务队列，从队尾取自己提交的任务（后进先出，局部性好），
+// 自己的队列为空时从其他队列的队头窃取（先进先出，偷到的通常是较大的任务）
+// parallelFor 的调用者在等待期间也会执行任务，因此任务中可以再次调用 parallelFor 而不会死锁
+class ThreadPool
+{
+private:
+    struct Queue
+    {
+        mutex m;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues;   // 每个工作线程一个
+    vector<thread> threads;
+    atomic<int> pending{0};             // 已提交但还未被取走的任务数
+    atomic<unsigned> next{0};           // 外部线程轮流提交到各个队列
+    mutex m;
+    condition_variable cv;              // 有新任务或线程池停止时通知空闲的工作线程
+    condition_variable done_cv;         // 一组任务全部完成时通知等待的线程
+    bool stop = false;
+
+    // 当前线程所属的线程池及其编号，外部线程为 nullptr
+    inline static thread_local ThreadPool *owner = nullptr;
+    inline static thread_local int self = -1;
+
+    bool take(int id, function<void()> &task)
+    {
+        int n = queues.size();
+        // 先取自己队列的队尾，再依次窃取其他队列的队头
+        for (int k = 0; k < n; k++)
+        {
+            Queue &q = *queues[(id + k) % n];
+            lock_guard<mutex> lk(q.m);
+            if (q.tasks.empty())
+                continue;
+            if (k == 0 && owner == this)
+            {
+                task = move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else
+            {
+                task = move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            pending--;
+            return true;
+        }
+        return false;
+    }
+
+    // 执行一个任务，没有可执行的任务时返回 false
+    bool runOne()
+    {
+        if (pending == 0)
+            return false;
+        function<void()> task;
+        if (!take(owner == this ? self : next++ % queues.size(), task))
+            return false;
+        task();
+        return true;
+    }
+
+    void worker(int id)
+    {
+        owner = this;
+        self = id;
+        while (true)
+        {
+            if (runOne())
+                continue;
+            unique_lock<mutex> lk(m);
+            cv.wait(lk, [&] { return stop || pending > 0; });
+            if (stop && pending == 0)
+                return;
+        }
+    }
+
+public:
+    // n 为工作线程数，不含调用 parallelFor 的线程
+    ThreadPool(int n)
+    {
+        if (n < 1)
+            n = 1;
+        for (int i = 0; i < n; i++)
+            queues.emplace_back(new Queue);
+        for (int i = 0; i < n; i++)
+            threads.emplace_back(&ThreadPool::worker, this, i);
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lk(m);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    int size() const
+    {
+        return threads.size();
+    }
+
+    void submit(function<void()> task)
+    {
+        int id = owner == this ? self : next++ % queues.size();
+        {
+            lock_guard<mutex> lk(queues[id]->m);
+            queues[id]->tasks.push_back(move(task));
+        }
+        {
+            lock_guard<mutex> lk(m);
+            pending++;
+        }
+        cv.notify_one();
+    }
+
+    // 并行执行 f(0), ..., f(n - 1)，全部完成后返回
+    template <typename F>
+    void parallelFor(int n, F f)
+    {
+        atomic<int> remaining{n};
+        for (int i = 0; i < n; i++)
+        {
+            submit([&, i] {
+                f(i);
+                if (--remaining == 0)
+                {
+                    lock_guard<mutex> lk(m);
+                    done_cv.notify_all();
+                }
+            });
+        }
+        while (remaining)
+        {
+            if (runOne())
+                continue;
+            // 剩下的任务都已被其他线程取走，等待它们完成
+            unique_lock<mutex> lk(m);
+            done_cv.wait(lk, [&] { return remaining == 0 || pending > 0; });
+        }
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <time.h>
+
+using namespace std;
+
+// 编译各阶段的耗时统计（-ftime-report）
+// 每一项记录墙上时间和所在线程的 CPU 时间，按 (阶段, 函数) 累加；整个程序的阶段函数名为空
+// 按函数的阶段（各个 pass、指令选择、寄存器分配、输出汇编）可能在多个线程中并行记录，
+// 汇总时是各函数之和，并行编译时可能超过总的墙上时间
+class TimeReport
+{
+private:
+    struct Entry
+    {
+        string phase, func;
+        double wall = 0, cpu = 0;   // 毫秒
+        int count = 0;
+    };
+
+    mutable mutex m;
+    vector<Entry> entries;                  // 按第一次记录的顺序
+    map<pair<string, string>, int> index;   // (阶段, 函数) -> entries 中的下标
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    static double processCpu()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+    }
+
+    // 按阶段汇总，保持阶段第一次出现的顺序
+    vector<Entry> phases() const
+    {
+        vector<Entry> result;
+        map<string, int> pos;
+        for (auto &e : entries)
+        {
+            auto it = pos.find(e.phase);
+            if (it == pos.end())
+            {
+                pos[e.phase] = result.size();
+                result.push_back(e);
+                result.back().func.clear();
+                continue;
+            }
+            Entry &sum = result[it->second];
+            sum.wall += e.wall;
+            sum.cpu += e.cpu;
+            sum.count += e.count;
+        }
+        return result;
+    }
+
+    // 各函数所有阶段的合计，按墙上时间从大到小排序
+    vector<Entry> functions() const
+    {
+        vector<Entry> result;
+        map<string, int> pos;
+        for (auto &e : entries)
+        {
+            if (e.func.empty())
+                continue;
+            auto it = pos.find(e.func);
+            if (it == pos.end())
+            {
+                pos[e.func] = result.size();
+                result.push_back(e);
+                result.back().phase.clear();
+                continue;
+            }
+            result[it->second].wall += e.wall;
+            result[it->second].cpu += e.cpu;
+        }
+        stable_sort(result.begin(), result.end(), [](const Entry &a, const Entry &b) { return a.wall > b.wall; });
+        return result;
+    }
+
+    static void jsonString(FILE *f, const string &s)
+    {
+        fputc('"', f);
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                fputc('\\', f);
+            fputc(c, f);
+        }
+        fputc('"', f);
+    }
+
+public:
+    static double threadCpu()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+    }
+
+    void add(const string &phase, const string &func, double wall, double cpu)
+    {
+        lock_guard<mutex> lk(m);
+        auto key = make_pair(phase, func);
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            it = index.emplace(key, entries.size()).first;
+            entries.emplace_back();
+            entries.back().phase = phase;
+            entries.back().func = func;
+        }
+        Entry &e = entries[it->second];
+        e.wall += wall;
+        e.cpu += cpu;
+        e.count++;
+    }
+
+    // 各阶段的墙上时间（毫秒），按阶段第一次出现的顺序
+    vector<pair<string, double>> phaseWall() const
+    {
+        lock_guard<mutex> lk(m);
+        vector<pair<string, double>> result;
+        for (auto &e : phases())
+            result.emplace_back(e.phase, e.wall);
+        return result;
+    }
+
+    // 输出各阶段的表格，以及总耗时最多的 top 个函数中每个阶段的耗时
+    void print(FILE *f, int top = 10) const
+    {
+        lock_guard<mutex> lk(m);
+        double total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        fprintf(f, "===== time report =====\n");
+        fprintf(f, "%-20s %12s %12s %8s\n", "phase", "wall (ms)", "cpu (ms)", "count");
+        for (auto &e : phases())
+            fprintf(f, "%-20s %12.3f %12.3f %8d\n", e.phase.c_str(), e.wall, e.cpu, e.count);
+        fprintf(f, "%-20s %12.3f %12.3f\n", "total", total, processCpu());
+
+        vector<Entry> funcs = functions();
+        if (funcs.empty())
+            return;
+        if (top > (int)funcs.size())
+            top = funcs.size();
+        fprintf(f, "----- %d slowest of %d functions -----\n", top, (int)funcs.size());
+        for (int i = 0; i < top; i++)
+        {
+            fprintf(f, "%-20s %12.3f %12.3f\n", funcs[i].func.c_str(), funcs[i].wall, funcs[i].cpu);
+            for (auto &e : entries)
+            {
+                if (e.func == funcs[i].func)
+                    fprintf(f, "  %-18s %12.3f %12.3f\n", e.phase.c_str(), e.wall, e.cpu);
+            }
+        }
+    }
+
+    // 输出 JSON，包含所有阶段和每个函数的每个阶段
+    void printJSON(FILE *f) const
+    {
+        lock_guard<mutex> lk(m);
+        double total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        fprintf(f, "{\"total\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f},\n \"phases\": [", total, processCpu());
+        vector<Entry> ps = phases();
+        for (int i = 0; i < (int)ps.size(); i++)
+        {
+            fprintf(f, "%s\n  {\"phase\": ", i ? "," : "");
+            jsonString(f, ps[i].phase);
+            fprintf(f, ", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"count\": %d}", ps[i].wall, ps[i].cpu, ps[i].count);
+        }
+        fprintf(f, "],\n \"functions\": [");
+        bool first = true;
+        for (auto &e : entries)
+        {
+            if (e.func.empty())
+                continue;
+            fprintf(f, "%s\n  {\"function\": ", first ? "" : ",");
+            jsonString(f, e.func);
+            fprintf(f, ", \"phase\": ");
+            jsonString(f, e.phase);
+            fprintf(f, ", \"wall_ms\": %.3f, \"cpu_ms\": %.3f}", e.wall, e.cpu);
+            first = false;
+        }
+        fprintf(f, "]}\n");
+    }
+};
+
+// 在作用域内计时，结束时记入 report；report 为空时什么也不做
+class ScopedTimer
+{
+private:
+    TimeReport *report;
+    const char *phase;
+    const string *func;
+    chrono::steady_clock::time_point start;
+    double cpu_start = 0;
+
+public:
+    ScopedTimer(TimeReport *_report, const char *_phase, const string *_func = nullptr)
+        : report(_report), phase(_phase), func(_func)
+    {
+        if (!report)
+            return;
+        start = chrono::steady_clock::now();
+        cpu_start = TimeReport::threadCpu();
+    }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer()
+    {
+        if (!report)
+            return;
+        double wall = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        report->add(phase, func ? *func : string(), wall, TimeReport::threadCpu() - cpu_start);
+    }
+};
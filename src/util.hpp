@@ -1,159 +1,228 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <cerrno>
 #include <iostream>
 #include <fstream>
 #include <stack>
 #include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
-// 封装了一个生成KoopaIR的类,避免反复传参
-class KoopaString
+class IRBasicBlock;
+
+// 带缓冲的输出，直接写入文件描述符，缓冲区满时整块写出
+// 格式化整数和拼接字段都在缓冲区中完成，不产生临时 string
+// mirror 非负时同时把输出写到该文件描述符（如标准输出）；sink 非空时追加到该字符串中，用于并行生成后再按顺序拼接
+// 写入失败（如磁盘已满）时记下第一次失败的 errno，调用者在 close 的返回值中得知输出不完整
+class Writer
 {
 private:
-    string koopa_str;
-
-public:
-    void append(const string &s)
+    static constexpr size_t BUF_SIZE = 1 << 16;
+    char buf[BUF_SIZE];
+    size_t len = 0;
+    int fd = -1, mirror = -1;
+    bool owns_fd = false;
+    string *sink = nullptr;
+    int err = 0;
+
+    void writeAll(int to, const char *p, size_t n)
     {
-        koopa_str += s;
+        while (n)
+        {
+            ssize_t k = ::write(to, p, n);
+            if (k < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (!err)
+                    err = errno;
+                return;
+            }
+            p += k;
+            n -= k;
+        }
     }
 
-    void binary(const string &op, const string &rd, const string &s1, const string &s2)
+    // 不经过缓冲区直接写到各个目标
+    void put(const char *p, size_t n)
     {
-        koopa_str += "  " + rd + " = " + op + " " + s1 + ", " + s2 + "\n";
+        if (fd >= 0)
+            writeAll(fd, p, n);
+        if (mirror >= 0)
+            writeAll(mirror, p, n);
+        if (sink)
+            sink->append(p, n);
     }
 
-    void ret(const string &name)
+public:
+    Writer(int _fd = -1, int _mirror = -1) : fd(_fd), mirror(_mirror) {}
+    Writer(string *_sink) : sink(_sink) {}
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+    ~Writer()
     {
-        koopa_str += "  ret " + name + "\n";
+        close();
     }
 
-    void alloc(const string &name, const string &type_str = "i32")
+    // 打开（截断）输出文件，失败时返回 false
+    bool open(const char *path, int _mirror = -1)
     {
-        koopa_str += "  " + name + " = alloc " + type_str + "\n";
+        close();
+        fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        owns_fd = fd >= 0;
+        mirror = _mirror;
+        err = 0;
+        return fd >= 0;
     }
 
-    void globalAllocINT(const string &name, const string &init = "zeroinit")
+    // 写出缓冲区并关闭文件，之前的写入或关闭本身失败时返回 false，原因见 error()
+    bool close()
     {
-        koopa_str += "global " + name + " = alloc i32, " + init + "\n";
+        flush();
+        if (owns_fd && ::close(fd) != 0 && !err)
+            err = errno;
+        fd = -1;
+        owns_fd = false;
+        return err == 0;
     }
 
-    void globalAllocArray(const string &name, const string &array_type, const string &init = "zeroinit")
+    // 第一次写入失败时的 errno，没有失败时为 0
+    int error() const
     {
-        koopa_str += "global " + name + " = alloc " + array_type + ", " + init + "\n";
+        return err;
     }
 
-    void load(const string &to, const string &from)
+    void flush()
     {
-        koopa_str += "  " + to + " = load " + from + '\n';
+        if (len == 0)
+            return;
+        put(buf, len);
+        len = 0;
     }
 
-    void store(const string &from, const string &to)
+    Writer &operator<<(string_view s)
     {
-        koopa_str += "  store " + from + ", " + to + '\n';
+        if (len + s.size() > BUF_SIZE)
+        {
+            flush();
+            if (s.size() > BUF_SIZE)
+            {
+                put(s.data(), s.size());
+                return *this;
+            }
+        }
+        memcpy(buf + len, s.data(), s.size());
+        len += s.size();
+        return *this;
     }
 
-    void label(const string &s)
+    Writer &operator<<(const char *s)
     {
-        koopa_str += s + ":\n";
+        return *this << string_view(s);
     }
 
-    void br(const string &v, const string &then_s, const string &else_s)
+    Writer &operator<<(const string &s)
     {
-        koopa_str += "  br " + v + ", " + then_s + ", " + else_s + '\n';
+        return *this << string_view(s);
     }
 
-    void jump(const string &label)
+    Writer &operator<<(char c)
     {
-        koopa_str += "  jump " + label + '\n';
+        if (len == BUF_SIZE)
+            flush();
+        buf[len++] = c;
+        return *this;
     }
 
-    void call(const string &to, const string &func, const vector<string> &params)
+    Writer &operator<<(int v)
     {
-        if (to.length())
-        {
-            koopa_str += "  " + to + " = ";
-        }
-        else
+        char tmp[12];
+        int n = 0;
+        unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+        do
         {
-            koopa_str += "  ";
-        }
-        koopa_str += "call " + func + "(";
-        if (params.size())
-        {
-            int n = params.size();
-            koopa_str += params[0];
-            for (int i = 1; i < n; i++)
-            {
-                koopa_str += ", " + params[i];
-            }
-        }
-        koopa_str += ")\n";
+            tmp[n++] = '0' + u % 10;
+            u /= 10;
+        } while (u);
+        if (v < 0)
+            tmp[n++] = '-';
+        if (len + n > BUF_SIZE)
+            flush();
+        while (n)
+            buf[len++] = tmp[--n];
+        return *this;
     }
+};
 
-    void declLibFunc()
+// 输出 RISC-V 汇编的辅助类，各字段直接写入 Writer
+class RiscvString
+{
+private:
+    Writer *out = nullptr;
+
+public:
+    void setWriter(Writer *w)
     {
-        koopa_str.append("decl @getint(): i32\n");
-        koopa_str.append("decl @getch(): i32\n");
-        koopa_str.append("decl @getarray(*i32): i32\n");
-        koopa_str.append("decl @putint(i32)\n");
-        koopa_str.append("decl @putch(i32)\n");
-        koopa_str.append("decl @putarray(i32, *i32)\n");
-        koopa_str.append("decl @starttime()\n");
-        koopa_str.append("decl @stoptime()\n");
-        koopa_str.append("\n");
+        out = w;
     }
 
-    void getelemptr(const string &to, const string &from, const string &i)
+    void append(string_view s)
     {
-        koopa_str += "  " + to + " = getelemptr " + from + ", " + i + "\n";
+        *out << s;
     }
 
-    void getptr(const string &to, const string &from, const string &i)
+    // op rd, rs1, rs2
+    void binary(string_view op, string_view rd, string_view rs1, string_view rs2)
     {
-        koopa_str += "  " + to + " = getptr " + from + ", " + i + "\n";
+        *out << "  " << op << '\t' << rd << ", " << rs1 << ", " << rs2 << '\n';
     }
 
-    string getKoopaIR(){
-        return koopa_str;
+    // op rd, rs1, imm
+    void binary(string_view op, string_view rd, string_view rs1, int imm)
+    {
+        *out << "  " << op << '\t' << rd << ", " << rs1 << ", " << imm << '\n';
     }
-};
 
-// 封装了一个生成Riscvstr的类,避免反复传参
-class RiscvString
-{
-private:
-    string riscv_str;
-public:
-    void append(const string &s)
+    void ret()
     {
-        riscv_str += s;
+        *out << "  ret\n";
     }
 
-    void binary(const string &op, const string &rd, const string &rs1, const string &rs2)
+    void two(string_view op, string_view a, string_view b)
     {
-        riscv_str += "  " + op + "\t" + rd + ", " + rs1 + ", " + rs2 + "\n";
+        *out << "  " << op << '\t' << a << ", " << b << '\n';
     }
 
-    void ret()
+    // op reg, offset(base)，即 lw/sw
+    void mem(string_view op, string_view reg, int offset, string_view base)
+    {
+        *out << "  " << op << '\t' << reg << ", " << offset << '(' << base << ")\n";
+    }
+
+    void li(string_view to, int im)
     {
-        riscv_str += "  ret\n";
+        *out << "  li\t" << to << ", " << im << '\n';
     }
 
-    void two(const string &op, const string &a, const string &b)
+    // op sym，如 j, call, .globl
+    void one(string_view op, string_view sym)
     {
-        riscv_str += "  " + op + "\t" + a + ", " + b + "\n";
+        *out << "  " << op << (op[0] == '.' ? ' ' : '\t') << sym << '\n';
     }
 
-    void li(const string &to, int im)
+    // 伪指令，如 .word 4
+    void one(string_view op, int v)
     {
-        riscv_str += "  li\t" + to + ", " + to_string(im) + "\n";
+        *out << "  " << op << ' ' << v << '\n';
     }
 
-    string getRiscvStr()
+    void label(string_view name)
     {
-        return riscv_str;
+        *out << name << ":\n";
     }
 };
 
@@ -183,18 +252,18 @@ public:
 class WhileName
 {
 public:
-    string entry_name, body_name, end_name;
-    WhileName(const string &_entry, const string &_body, const string &_end) : entry_name(_entry), body_name(_body), end_name(_end) {}
+    IRBasicBlock *entry_bb, *body_bb, *end_bb;
+    WhileName(IRBasicBlock *_entry, IRBasicBlock *_body, IRBasicBlock *_end) : entry_bb(_entry), body_bb(_body), end_bb(_end) {}
 };
 
-// while栈，记录 while的名字，入口，结束位置
+// while栈，记录 while的入口，循环体，结束位置
 class WhileStack
 {
 private:
     stack<WhileName> whiles;
 
 public:
-    void append(const string &_entry, const string &_body, const string &_end)
+    void append(IRBasicBlock *_entry, IRBasicBlock *_body, IRBasicBlock *_end)
     {
         whiles.emplace(_entry, _body, _end);
     }
@@ -204,20 +273,20 @@ public:
         whiles.pop();
     }
 
-    string getBodyName()
+    IRBasicBlock *getBody()
     {
-        return whiles.top().body_name;
+        return whiles.top().body_bb;
     }
 
-    // 从 continue 跳转时，用 getEntryName 函数获得 while 的入口地址
-    string getEntryName()
+    // 从 continue 跳转时，用 getEntry 函数获得 while 的入口
+    IRBasicBlock *getEntry()
     {
-        return whiles.top().entry_name;
+        return whiles.top().entry_bb;
     }
 
-    // 从 break 跳出时，用 getEndName 函数获得 while 结束地址
-    string getEndName()
+    // 从 break 跳出时，用 getEnd 函数获得 while 结束位置
+    IRBasicBlock *getEnd()
     {
-        return whiles.top().end_name;
+        return whiles.top().end_bb;
     }
 };
\ No newline at end of file